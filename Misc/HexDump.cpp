@@ -0,0 +1,383 @@
+#include "HexDump.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define HEXDUMP_SSE2
+#    include <emmintrin.h>
+#endif
+
+// AVX2/SSSE3 kernels are compiled with function-level target attributes and
+// selected at runtime, so the binary still runs on plain SSE2 machines
+#if defined(HEXDUMP_SSE2) && defined(__GNUC__)
+#    define HEXDUMP_X86_DISPATCH
+#    include <immintrin.h>
+#endif
+
+typedef void (*Kernel)(const uchar *src, int size, char *dst);
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+/**
+ * Longest row produced by @c writeRow() (64-bit offset, hex & ASCII columns)
+ */
+static const int MAX_ROW_LENGTH = 16 + 2 + 3 * Misc::HexDump::BytesPerRow + 2
+                                  + Misc::HexDump::BytesPerRow + 1;
+
+//----------------------------------------------------------------------------------------
+// Scalar kernels
+//----------------------------------------------------------------------------------------
+
+static void toHexScalar(const uchar *src, int size, char *dst)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        *dst++ = HEX_DIGITS[src[i] >> 4];
+        *dst++ = HEX_DIGITS[src[i] & 0x0f];
+    }
+}
+
+static void toSpacedHexScalar(const uchar *src, int size, char *dst)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        *dst++ = HEX_DIGITS[src[i] >> 4];
+        *dst++ = HEX_DIGITS[src[i] & 0x0f];
+        *dst++ = ' ';
+    }
+}
+
+static void toPrintableScalar(const uchar *src, int size, char *dst)
+{
+    for (int i = 0; i < size; ++i)
+        dst[i] = (src[i] >= 0x20 && src[i] < 0x7f) ? char(src[i]) : '.';
+}
+
+//----------------------------------------------------------------------------------------
+// SSE2 kernels
+//----------------------------------------------------------------------------------------
+
+#ifdef HEXDUMP_SSE2
+/**
+ * Converts 16 nibbles (0..15) to their ASCII hex digits
+ */
+static inline __m128i nibblesToAscii(const __m128i nibbles)
+{
+    const __m128i letters = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+    const __m128i digits = _mm_add_epi8(nibbles, _mm_set1_epi8('0'));
+    return _mm_add_epi8(digits, _mm_and_si128(letters, _mm_set1_epi8('A' - '0' - 10)));
+}
+
+/**
+ * Splits 16 bytes into the ASCII digits of their high & low nibbles
+ */
+static inline void splitHex(const uchar *src, __m128i &hi, __m128i &lo)
+{
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+    hi = nibblesToAscii(_mm_and_si128(_mm_srli_epi16(v, 4), mask));
+    lo = nibblesToAscii(_mm_and_si128(v, mask));
+}
+
+static void toHexSse2(const uchar *src, int size, char *dst)
+{
+    int i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i hi, lo;
+        splitHex(src + i, hi, lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+
+    toHexScalar(src + i, size - i, dst + 2 * i);
+}
+
+static void toPrintableSse2(const uchar *src, int size, char *dst)
+{
+    int i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        // Signed compare: 0x20..0x7f are printable, 0x80..0xff are negative
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128i printable = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f)),
+                                                   _mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)));
+        const __m128i out = _mm_or_si128(_mm_and_si128(printable, v),
+                                         _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), out);
+    }
+
+    toPrintableScalar(src + i, size - i, dst + i);
+}
+#endif
+
+//----------------------------------------------------------------------------------------
+// AVX2/SSSE3 kernels (runtime dispatch)
+//----------------------------------------------------------------------------------------
+
+#ifdef HEXDUMP_X86_DISPATCH
+__attribute__((target("avx2"))) static void toHexAvx2(const uchar *src, int size, char *dst)
+{
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i alpha = _mm256_set1_epi8('A' - '0' - 10);
+
+    int i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+        __m256i lo = _mm256_and_si256(v, mask);
+        hi = _mm256_add_epi8(_mm256_add_epi8(hi, zero),
+                             _mm256_and_si256(_mm256_cmpgt_epi8(hi, nine), alpha));
+        lo = _mm256_add_epi8(_mm256_add_epi8(lo, zero),
+                             _mm256_and_si256(_mm256_cmpgt_epi8(lo, nine), alpha));
+
+        // Unpack works per 128-bit lane, restore the byte order afterwards
+        const __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        const __m256i b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 2 * i),
+                            _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 2 * i + 32),
+                            _mm256_permute2x128_si256(a, b, 0x31));
+    }
+
+    toHexSse2(src + i, size - i, dst + 2 * i);
+}
+
+/**
+ * Shuffle masks that spread the 32 hex digits of 16 bytes over 48 output
+ * bytes ("XX XX XX ..."), inserting a space after every pair.
+ */
+struct SpacedHexMasks
+{
+    alignas(16) char low[3][16];
+    alignas(16) char high[3][16];
+    alignas(16) char spaces[3][16];
+
+    SpacedHexMasks()
+    {
+        for (int p = 0; p < 48; ++p)
+        {
+            const int k = p / 16;
+            const int i = p % 16;
+            const int column = p % 3;
+            const int digit = 2 * (p / 3) + column;
+
+            low[k][i] = char(0x80);
+            high[k][i] = char(0x80);
+            spaces[k][i] = (column == 2) ? ' ' : 0;
+            if (column != 2)
+            {
+                if (digit < 16)
+                    low[k][i] = char(digit);
+                else
+                    high[k][i] = char(digit - 16);
+            }
+        }
+    }
+};
+
+__attribute__((target("ssse3"))) static void toSpacedHexSsse3(const uchar *src, int size,
+                                                               char *dst)
+{
+    static const SpacedHexMasks masks;
+
+    int i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i hi, lo;
+        splitHex(src + i, hi, lo);
+        const __m128i digitsLow = _mm_unpacklo_epi8(hi, lo);
+        const __m128i digitsHigh = _mm_unpackhi_epi8(hi, lo);
+
+        for (int k = 0; k < 3; ++k)
+        {
+            const __m128i l = _mm_load_si128(reinterpret_cast<const __m128i *>(masks.low[k]));
+            const __m128i h = _mm_load_si128(reinterpret_cast<const __m128i *>(masks.high[k]));
+            const __m128i s = _mm_load_si128(reinterpret_cast<const __m128i *>(masks.spaces[k]));
+            const __m128i out = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(digitsLow, l),
+                                                          _mm_shuffle_epi8(digitsHigh, h)), s);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * i + 16 * k), out);
+        }
+    }
+
+    toSpacedHexScalar(src + i, size - i, dst + 3 * i);
+}
+#endif
+
+//----------------------------------------------------------------------------------------
+// Kernel selection
+//----------------------------------------------------------------------------------------
+
+static Kernel selectHexKernel()
+{
+#if defined(HEXDUMP_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return toHexAvx2;
+#endif
+#if defined(HEXDUMP_SSE2)
+    return toHexSse2;
+#else
+    return toHexScalar;
+#endif
+}
+
+static Kernel selectSpacedHexKernel()
+{
+#if defined(HEXDUMP_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+        return toSpacedHexSsse3;
+#endif
+    return toSpacedHexScalar;
+}
+
+static Kernel selectPrintableKernel()
+{
+#if defined(HEXDUMP_SSE2)
+    return toPrintableSse2;
+#else
+    return toPrintableScalar;
+#endif
+}
+
+static const Kernel TO_HEX = selectHexKernel();
+static const Kernel TO_SPACED_HEX = selectSpacedHexKernel();
+static const Kernel TO_PRINTABLE = selectPrintableKernel();
+
+//----------------------------------------------------------------------------------------
+// Row formatting
+//----------------------------------------------------------------------------------------
+
+/**
+ * Writes a single dump row for up to @c BytesPerRow bytes into @a dst and
+ * returns the number of characters written.
+ */
+static int writeRow(char *dst, const quint64 offset, const char *data, const int size,
+                    const Misc::HexDump::Mode mode)
+{
+    char *p = dst;
+
+    // Offset column, widened to 64 bits only when needed
+    uchar address[8];
+    for (int i = 0; i < 8; ++i)
+        address[i] = uchar(offset >> (56 - 8 * i));
+
+    if (offset >> 32)
+    {
+        TO_HEX(address, 8, p);
+        p += 16;
+    }
+    else
+    {
+        TO_HEX(address + 4, 4, p);
+        p += 8;
+    }
+
+    *p++ = ' ';
+    *p++ = ' ';
+
+    // Hex column
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+    TO_SPACED_HEX(bytes, size, p);
+    p += 3 * size;
+
+    // ASCII column
+    if (mode == Misc::HexDump::HexAscii)
+    {
+        const int padding = 3 * (Misc::HexDump::BytesPerRow - size);
+        std::memset(p, ' ', size_t(padding));
+        p += padding;
+
+        *p++ = ' ';
+        *p++ = '|';
+        TO_PRINTABLE(bytes, size, p);
+        p += size;
+        *p++ = '|';
+    }
+    else if (size > 0)
+        --p;
+
+    return int(p - dst);
+}
+
+//----------------------------------------------------------------------------------------
+// Public interface
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns the display modes in the order of the @c Mode enum
+ */
+QStringList Misc::HexDump::modeList()
+{
+    return QStringList { "ASCII", "HEX", "HEX+ASCII" };
+}
+
+/**
+ * Writes the @a size bytes of @a src as 2 * @a size hexadecimal digits
+ */
+void Misc::HexDump::toHex(const char *src, int size, char *dst)
+{
+    TO_HEX(reinterpret_cast<const uchar *>(src), size, dst);
+}
+
+/**
+ * Writes the @a size bytes of @a src as 3 * @a size characters ("XX ")
+ */
+void Misc::HexDump::toSpacedHex(const char *src, int size, char *dst)
+{
+    TO_SPACED_HEX(reinterpret_cast<const uchar *>(src), size, dst);
+}
+
+/**
+ * Copies @a size bytes of @a src, replacing non-printable bytes with '.'
+ */
+void Misc::HexDump::toPrintable(const char *src, int size, char *dst)
+{
+    TO_PRINTABLE(reinterpret_cast<const uchar *>(src), size, dst);
+}
+
+/**
+ * Formats a single row (at most @c BytesPerRow bytes) located at @a offset
+ */
+QByteArray Misc::HexDump::formatRow(const quint64 offset, const char *data, const int size,
+                                    const Mode mode)
+{
+    Q_ASSERT(size <= BytesPerRow);
+
+    if (mode == Ascii)
+    {
+        QByteArray row(size, Qt::Uninitialized);
+        toPrintable(data, size, row.data());
+        return row;
+    }
+
+    char row[MAX_ROW_LENGTH];
+    return QByteArray(row, writeRow(row, offset, data, size, mode));
+}
+
+/**
+ * Formats @a size bytes of @a data (starting at @a offset) as a multi-line
+ * dump in the given @a mode.
+ */
+QByteArray Misc::HexDump::dump(const quint64 offset, const char *data, const int size,
+                               const Mode mode)
+{
+    if (mode == Ascii)
+        return QByteArray(data, size);
+
+    const int rows = (size + BytesPerRow - 1) / BytesPerRow;
+    QByteArray text(rows * (MAX_ROW_LENGTH + 1), Qt::Uninitialized);
+
+    char *p = text.data();
+    for (int i = 0; i < size; i += BytesPerRow)
+    {
+        p += writeRow(p, offset + quint64(i), data + i, qMin(int(BytesPerRow), size - i), mode);
+        *p++ = '\n';
+    }
+
+    text.resize(int(p - text.constData()));
+    return text;
+}
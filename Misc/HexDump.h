@@ -0,0 +1,42 @@
+#ifndef HEXDUMP_H
+#define HEXDUMP_H
+
+#include <QByteArray>
+#include <QStringList>
+
+namespace Misc {
+/**
+ * Byte-to-text kernels used by the receive view. The hexadecimal encoders
+ * process 16/32 bytes per iteration with SSE2/AVX2 (selected at runtime) and
+ * fall back to a lookup table on other architectures.
+ */
+class HexDump
+{
+public:
+    enum Mode
+    {
+        Ascii = 0,
+        Hex = 1,
+        HexAscii = 2,
+    };
+
+    enum
+    {
+        BytesPerRow = 16,
+    };
+
+    static QStringList modeList();
+
+    // Kernels, @a dst must have room for the whole output
+    static void toHex(const char *src, int size, char *dst);
+    static void toSpacedHex(const char *src, int size, char *dst);
+    static void toPrintable(const char *src, int size, char *dst);
+
+    static QByteArray formatRow(const quint64 offset, const char *data, const int size,
+                                const Mode mode);
+    static QByteArray dump(const quint64 offset, const char *data, const int size,
+                           const Mode mode);
+};
+}
+
+#endif // HEXDUMP_H
@@ -0,0 +1,565 @@
+#include "Instrumentation.h"
+#include <QFile>
+#include <QDateTime>
+#include <QTextStream>
+#include <QtAlgorithms>
+#include <chrono>
+
+using namespace Misc;
+
+std::atomic<bool> Instrumentation::s_enabled(false);
+thread_local qint64 Instrumentation::s_dispatchReadNs = 0;
+
+/**
+ * Raises @a value to @a sample if @a sample is larger
+ */
+static void updateMax(std::atomic<quint64> &value, const quint64 sample)
+{
+    quint64 current = value.load(std::memory_order_relaxed);
+    while (sample > current
+           && !value.compare_exchange_weak(current, sample, std::memory_order_relaxed))
+    {
+    }
+}
+
+/**
+ * Formats a duration of @a ns nanoseconds with a readable unit
+ */
+static QString formatDuration(const double ns)
+{
+    if (ns < 1000)
+        return QString("%1 ns").arg(ns, 0, 'f', 0);
+    if (ns < 1000 * 1000)
+        return QString("%1 us").arg(ns / 1000, 0, 'f', 1);
+    if (ns < 1000 * 1000 * 1000)
+        return QString("%1 ms").arg(ns / 1000000, 0, 'f', 2);
+
+    return QString("%1 s").arg(ns / 1000000000, 0, 'f', 2);
+}
+
+/**
+ * Formats an amount of @a bytes with a readable unit
+ */
+static QString formatBytes(const double bytes)
+{
+    if (bytes < 1024)
+        return QString("%1 B").arg(bytes, 0, 'f', 0);
+    if (bytes < 1024 * 1024)
+        return QString("%1 KB").arg(bytes / 1024, 0, 'f', 1);
+
+    return QString("%1 MB").arg(bytes / (1024 * 1024), 0, 'f', 2);
+}
+
+/**
+ * Formats the mean/percentiles/maximum of @a histogram, the values are
+ * durations if @a durations is @c true and byte counts otherwise.
+ */
+static QString formatHistogram(const Instrumentation::Histogram &histogram,
+                               const bool durations)
+{
+    if (histogram.count() == 0)
+        return QStringLiteral("no samples");
+
+    auto format = [=](const double value)
+    {
+        return durations ? formatDuration(value) : formatBytes(value);
+    };
+
+    return QString("n=%1 mean=%2 p50=%3 p90=%4 p99=%5 max=%6")
+        .arg(histogram.count())
+        .arg(format(histogram.mean()))
+        .arg(format(histogram.percentile(0.50)))
+        .arg(format(histogram.percentile(0.90)))
+        .arg(format(histogram.percentile(0.99)))
+        .arg(format(histogram.max()));
+}
+
+//----------------------------------------------------------------------------------------
+// Histogram
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function
+ */
+Instrumentation::Histogram::Histogram()
+{
+    reset();
+}
+
+/**
+ * Adds @a value to the histogram, safe to call from any thread
+ */
+void Instrumentation::Histogram::record(const quint64 value)
+{
+    m_buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+    updateMax(m_max, value);
+}
+
+/**
+ * Removes all the recorded values
+ */
+void Instrumentation::Histogram::reset()
+{
+    for (int i = 0; i < BucketCount; ++i)
+        m_buckets[i].store(0, std::memory_order_relaxed);
+
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Returns the number of recorded values
+ */
+quint64 Instrumentation::Histogram::count() const
+{
+    return m_count.load(std::memory_order_relaxed);
+}
+
+/**
+ * Returns the largest recorded value
+ */
+quint64 Instrumentation::Histogram::max() const
+{
+    return m_max.load(std::memory_order_relaxed);
+}
+
+/**
+ * Returns the average of the recorded values
+ */
+double Instrumentation::Histogram::mean() const
+{
+    const quint64 samples = count();
+    if (samples == 0)
+        return 0;
+
+    return double(m_sum.load(std::memory_order_relaxed)) / double(samples);
+}
+
+/**
+ * Returns the upper bound of the bucket that contains the value below which
+ * @a fraction (0-1) of the recorded values fall.
+ */
+quint64 Instrumentation::Histogram::percentile(const double fraction) const
+{
+    const quint64 samples = count();
+    if (samples == 0)
+        return 0;
+
+    const quint64 target = qMax<quint64>(1, quint64(fraction * double(samples) + 0.5));
+    quint64 cumulative = 0;
+    for (int i = 0; i < BucketCount; ++i)
+    {
+        cumulative += m_buckets[i].load(std::memory_order_relaxed);
+        if (cumulative >= target)
+            return qMin(bucketUpperBound(i), max());
+    }
+
+    return max();
+}
+
+/**
+ * Returns the number of values recorded in @a bucket
+ */
+quint64 Instrumentation::Histogram::bucketCount(const int bucket) const
+{
+    return m_buckets[bucket].load(std::memory_order_relaxed);
+}
+
+/**
+ * Returns the largest value that falls into @a bucket
+ */
+quint64 Instrumentation::Histogram::bucketUpperBound(const int bucket)
+{
+    if (bucket < SubBuckets)
+        return quint64(bucket);
+
+    const int shift = bucket / SubBuckets - 1;
+    const quint64 lower = quint64(SubBuckets + bucket % SubBuckets) << shift;
+    return lower + (quint64(1) << shift) - 1;
+}
+
+/**
+ * Returns the bucket of @a value: values below 4 have their own bucket, every
+ * larger power of two is split into four equally sized buckets.
+ */
+int Instrumentation::Histogram::bucketOf(const quint64 value)
+{
+    if (value < SubBuckets)
+        return int(value);
+
+    const int msb = 63 - int(qCountLeadingZeroBits(value));
+    const int shift = msb - 2;
+    return (msb - 1) * SubBuckets + int((value >> shift) & (SubBuckets - 1));
+}
+
+//----------------------------------------------------------------------------------------
+// Port counters
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function
+ */
+Instrumentation::Port::Port()
+    : id(0)
+    , open(false)
+{
+    reset();
+}
+
+/**
+ * Clears all the counters of the port
+ */
+void Instrumentation::Port::reset()
+{
+    rxBytes.store(0, std::memory_order_relaxed);
+    rxChunks.store(0, std::memory_order_relaxed);
+    rxDropped.store(0, std::memory_order_relaxed);
+    rxDepthMax.store(0, std::memory_order_relaxed);
+    txBytes.store(0, std::memory_order_relaxed);
+    txDropped.store(0, std::memory_order_relaxed);
+    txDepthMax.store(0, std::memory_order_relaxed);
+    errors.store(0, std::memory_order_relaxed);
+    pendingReadNs.store(0, std::memory_order_relaxed);
+    chunkSize.reset();
+    dispatchLatencyNs.reset();
+
+    sampledBytes = 0;
+    sampledChunks = 0;
+    bytesPerSecond = 0;
+    chunksPerSecond = 0;
+}
+
+/**
+ * Called by the I/O thread right before it reads the kernel buffer, stores
+ * @a timestampNs unless older data is still waiting to be dispatched.
+ *
+ * @note The timestamp must be stored before the bytes are committed to the
+ *       receive buffer, so that the consumer never sees the bytes without it.
+ */
+void Instrumentation::Port::markRead(const qint64 timestampNs)
+{
+    qint64 expected = 0;
+    pendingReadNs.compare_exchange_strong(expected, timestampNs, std::memory_order_release,
+                                          std::memory_order_relaxed);
+}
+
+/**
+ * Called by the I/O thread after a readyRead notification has been drained
+ */
+void Instrumentation::Port::recordChunk(const quint64 bytes)
+{
+    if (bytes == 0)
+        return;
+
+    rxBytes.fetch_add(bytes, std::memory_order_relaxed);
+    rxChunks.fetch_add(1, std::memory_order_relaxed);
+    chunkSize.record(bytes);
+}
+
+/**
+ * Called by the consumer before it hands @a depth received bytes to the
+ * decoders, @a overflowBytes is the total discarded by the receive buffer.
+ * Returns the time at which the oldest of these bytes was read, or 0.
+ */
+qint64 Instrumentation::Port::recordDispatch(const quint64 depth, const quint64 overflowBytes)
+{
+    updateMax(rxDepthMax, depth);
+    rxDropped.store(overflowBytes, std::memory_order_relaxed);
+
+    const qint64 readNs = pendingReadNs.exchange(0, std::memory_order_acquire);
+    if (readNs > 0)
+        dispatchLatencyNs.record(quint64(qMax<qint64>(0, timestampNs() - readNs)));
+
+    return readNs;
+}
+
+/**
+ * Called by the writer after @a bytes were queued, @a depth is the number of
+ * chunks waiting in the transmit queue.
+ */
+void Instrumentation::Port::recordWrite(const quint64 bytes, const quint64 depth)
+{
+    txBytes.fetch_add(bytes, std::memory_order_relaxed);
+    updateMax(txDepthMax, depth);
+}
+
+/**
+ * Called by the writer when @a bytes could not be queued for transmission
+ */
+void Instrumentation::Port::recordDroppedWrite(const quint64 bytes)
+{
+    txDropped.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------------------
+// Constructor/destructor & singleton access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function
+ */
+Instrumentation::Instrumentation()
+    : m_renderDepthMax(0)
+{
+    m_sampleTimer.start();
+}
+
+/**
+ * Destructor function
+ */
+Instrumentation::~Instrumentation()
+{
+    qDeleteAll(m_ports);
+}
+
+/**
+ * Returns the only instance of the class
+ */
+Instrumentation &Instrumentation::instance()
+{
+    static Instrumentation singleton;
+    return singleton;
+}
+
+/**
+ * Returns a monotonic timestamp in nanoseconds, comparable across threads
+ */
+qint64 Instrumentation::timestampNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+//----------------------------------------------------------------------------------------
+// Registration
+//----------------------------------------------------------------------------------------
+
+/**
+ * Starts/stops updating the counters, the values recorded so far are kept
+ */
+void Instrumentation::setEnabled(const bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * Returns the counters of the port with the given @a id, creating them if
+ * needed. The returned object stays valid until the application exits, so
+ * that the I/O threads can update it without any locking.
+ */
+Instrumentation::Port *Instrumentation::port(const int id)
+{
+    QMutexLocker locker(&m_mutex);
+    Q_FOREACH (Port *port, m_ports)
+    {
+        if (port->id == id)
+            return port;
+    }
+
+    Port *port = new Port;
+    port->id = id;
+    m_ports.append(port);
+    return port;
+}
+
+/**
+ * Clears the counters of @a port & labels it with the device @a name, must
+ * be called before the port starts receiving data.
+ */
+void Instrumentation::openPort(Port *port, const QString &name)
+{
+    QMutexLocker locker(&m_mutex);
+    port->reset();
+    port->name = name;
+    port->open = true;
+}
+
+/**
+ * Marks @a port as closed, its counters remain in the report
+ */
+void Instrumentation::closePort(Port *port)
+{
+    QMutexLocker locker(&m_mutex);
+    port->open = false;
+}
+
+//----------------------------------------------------------------------------------------
+// View counters
+//----------------------------------------------------------------------------------------
+
+/**
+ * Called by the view after it has shown @a bytes that it started flushing at
+ * @a startNs, @a readNs is the time at which the oldest of these bytes was
+ * read from the kernel (0 if unknown, e.g. replayed data).
+ */
+void Instrumentation::recordFlush(const quint64 bytes, const qint64 startNs,
+                                  const qint64 readNs)
+{
+    const qint64 endNs = timestampNs();
+    m_flushTimeNs.record(quint64(qMax<qint64>(0, endNs - startNs)));
+    if (readNs > 0)
+        m_displayLatencyNs.record(quint64(qMax<qint64>(0, endNs - readNs)));
+
+    updateMax(m_renderDepthMax, bytes);
+}
+
+/**
+ * Returns the time from the kernel read until the data was added to the view
+ */
+const Instrumentation::Histogram &Instrumentation::displayLatencyNs() const
+{
+    return m_displayLatencyNs;
+}
+
+/**
+ * Returns the time spent adding each batch of data to the view
+ */
+const Instrumentation::Histogram &Instrumentation::flushTimeNs() const
+{
+    return m_flushTimeNs;
+}
+
+/**
+ * Returns the largest number of bytes handed to the view at once
+ */
+quint64 Instrumentation::renderDepthMax() const
+{
+    return m_renderDepthMax.load(std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------------------
+// Reporting
+//----------------------------------------------------------------------------------------
+
+/**
+ * Clears the counters of every port & of the view
+ */
+void Instrumentation::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    Q_FOREACH (Port *port, m_ports)
+        port->reset();
+
+    m_displayLatencyNs.reset();
+    m_flushTimeNs.reset();
+    m_renderDepthMax.store(0, std::memory_order_relaxed);
+    m_sampleTimer.restart();
+}
+
+/**
+ * Updates the byte & chunk rates of every port with the traffic since the
+ * previous call, meant to be called periodically from the GUI thread.
+ */
+void Instrumentation::sample()
+{
+    QMutexLocker locker(&m_mutex);
+    const double seconds = double(m_sampleTimer.nsecsElapsed()) / 1e9;
+    m_sampleTimer.restart();
+    if (seconds <= 0)
+        return;
+
+    Q_FOREACH (Port *port, m_ports)
+    {
+        const quint64 bytes = port->rxBytes.load(std::memory_order_relaxed);
+        const quint64 chunks = port->rxChunks.load(std::memory_order_relaxed);
+        port->bytesPerSecond = double(bytes - qMin(bytes, port->sampledBytes)) / seconds;
+        port->chunksPerSecond = double(chunks - qMin(chunks, port->sampledChunks)) / seconds;
+        port->sampledBytes = bytes;
+        port->sampledChunks = chunks;
+    }
+}
+
+/**
+ * Returns a one-line summary of the open ports & of the view, as of the last
+ * call to @c sample()
+ */
+QString Instrumentation::summary() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    double bytesPerSecond = 0;
+    double chunksPerSecond = 0;
+    quint64 dropped = 0;
+    quint64 latency = 0;
+    Q_FOREACH (const Port *port, m_ports)
+    {
+        if (!port->open)
+            continue;
+
+        bytesPerSecond += port->bytesPerSecond;
+        chunksPerSecond += port->chunksPerSecond;
+        dropped += port->rxDropped.load(std::memory_order_relaxed)
+            + port->txDropped.load(std::memory_order_relaxed);
+        latency = qMax(latency, port->dispatchLatencyNs.percentile(0.99));
+    }
+
+    return QString("RX %1/s %2 chunk/s | drop %3 | read p99 %4 | view p99 %5 | flush p99 %6")
+        .arg(formatBytes(bytesPerSecond))
+        .arg(chunksPerSecond, 0, 'f', 0)
+        .arg(formatBytes(double(dropped)))
+        .arg(formatDuration(double(latency)))
+        .arg(formatDuration(double(m_displayLatencyNs.percentile(0.99))))
+        .arg(formatDuration(double(m_flushTimeNs.percentile(0.99))));
+}
+
+/**
+ * Returns a multi-line report with every counter & histogram
+ */
+QString Instrumentation::report() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QString text;
+    QTextStream out(&text);
+    out << "QSerialTool instrumentation report, "
+        << QDateTime::currentDateTime().toString(Qt::ISODateWithMs) << "\n";
+    out << "Counters " << (enabled() ? "enabled" : "disabled") << "\n";
+
+    Q_FOREACH (const Port *port, m_ports)
+    {
+        out << "\nPort " << port->id << " (" << port->name << ", "
+            << (port->open ? "open" : "closed") << ")\n";
+        out << "  received:        " << port->rxBytes.load() << " bytes in "
+            << port->rxChunks.load() << " chunks, " << formatBytes(port->bytesPerSecond)
+            << "/s, " << QString::number(port->chunksPerSecond, 'f', 1) << " chunks/s\n";
+        out << "  rx dropped:      " << port->rxDropped.load() << " bytes (receive buffer full)\n";
+        out << "  rx buffer depth: " << port->rxDepthMax.load() << " bytes max\n";
+        out << "  transmitted:     " << port->txBytes.load() << " bytes, "
+            << port->txDropped.load() << " bytes dropped (transmit queue full)\n";
+        out << "  tx queue depth:  " << port->txDepthMax.load() << " chunks max\n";
+        out << "  errors:          " << port->errors.load() << "\n";
+        out << "  chunk size:      " << formatHistogram(port->chunkSize, false) << "\n";
+        out << "  read->dispatch:  " << formatHistogram(port->dispatchLatencyNs, true) << "\n";
+
+        for (int i = 0; i < Histogram::BucketCount; ++i)
+        {
+            const quint64 count = port->chunkSize.bucketCount(i);
+            if (count > 0)
+                out << "    <= " << Histogram::bucketUpperBound(i) << " B: " << count << "\n";
+        }
+    }
+
+    out << "\nView\n";
+    out << "  read->display:   " << formatHistogram(m_displayLatencyNs, true) << "\n";
+    out << "  flush time:      " << formatHistogram(m_flushTimeNs, true) << "\n";
+    out << "  largest flush:   " << renderDepthMax() << " bytes\n";
+
+    out.flush();
+    return text;
+}
+
+/**
+ * Writes the current @c report() to @a fileName, returns @c true on success
+ */
+bool Instrumentation::dump(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate))
+        return false;
+
+    const QByteArray data = report().toUtf8();
+    return file.write(data) == data.size();
+}
@@ -0,0 +1,175 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <QString>
+#include <QMutex>
+#include <QVector>
+#include <QElapsedTimer>
+#include <atomic>
+
+namespace Misc {
+/**
+ * Live counters of the receive/transmit path: throughput & readyRead chunk
+ * sizes per port, queue depths, dropped bytes, the latency from the moment
+ * the I/O thread reads the kernel buffer until the data reaches the consumer
+ * and the view, and the time spent flushing data into the view.
+ *
+ * The counters are relaxed atomics updated by the I/O, decode & GUI threads.
+ * Every hot-path call site is guarded by @c enabled(), so that a disabled
+ * instance costs a single relaxed load per chunk. Define
+ * @c QSERIALTOOL_NO_INSTRUMENTATION to remove the counters at compile time.
+ */
+class Instrumentation
+{
+public:
+    /**
+     * Log-linear histogram with four buckets per power of two, the reported
+     * percentiles are accurate to 25% of the value.
+     */
+    class Histogram
+    {
+    public:
+        enum
+        {
+            SubBuckets = 4,
+            BucketCount = 64 * SubBuckets,
+        };
+
+        Histogram();
+
+        void record(const quint64 value);
+        void reset();
+
+        quint64 count() const;
+        quint64 max() const;
+        double mean() const;
+        quint64 percentile(const double fraction) const;
+        quint64 bucketCount(const int bucket) const;
+
+        static quint64 bucketUpperBound(const int bucket);
+
+    private:
+        static int bucketOf(const quint64 value);
+
+    private:
+        std::atomic<quint64> m_buckets[BucketCount];
+        std::atomic<quint64> m_count;
+        std::atomic<quint64> m_sum;
+        std::atomic<quint64> m_max;
+    };
+
+    /**
+     * Counters of one serial port, the ID matches @c SerialChannel::id() and
+     * 0 is used by the port that @c Serial drains on the GUI thread.
+     */
+    struct Port
+    {
+        Port();
+
+        void reset();
+        void markRead(const qint64 timestampNs);
+        void recordChunk(const quint64 bytes);
+        qint64 recordDispatch(const quint64 depth, const quint64 overflowBytes);
+        void recordWrite(const quint64 bytes, const quint64 depth);
+        void recordDroppedWrite(const quint64 bytes);
+
+        int id;
+        QString name;
+        bool open;
+
+        std::atomic<quint64> rxBytes;
+        std::atomic<quint64> rxChunks;
+        std::atomic<quint64> rxDropped;
+        std::atomic<quint64> rxDepthMax;
+        std::atomic<quint64> txBytes;
+        std::atomic<quint64> txDropped;
+        std::atomic<quint64> txDepthMax;
+        std::atomic<quint64> errors;
+        std::atomic<qint64> pendingReadNs;
+        Histogram chunkSize;
+        Histogram dispatchLatencyNs;
+
+        // Updated by sample() on the GUI thread
+        quint64 sampledBytes;
+        quint64 sampledChunks;
+        double bytesPerSecond;
+        double chunksPerSecond;
+    };
+
+    /**
+     * Publishes the read timestamp of the data dispatched by the current
+     * thread, so that the view can measure the read-to-display latency
+     * without the timestamp being threaded through every signal.
+     */
+    class DispatchScope
+    {
+    public:
+        explicit DispatchScope(const qint64 readNs)
+        {
+            s_dispatchReadNs = readNs;
+        }
+
+        ~DispatchScope()
+        {
+            s_dispatchReadNs = 0;
+        }
+    };
+
+    static Instrumentation &instance();
+
+    static inline bool enabled()
+    {
+#ifdef QSERIALTOOL_NO_INSTRUMENTATION
+        return false;
+#else
+        return s_enabled.load(std::memory_order_relaxed);
+#endif
+    }
+
+    static inline qint64 dispatchReadNs()
+    {
+        return s_dispatchReadNs;
+    }
+
+    static qint64 timestampNs();
+
+    void setEnabled(const bool enabled);
+    Port *port(const int id);
+    void openPort(Port *port, const QString &name);
+    void closePort(Port *port);
+
+    void recordFlush(const quint64 bytes, const qint64 startNs, const qint64 readNs);
+
+    const Histogram &displayLatencyNs() const;
+    const Histogram &flushTimeNs() const;
+    quint64 renderDepthMax() const;
+
+    void reset();
+    void sample();
+    QString summary() const;
+    QString report() const;
+    bool dump(const QString &fileName) const;
+
+private:
+    Instrumentation();
+    Instrumentation(Instrumentation &&) = delete;
+    Instrumentation(const Instrumentation &) = delete;
+    Instrumentation &operator=(Instrumentation &&) = delete;
+    Instrumentation &operator=(const Instrumentation &) = delete;
+    ~Instrumentation();
+
+private:
+    static std::atomic<bool> s_enabled;
+    static thread_local qint64 s_dispatchReadNs;
+
+    mutable QMutex m_mutex;
+    QVector<Port *> m_ports;
+    QElapsedTimer m_sampleTimer;
+
+    Histogram m_displayLatencyNs;
+    Histogram m_flushTimeNs;
+    std::atomic<quint64> m_renderDepthMax;
+};
+}
+
+#endif // INSTRUMENTATION_H
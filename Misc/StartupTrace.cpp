@@ -0,0 +1,89 @@
+#include "StartupTrace.h"
+#include <QElapsedTimer>
+#include <QVector>
+#include <QPair>
+#include <QDebug>
+
+using namespace Misc;
+
+/**
+ * Phases recorded so far, with the time at which they ended (in ns since
+ * the trace was started)
+ */
+static QElapsedTimer s_timer;
+static QVector<QPair<QString, qint64>> s_phases;
+static bool s_finished = false;
+
+/**
+ * Starts the trace, must be called first thing in @c main()
+ */
+void StartupTrace::start()
+{
+    s_timer.start();
+    s_phases.clear();
+    s_finished = false;
+}
+
+/**
+ * Records that @a phase has just ended, ignored once the first frame is done
+ */
+void StartupTrace::mark(const QString &phase)
+{
+    if (s_finished || !s_timer.isValid())
+        return;
+
+    s_phases.append(qMakePair(phase, s_timer.nsecsElapsed()));
+}
+
+/**
+ * Records the first frame & logs the breakdown of the startup time
+ */
+void StartupTrace::finish()
+{
+    if (s_finished || !s_timer.isValid())
+        return;
+
+    mark(QStringLiteral("first frame"));
+    s_finished = true;
+
+    qDebug().noquote() << report();
+}
+
+/**
+ * Returns @c true once the first frame of the main window was painted
+ */
+bool StartupTrace::isFinished()
+{
+    return s_finished;
+}
+
+/**
+ * Returns the time elapsed since the start of the trace
+ */
+qint64 StartupTrace::elapsedMs()
+{
+    return s_timer.isValid() ? s_timer.elapsed() : 0;
+}
+
+/**
+ * Returns the duration of every recorded phase & the total time to the last
+ * recorded phase
+ */
+QString StartupTrace::report()
+{
+    QString text = QStringLiteral("Startup trace:");
+    qint64 previous = 0;
+    for (int i = 0; i < s_phases.count(); ++i)
+    {
+        const qint64 end = s_phases.at(i).second;
+        text += QString("\n  %1 %2 ms (at %3 ms)")
+                    .arg(s_phases.at(i).first, -24)
+                    .arg(double(end - previous) / 1e6, 8, 'f', 2)
+                    .arg(double(end) / 1e6, 0, 'f', 2);
+        previous = end;
+    }
+
+    text += QString("\n  %1 %2 ms").arg(QStringLiteral("total"), -24)
+                .arg(double(previous) / 1e6, 8, 'f', 2);
+    return text;
+}
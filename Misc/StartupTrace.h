@@ -0,0 +1,26 @@
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+#include <QString>
+
+namespace Misc {
+/**
+ * Records how long each phase of the application startup takes, from the
+ * beginning of @c main() until the first frame of the main window has been
+ * painted, and logs the breakdown once that first frame is done.
+ *
+ * @note Must only be used from the GUI thread.
+ */
+class StartupTrace
+{
+public:
+    static void start();
+    static void mark(const QString &phase);
+    static void finish();
+    static bool isFinished();
+    static qint64 elapsedMs();
+    static QString report();
+};
+}
+
+#endif // STARTUPTRACE_H
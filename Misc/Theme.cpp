@@ -0,0 +1,170 @@
+#include "Theme.h"
+#include <QHash>
+#include <QImage>
+#include <QWidget>
+#include <QPainter>
+#include <QPixmapCache>
+
+using namespace Misc;
+
+/**
+ * Image painted behind the main window, the dimmer page & the dialogs
+ */
+static const QString BACKGROUND = QStringLiteral(":/images/background.png");
+
+/**
+ * Minimum size of the pixmap cache, large enough for the backgrounds of a few
+ * maximized windows on high-DPI screens (the Qt default is 10 MB)
+ */
+static const int MIN_CACHE_LIMIT_KB = 64 * 1024;
+
+/**
+ * Returns the key of the variant of @a resource scaled to @a size at
+ * @a devicePixelRatio
+ */
+static QString cacheKey(const QString &resource, const QSize &size,
+                        const qreal devicePixelRatio)
+{
+    return QString("theme:%1:%2x%3@%4")
+        .arg(resource)
+        .arg(size.width())
+        .arg(size.height())
+        .arg(devicePixelRatio);
+}
+
+/**
+ * Number of windows painted with each background variant, windows of the
+ * same size share one variant
+ */
+static QHash<QString, int> BACKGROUND_USERS;
+
+/**
+ * Background variant last painted by each window
+ */
+static QHash<const QWidget *, QString> BACKGROUND_KEYS;
+
+/**
+ * Returns the decoded image of @a resource, the file is only decoded once
+ */
+static const QImage &sourceImage(const QString &resource)
+{
+    static QHash<QString, QImage> images;
+
+    auto it = images.find(resource);
+    if (it == images.end())
+        it = images.insert(resource, QImage(resource));
+
+    return it.value();
+}
+
+/**
+ * Returns @a resource scaled to @a size (in device independent pixels) for a
+ * screen with the given @a devicePixelRatio, scaling it only the first time
+ * that this size is requested.
+ */
+QPixmap Theme::pixmap(const QString &resource, const QSize &size,
+                      const qreal devicePixelRatio)
+{
+    if (size.isEmpty())
+        return QPixmap();
+
+    static bool limitRaised = false;
+    if (!limitRaised)
+    {
+        QPixmapCache::setCacheLimit(qMax(QPixmapCache::cacheLimit(), MIN_CACHE_LIMIT_KB));
+        limitRaised = true;
+    }
+
+    const QString key = cacheKey(resource, size, devicePixelRatio);
+
+    QPixmap pixmap;
+    if (QPixmapCache::find(key, &pixmap))
+        return pixmap;
+
+    const QImage &image = sourceImage(resource);
+    if (image.isNull())
+        return QPixmap();
+
+    pixmap = QPixmap::fromImage(image.scaled(size * devicePixelRatio, Qt::IgnoreAspectRatio,
+                                             Qt::SmoothTransformation));
+    pixmap.setDevicePixelRatio(devicePixelRatio);
+    QPixmapCache::insert(key, pixmap);
+    return pixmap;
+}
+
+/**
+ * Drops the variant of @a resource scaled to @a size, e.g. after the window
+ * that used it was resized
+ */
+void Theme::release(const QString &resource, const QSize &size,
+                    const qreal devicePixelRatio)
+{
+    QPixmapCache::remove(cacheKey(resource, size, devicePixelRatio));
+}
+
+/**
+ * Drops the reference of @a widget to its background variant, the variant
+ * is removed from the cache once no window uses it anymore. The widget is
+ * forgotten entirely once it is @a destroyed.
+ */
+static void releaseBackgroundKey(const QWidget *widget, const bool destroyed = false)
+{
+    auto it = BACKGROUND_KEYS.find(widget);
+    if (it == BACKGROUND_KEYS.end())
+        return;
+
+    const QString key = it.value();
+    if (destroyed)
+        BACKGROUND_KEYS.erase(it);
+    else
+        it.value().clear();
+
+    if (key.isEmpty())
+        return;
+
+    if (--BACKGROUND_USERS[key] <= 0)
+    {
+        BACKGROUND_USERS.remove(key);
+        QPixmapCache::remove(key);
+    }
+}
+
+/**
+ * Paints the background image stretched over the whole @a widget
+ */
+void Theme::drawBackground(QPainter *painter, const QWidget *widget)
+{
+    const qreal ratio = widget->devicePixelRatioF();
+    const QPixmap background = pixmap(BACKGROUND, widget->size(), ratio);
+    if (!background.isNull())
+        painter->drawPixmap(0, 0, background);
+
+    // Track which windows use the variant, so that it is only released
+    // when the last one of them is resized or destroyed
+    const QString key = cacheKey(BACKGROUND, widget->size(), ratio);
+    if (!BACKGROUND_KEYS.contains(widget))
+    {
+        QObject::connect(widget, &QObject::destroyed,
+                         [widget]() { releaseBackgroundKey(widget, true); });
+    }
+    else if (BACKGROUND_KEYS.value(widget) == key)
+        return;
+    else
+        releaseBackgroundKey(widget);
+
+    BACKGROUND_KEYS.insert(widget, key);
+    ++BACKGROUND_USERS[key];
+}
+
+/**
+ * Releases the background variant that @a widget used before it was resized
+ * from @a oldSize, unless another window of that size still uses it
+ */
+void Theme::releaseBackground(const QWidget *widget, const QSize &oldSize)
+{
+    if (!oldSize.isValid())
+        return;
+
+    if (BACKGROUND_KEYS.value(widget) == cacheKey(BACKGROUND, oldSize, widget->devicePixelRatioF()))
+        releaseBackgroundKey(widget);
+}
@@ -0,0 +1,33 @@
+#ifndef THEME_H
+#define THEME_H
+
+#include <QPixmap>
+#include <QString>
+#include <QSize>
+
+class QWidget;
+class QPainter;
+
+namespace Misc {
+/**
+ * Shared cache of the images painted behind the windows. Every image is
+ * decoded once, the variants scaled to a given size & device pixel ratio are
+ * kept in @c QPixmapCache, so that painting a window is a plain blit unless
+ * its size changed.
+ *
+ * @note Must only be used from the GUI thread.
+ */
+class Theme
+{
+public:
+    static QPixmap pixmap(const QString &resource, const QSize &size,
+                          const qreal devicePixelRatio);
+    static void release(const QString &resource, const QSize &size,
+                        const qreal devicePixelRatio);
+
+    static void drawBackground(QPainter *painter, const QWidget *widget);
+    static void releaseBackground(const QWidget *widget, const QSize &oldSize);
+};
+}
+
+#endif // THEME_H
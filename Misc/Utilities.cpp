@@ -1,4 +1,4 @@
-#include "utilities.h"
+#include "Utilities.h"
 #include <QAbstractButton>
 /**
  * Shows a macOS-like message box with the given properties
@@ -1,5 +1,5 @@
 QT       += core gui
-QT += serialport
+QT += serialport network
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++11
@@ -10,9 +10,13 @@ CONFIG += c++11
 # deprecated API in order to know how to port your code away from it.
 DEFINES += QT_DEPRECATED_WARNINGS
 INCLUDEPATH += src \
-               misc \
+               Misc \
+               capture \
                ccr \
-               serial
+               serial \
+               protocol \
+               server \
+               telemetry
 
 # You can also make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
@@ -21,22 +25,77 @@ INCLUDEPATH += src \
 
 SOURCES += \
     main.cpp \
-    misc/utilities.cpp \
+    capture/capturereader.cpp \
+    capture/capturereplay.cpp \
+    capture/capturewriter.cpp \
+    Misc/HexDump.cpp \
+    Misc/Instrumentation.cpp \
+    Misc/StartupTrace.cpp \
+    Misc/Theme.cpp \
+    Misc/Utilities.cpp \
+    protocol/checksum.cpp \
+    protocol/deframer.cpp \
+    protocol/modbusmaster.cpp \
+    protocol/pollscheduler.cpp \
+    protocol/timerwheel.cpp \
+    protocol/transactionmanager.cpp \
+    serial/portmanager.cpp \
+    serial/portscanner.cpp \
+    serial/portwatcher.cpp \
+    serial/reconnector.cpp \
     serial/serial.cpp \
+    serial/serialchannel.cpp \
+    serial/serialworker.cpp \
+    serial/writequeue.cpp \
+    server/fanoutserver.cpp \
     src/ccr/ccr.cpp \
     src/datareveivewidget.cpp \
     src/mainwindow.cpp \
-    src/settingsdialog.cpp
+    src/receivelogmodel.cpp \
+    src/receivelogstore.cpp \
+    src/renderscheduler.cpp \
+    src/settingsdialog.cpp \
+    src/telemetryplot.cpp \
+    telemetry/timeseriesstore.cpp
 
 
 HEADERS += \
     datareveivewidget.h \
-    misc/utilities.h \
+    capture/captureformat.h \
+    capture/capturereader.h \
+    capture/capturereplay.h \
+    capture/capturewriter.h \
+    Misc/HexDump.h \
+    Misc/Instrumentation.h \
+    Misc/StartupTrace.h \
+    Misc/Theme.h \
+    Misc/Utilities.h \
+    protocol/checksum.h \
+    protocol/deframer.h \
+    protocol/modbusmaster.h \
+    protocol/pollscheduler.h \
+    protocol/timerwheel.h \
+    protocol/transactionmanager.h \
+    serial/portmanager.h \
+    serial/portscanner.h \
+    serial/portwatcher.h \
+    serial/reconnector.h \
+    serial/ringbuffer.h \
     serial/serial.h \
+    serial/serialchannel.h \
+    serial/serialworker.h \
+    serial/spscqueue.h \
+    serial/writequeue.h \
+    server/fanoutserver.h \
     src/ccr/ccr.h \
     src/datareveivewidget.h \
     src/mainwindow.h \
-    src/settingsdialog.h
+    src/receivelogmodel.h \
+    src/receivelogstore.h \
+    src/renderscheduler.h \
+    src/settingsdialog.h \
+    src/telemetryplot.h \
+    telemetry/timeseriesstore.h
 
 FORMS += \
     ccr.ui \
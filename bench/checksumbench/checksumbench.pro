@@ -0,0 +1,16 @@
+# Micro-benchmark for the checksum/CRC kernels in protocol/checksum.cpp
+QT -= gui
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = checksumbench
+
+INCLUDEPATH += ../../protocol
+
+SOURCES += \
+    main.cpp \
+    ../../protocol/checksum.cpp
+
+HEADERS += \
+    ../../protocol/checksum.h
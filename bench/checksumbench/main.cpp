@@ -0,0 +1,70 @@
+#include <QElapsedTimer>
+#include <QVector>
+#include <cstdio>
+#include "checksum.h"
+
+/**
+ * Minimum time spent on every algorithm/buffer size combination
+ */
+static const qint64 MIN_DURATION_NS = 200 * 1000 * 1000;
+
+/**
+ * Runs @a algorithm over a buffer of @a size bytes repeatedly & returns the
+ * throughput in GB/s.
+ */
+static double measure(const Checksum::Algorithm algorithm, const QByteArray &buffer,
+                      const int size)
+{
+    volatile quint32 sink = 0;
+    qint64 bytes = 0;
+    qint64 elapsed = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    while (elapsed < MIN_DURATION_NS)
+    {
+        for (int offset = 0; offset + size <= buffer.size(); offset += size)
+        {
+            sink = sink ^ Checksum::compute(algorithm, buffer.constData() + offset, size);
+            bytes += size;
+        }
+
+        elapsed = timer.nsecsElapsed();
+    }
+
+    Q_UNUSED(sink);
+    return double(bytes) / double(elapsed);
+}
+
+int main()
+{
+    // Pseudo-random input, large enough to defeat the L1/L2 caches
+    QByteArray buffer(8 * 1024 * 1024, Qt::Uninitialized);
+    quint32 state = 0x12345678;
+    for (int i = 0; i < buffer.size(); ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        buffer[i] = char(state >> 24);
+    }
+
+    const QVector<int> sizes = { 8, 64, 1024, 64 * 1024 };
+    const QStringList names = Checksum::algorithmList();
+
+    std::printf("%-16s", "algorithm");
+    for (int size : sizes)
+        std::printf("%12d B", size);
+    std::printf("   (GB/s)\n");
+
+    for (int i = Checksum::Sum8; i <= Checksum::Crc32; ++i)
+    {
+        const Checksum::Algorithm algorithm = Checksum::Algorithm(i);
+        const QString name = names.at(i) + (Checksum::hardwareAccelerated(algorithm) ? "*" : "");
+        std::printf("%-16s", name.toLatin1().constData());
+        for (int size : sizes)
+            std::printf("%14.2f", measure(algorithm, buffer, size));
+        std::printf("\n");
+    }
+
+    std::printf("\n* hardware-accelerated kernel\n");
+    return 0;
+}
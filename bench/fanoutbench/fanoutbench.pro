@@ -0,0 +1,53 @@
+# Fan-out server benchmark: fast & stalled clients on localhost sockets, fails
+# if a fast client loses or receives corrupt data
+QT -= gui
+QT += serialport network
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = fanoutbench
+
+DEFINES += QSERIALTOOL_HEADLESS
+
+INCLUDEPATH += ../../capture \
+               ../../Misc \
+               ../../protocol \
+               ../../serial \
+               ../../server
+
+SOURCES += \
+    main.cpp \
+    ../../capture/capturewriter.cpp \
+    ../../Misc/HexDump.cpp \
+    ../../Misc/Instrumentation.cpp \
+    ../../protocol/checksum.cpp \
+    ../../protocol/deframer.cpp \
+    ../../serial/portmanager.cpp \
+    ../../serial/portscanner.cpp \
+    ../../serial/portwatcher.cpp \
+    ../../serial/reconnector.cpp \
+    ../../serial/serial.cpp \
+    ../../serial/serialchannel.cpp \
+    ../../serial/serialworker.cpp \
+    ../../serial/writequeue.cpp \
+    ../../server/fanoutserver.cpp
+
+HEADERS += \
+    ../../capture/captureformat.h \
+    ../../capture/capturewriter.h \
+    ../../Misc/HexDump.h \
+    ../../Misc/Instrumentation.h \
+    ../../protocol/checksum.h \
+    ../../protocol/deframer.h \
+    ../../serial/portmanager.h \
+    ../../serial/portscanner.h \
+    ../../serial/portwatcher.h \
+    ../../serial/reconnector.h \
+    ../../serial/ringbuffer.h \
+    ../../serial/serial.h \
+    ../../serial/serialchannel.h \
+    ../../serial/serialworker.h \
+    ../../serial/spscqueue.h \
+    ../../serial/writequeue.h \
+    ../../server/fanoutserver.h
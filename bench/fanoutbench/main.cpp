@@ -0,0 +1,276 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QtEndian>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "fanoutserver.h"
+
+/**
+ * Time to wait for the fast clients to receive the last bytes
+ */
+static const qint64 DRAIN_TIMEOUT_MS = 2000;
+
+/**
+ * Byte expected at @a offset of the raw stream, any loss or reordering
+ * shows up as a mismatch
+ */
+static inline char patternByte(const quint64 offset)
+{
+    return char(offset % 251);
+}
+
+/**
+ * One local client: fast clients read & verify everything, slow clients
+ * stop reading after the connection so that their queue fills up.
+ */
+class Client
+{
+public:
+    Client(QIODevice *device, const bool frames, const bool slow)
+        : m_device(device)
+        , m_frames(frames)
+        , m_slow(slow)
+        , m_bytes(0)
+        , m_frameCount(0)
+        , m_corrupt(0)
+    {
+        if (m_slow)
+        {
+            // Let the kernel buffers fill, nothing is read on this side
+            if (QAbstractSocket *socket = qobject_cast<QAbstractSocket *>(device))
+                socket->setReadBufferSize(1);
+            else if (QLocalSocket *socket = qobject_cast<QLocalSocket *>(device))
+                socket->setReadBufferSize(1);
+
+            return;
+        }
+
+        QObject::connect(device, &QIODevice::readyRead, [=]() { read(); });
+    }
+
+    ~Client()
+    {
+        delete m_device;
+    }
+
+    void read()
+    {
+        const QByteArray data = m_device->readAll();
+        if (!m_frames)
+        {
+            for (int i = 0; i < data.size(); ++i)
+            {
+                if (data.at(i) != patternByte(m_bytes + quint64(i)))
+                    ++m_corrupt;
+            }
+
+            m_bytes += quint64(data.size());
+            return;
+        }
+
+        // Frame stream: 32-bit big-endian size + frame
+        m_pending.append(data);
+        int pos = 0;
+        while (m_pending.size() - pos >= 4)
+        {
+            const quint32 size = qFromBigEndian<quint32>(
+                reinterpret_cast<const uchar *>(m_pending.constData() + pos));
+            if (m_pending.size() - pos - 4 < int(size))
+                break;
+
+            const char *frame = m_pending.constData() + pos + 4;
+            for (quint32 i = 0; i < size; ++i)
+            {
+                if (frame[i] != patternByte(m_bytes + i))
+                    ++m_corrupt;
+            }
+
+            m_bytes += size;
+            ++m_frameCount;
+            pos += 4 + int(size);
+        }
+
+        m_pending.remove(0, pos);
+    }
+
+    QIODevice *m_device;
+    QByteArray m_pending;
+    bool m_frames;
+    bool m_slow;
+    quint64 m_bytes;
+    quint64 m_frameCount;
+    quint64 m_corrupt;
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("SerialToolFanoutBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Fan-out server benchmark over localhost sockets");
+    parser.addHelpOption();
+    parser.addOption({ "clients", "Number of fast clients", "count", "8" });
+    parser.addOption({ "slow", "Number of clients that never read", "count", "1" });
+    parser.addOption({ "rate", "Bytes per second to publish", "bytes", "4000000" });
+    parser.addOption({ "chunk", "Size of every published chunk/frame in bytes", "bytes", "256" });
+    parser.addOption({ "duration", "Duration of the test in seconds", "seconds", "5" });
+    parser.addOption({ "max-queue", "Queue limit of every client in bytes", "bytes", "1048576" });
+    parser.addOption({ "frames", "Use the frame stream instead of the raw stream" });
+    parser.addOption({ "local", "Use a local socket instead of TCP" });
+    parser.addOption({ "disconnect", "Disconnect slow clients instead of dropping data" });
+    parser.process(app);
+
+    const int fastClients = qMax(parser.value("clients").toInt(), 1);
+    const int slowClients = qMax(parser.value("slow").toInt(), 0);
+    const qint64 rate = qMax(parser.value("rate").toLongLong(), qint64(1));
+    const int chunkSize = qMax(parser.value("chunk").toInt(), 1);
+    const qint64 durationMs = qint64(parser.value("duration").toDouble() * 1000);
+    const bool frames = parser.isSet("frames");
+    const bool local = parser.isSet("local");
+    const auto stream = frames ? FanoutServer::FrameStream : FanoutServer::RawStream;
+
+    FanoutServer server;
+    server.setMaxClients(fastClients + slowClients);
+    server.setMaxQueueBytes(parser.value("max-queue").toLongLong());
+    server.setOverflowPolicy(parser.isSet("disconnect") ? FanoutServer::Disconnect
+                                                        : FanoutServer::DropOldest);
+
+    const QString localName = QString("serialtool-fanoutbench-%1").arg(app.applicationPid());
+    const bool listening = local ? server.listenLocal(localName, stream)
+                                 : server.listen(QHostAddress::LocalHost, 0, stream);
+    if (!listening)
+    {
+        std::fprintf(stderr, "Cannot listen: %s\n", qPrintable(server.errorString()));
+        return EXIT_FAILURE;
+    }
+
+    // Connect the clients & wait until the server has accepted all of them
+    std::vector<Client *> clients;
+    for (int i = 0; i < fastClients + slowClients; ++i)
+    {
+        QIODevice *device;
+        if (local)
+        {
+            QLocalSocket *socket = new QLocalSocket;
+            socket->connectToServer(localName);
+            device = socket;
+        }
+        else
+        {
+            QTcpSocket *socket = new QTcpSocket;
+            socket->connectToHost(QHostAddress::LocalHost, server.tcpPort(stream));
+            device = socket;
+        }
+
+        clients.push_back(new Client(device, frames, i >= fastClients));
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+    while (server.clientCount() < int(clients.size()) && clock.elapsed() < DRAIN_TIMEOUT_MS)
+        app.processEvents(QEventLoop::WaitForMoreEvents, 10);
+
+    if (server.clientCount() < int(clients.size()))
+    {
+        std::fprintf(stderr, "Only %d of %d clients connected\n", server.clientCount(),
+                     int(clients.size()));
+        return EXIT_FAILURE;
+    }
+
+    // Publish patterned chunks at the requested rate
+    QByteArray chunk(chunkSize, Qt::Uninitialized);
+    quint64 published = 0;
+    qint64 publishNs = 0;
+    clock.restart();
+
+    QTimer publisher;
+    publisher.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&publisher, &QTimer::timeout, [&]() {
+        const qint64 elapsedMs = clock.elapsed();
+        const quint64 due = quint64(qMin(elapsedMs, durationMs) * rate / 1000);
+        while (published + quint64(chunkSize) <= due)
+        {
+            for (int i = 0; i < chunkSize; ++i)
+                chunk[i] = patternByte(published + quint64(i));
+
+            QElapsedTimer timer;
+            timer.start();
+            if (frames)
+                server.publishFrame(chunk.constData(), chunk.size());
+            else
+                server.publish(chunk.constData(), chunk.size());
+
+            publishNs += timer.nsecsElapsed();
+            published += quint64(chunkSize);
+        }
+
+        if (elapsedMs >= durationMs)
+            publisher.stop();
+    });
+    publisher.start(1);
+
+    // Stop once the fast clients have everything or the drain timeout expired
+    QTimer watchdog;
+    QObject::connect(&watchdog, &QTimer::timeout, [&]() {
+        if (publisher.isActive())
+            return;
+
+        bool complete = true;
+        for (int i = 0; i < fastClients; ++i)
+            complete = complete && clients[size_t(i)]->m_bytes >= published;
+
+        if (complete || clock.elapsed() > durationMs + DRAIN_TIMEOUT_MS)
+            app.quit();
+    });
+    watchdog.start(20);
+    app.exec();
+
+    quint64 minFast = published;
+    quint64 corrupt = 0;
+    quint64 slowBytes = 0;
+    for (int i = 0; i < int(clients.size()); ++i)
+    {
+        Client *client = clients[size_t(i)];
+        if (client->m_slow)
+        {
+            slowBytes += client->m_bytes;
+            continue;
+        }
+
+        minFast = qMin(minFast, client->m_bytes);
+        corrupt += client->m_corrupt;
+    }
+
+    const auto &stats = server.statistics();
+    const double seconds = qMax(durationMs, qint64(1)) / 1e3;
+    std::printf("transport        %s, %s stream\n", local ? "local socket" : "TCP",
+                frames ? "frame" : "raw");
+    std::printf("clients          %d fast, %d slow\n", fastClients, slowClients);
+    std::printf("published        %llu B (%.2f MB/s)\n",
+                static_cast<unsigned long long>(published), published / seconds / 1e6);
+    std::printf("publish cost     %.1f ns/B for all clients\n",
+                published > 0 ? double(publishNs) / double(published) : 0.0);
+    std::printf("fast client min  %llu B, %llu corrupt\n",
+                static_cast<unsigned long long>(minFast),
+                static_cast<unsigned long long>(corrupt));
+    std::printf("slow clients     %llu B received, %llu disconnected\n",
+                static_cast<unsigned long long>(slowBytes),
+                static_cast<unsigned long long>(stats.slowDisconnects));
+    std::printf("dropped          %llu chunks, %llu B\n",
+                static_cast<unsigned long long>(stats.droppedChunks),
+                static_cast<unsigned long long>(stats.droppedBytes));
+
+    for (Client *client : clients)
+        delete client;
+
+    server.close();
+
+    // Fast clients must not be affected by the slow ones
+    return minFast == published && corrupt == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,329 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "serial.h"
+
+/**
+ * Every chunk written to the pseudo-terminal starts with this header, the
+ * rest of the chunk is filled with a pattern derived from the sequence.
+ */
+struct ChunkHeader
+{
+    quint32 magic;
+    quint32 sequence;
+    qint64 sentNs;
+};
+
+static const quint32 CHUNK_MAGIC = 0x50545942;
+
+/**
+ * Time to wait for the last bytes after the writer has finished
+ */
+static const qint64 DRAIN_TIMEOUT_NS = 1000 * 1000 * 1000;
+
+/**
+ * Returns CLOCK_MONOTONIC in nanoseconds, shared by the writer & the reader
+ */
+static qint64 monotonicNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static inline char patternByte(const quint32 sequence, const int index)
+{
+    return char((sequence * 31 + quint32(index)) & 0xFF);
+}
+
+/**
+ * Writes patterned chunks to the master side of the pseudo-terminal at the
+ * requested rate (0 = as fast as the pty accepts them).
+ */
+class Writer
+{
+public:
+    Writer(const int fd, const int chunkSize, const qint64 rate, const qint64 durationNs)
+        : m_fd(fd)
+        , m_chunkSize(chunkSize)
+        , m_rate(rate)
+        , m_durationNs(durationNs)
+        , m_bytesSent(0)
+        , m_done(false)
+    {
+    }
+
+    void run()
+    {
+        std::vector<char> chunk(size_t(m_chunkSize));
+        const qint64 start = monotonicNs();
+
+        for (quint32 sequence = 0;; ++sequence)
+        {
+            const qint64 now = monotonicNs();
+            if (now - start >= m_durationNs)
+                break;
+
+            // Pace the writes to the requested rate
+            if (m_rate > 0)
+            {
+                const qint64 due = start + qint64(double(m_bytesSent.load()) * 1e9 / m_rate);
+                if (due > now)
+                {
+                    timespec ts;
+                    ts.tv_sec = time_t((due - now) / 1000000000);
+                    ts.tv_nsec = long((due - now) % 1000000000);
+                    nanosleep(&ts, Q_NULLPTR);
+                }
+            }
+
+            for (int i = int(sizeof(ChunkHeader)); i < m_chunkSize; ++i)
+                chunk[size_t(i)] = patternByte(sequence, i);
+
+            ChunkHeader header;
+            header.magic = CHUNK_MAGIC;
+            header.sequence = sequence;
+            header.sentNs = monotonicNs();
+            memcpy(chunk.data(), &header, sizeof(header));
+
+            int written = 0;
+            while (written < m_chunkSize)
+            {
+                const ssize_t bytes = ::write(m_fd, chunk.data() + written,
+                                             size_t(m_chunkSize - written));
+                if (bytes <= 0)
+                {
+                    m_done.store(true);
+                    return;
+                }
+
+                written += int(bytes);
+            }
+
+            m_bytesSent.fetch_add(quint64(m_chunkSize));
+        }
+
+        m_done.store(true);
+    }
+
+    quint64 bytesSent() const
+    {
+        return m_bytesSent.load();
+    }
+
+    bool done() const
+    {
+        return m_done.load();
+    }
+
+private:
+    int m_fd;
+    int m_chunkSize;
+    qint64 m_rate;
+    qint64 m_durationNs;
+    std::atomic<quint64> m_bytesSent;
+    std::atomic<bool> m_done;
+};
+
+/**
+ * Reassembles the chunks delivered by @c Serial::dataAvailable(), verifies
+ * their sequence & pattern and measures the write-to-signal latency.
+ */
+class Reader
+{
+public:
+    explicit Reader(const int chunkSize)
+        : m_chunkSize(chunkSize)
+        , m_expected(0)
+        , m_bytes(0)
+        , m_chunks(0)
+        , m_corruptBytes(0)
+        , m_lostChunks(0)
+        , m_reorderedChunks(0)
+        , m_firstNs(0)
+        , m_lastNs(0)
+    {
+        m_chunk.reserve(size_t(chunkSize));
+        m_latencies.reserve(1 << 20);
+    }
+
+    void consume(const char *data, const size_t size)
+    {
+        const qint64 now = monotonicNs();
+        if (m_firstNs == 0)
+            m_firstNs = now;
+
+        m_lastNs = now;
+        m_bytes += size;
+
+        for (size_t i = 0; i < size;)
+        {
+            const size_t bytes = qMin(size - i, size_t(m_chunkSize) - m_chunk.size());
+            m_chunk.insert(m_chunk.end(), data + i, data + i + bytes);
+            i += bytes;
+
+            if (m_chunk.size() == size_t(m_chunkSize))
+                verify(now);
+        }
+    }
+
+    void verify(const qint64 now)
+    {
+        ChunkHeader header;
+        memcpy(&header, m_chunk.data(), sizeof(header));
+
+        // Out of sync (bytes were dropped), skip one byte & try again
+        if (header.magic != CHUNK_MAGIC)
+        {
+            ++m_corruptBytes;
+            m_chunk.erase(m_chunk.begin());
+            return;
+        }
+
+        bool valid = true;
+        for (int i = int(sizeof(ChunkHeader)); i < m_chunkSize && valid; ++i)
+            valid = m_chunk[size_t(i)] == patternByte(header.sequence, i);
+
+        if (valid)
+        {
+            // An old sequence is a duplicate or a reordered chunk, not a gap
+            if (header.sequence < m_expected)
+                ++m_reorderedChunks;
+            else
+            {
+                m_lostChunks += header.sequence - m_expected;
+                m_expected = header.sequence + 1;
+            }
+
+            m_latencies.push_back(now - header.sentNs);
+            ++m_chunks;
+        }
+
+        else
+            m_corruptBytes += quint64(m_chunkSize);
+
+        m_chunk.clear();
+    }
+
+    qint64 percentile(const double p)
+    {
+        if (m_latencies.empty())
+            return 0;
+
+        const size_t n = std::min(m_latencies.size() - 1,
+                                  size_t(p / 100.0 * double(m_latencies.size())));
+        std::nth_element(m_latencies.begin(), m_latencies.begin() + long(n),
+                         m_latencies.end());
+        return m_latencies[n];
+    }
+
+    int m_chunkSize;
+    quint32 m_expected;
+    quint64 m_bytes;
+    quint64 m_chunks;
+    quint64 m_corruptBytes;
+    quint64 m_lostChunks;
+    quint64 m_reorderedChunks;
+    qint64 m_firstNs;
+    qint64 m_lastNs;
+    std::vector<char> m_chunk;
+    std::vector<qint64> m_latencies;
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("SerialToolPtyBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Serial ingest benchmark over a pseudo-terminal");
+    parser.addHelpOption();
+    parser.addOption({ "rate", "Bytes per second to send, 0 = unlimited", "bytes", "0" });
+    parser.addOption({ "chunk", "Size of every write in bytes (>= 16)", "bytes", "256" });
+    parser.addOption({ "duration", "Duration of the test in seconds", "seconds", "5" });
+    parser.addOption({ "rx-buffer", "Receive ring buffer size in bytes", "bytes", "1048576" });
+    parser.addOption({ "no-io-thread", "Read the port on the main thread" });
+    parser.process(app);
+
+    const qint64 rate = parser.value("rate").toLongLong();
+    const int chunkSize = qMax(parser.value("chunk").toInt(), int(sizeof(ChunkHeader)));
+    const qint64 durationNs = qint64(parser.value("duration").toDouble() * 1e9);
+
+    // Create the pseudo-terminal pair
+    const int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        std::perror("posix_openpt");
+        return EXIT_FAILURE;
+    }
+
+    const QString slave = QString::fromLocal8Bit(ptsname(master));
+
+    // Open the slave side through the normal Serial path
+    Serial &serial = Serial::instance();
+    serial.setIoThreadEnabled(!parser.isSet("no-io-thread"));
+    serial.setReceiveBufferSize(parser.value("rx-buffer").toUInt());
+    if (!serial.open(slave, QIODevice::ReadWrite))
+    {
+        std::fprintf(stderr, "Cannot open %s\n", qPrintable(slave));
+        return EXIT_FAILURE;
+    }
+
+    Reader reader(chunkSize);
+    QObject::connect(&serial, &Serial::dataAvailable,
+                     [&](const RingBuffer::Span &first, const RingBuffer::Span &second) {
+                         reader.consume(first.data, first.size);
+                         reader.consume(second.data, second.size);
+                     });
+
+    Writer writer(master, chunkSize, rate, durationNs);
+    std::thread writerThread([&]() { writer.run(); });
+
+    // Stop once everything has been received or the link went quiet
+    QTimer timer;
+    QObject::connect(&timer, &QTimer::timeout, [&]() {
+        if (!writer.done())
+            return;
+
+        const bool complete = reader.m_bytes >= writer.bytesSent();
+        if (complete || monotonicNs() - reader.m_lastNs > DRAIN_TIMEOUT_NS)
+            app.quit();
+    });
+    timer.start(50);
+    app.exec();
+
+    writerThread.join();
+
+    const double seconds = qMax(reader.m_lastNs - reader.m_firstNs, qint64(1)) / 1e9;
+    std::printf("device           %s (%s)\n", qPrintable(slave),
+                serial.ioThreadEnabled() ? "I/O thread" : "main thread");
+    std::printf("chunk size       %d B\n", chunkSize);
+    std::printf("target rate      %s\n",
+                rate > 0 ? qPrintable(QString("%1 B/s").arg(rate)) : "unlimited");
+    std::printf("bytes sent       %llu\n", static_cast<unsigned long long>(writer.bytesSent()));
+    std::printf("bytes received   %llu\n", static_cast<unsigned long long>(reader.m_bytes));
+    std::printf("throughput       %.2f MB/s\n", reader.m_bytes / seconds / 1e6);
+    std::printf("dropped (ring)   %llu B\n", static_cast<unsigned long long>(serial.droppedBytes()));
+    std::printf("corrupt/lost     %llu B, %llu chunks\n",
+                static_cast<unsigned long long>(reader.m_corruptBytes),
+                static_cast<unsigned long long>(reader.m_lostChunks));
+    std::printf("reordered/dup    %llu chunks\n",
+                static_cast<unsigned long long>(reader.m_reorderedChunks));
+    std::printf("write-to-signal latency (us): p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+                reader.percentile(50) / 1e3, reader.percentile(90) / 1e3,
+                reader.percentile(99) / 1e3, reader.percentile(99.9) / 1e3,
+                reader.percentile(100) / 1e3);
+
+    serial.disconnectDevice();
+    ::close(master);
+    return EXIT_SUCCESS;
+}
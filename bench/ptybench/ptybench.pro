@@ -0,0 +1,53 @@
+# End-to-end ingest benchmark: feeds Serial through Linux pseudo-terminals
+!linux: error("ptybench requires Linux pseudo-terminals")
+
+# The benchmark runs on a QCoreApplication, the serial sources are built
+# without their widget dependencies
+QT -= gui
+QT += serialport
+
+DEFINES += QSERIALTOOL_HEADLESS
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = ptybench
+
+INCLUDEPATH += ../../capture \
+               ../../Misc \
+               ../../protocol \
+               ../../serial
+
+SOURCES += \
+    main.cpp \
+    ../../capture/capturewriter.cpp \
+    ../../Misc/HexDump.cpp \
+    ../../Misc/Instrumentation.cpp \
+    ../../protocol/checksum.cpp \
+    ../../protocol/deframer.cpp \
+    ../../serial/portmanager.cpp \
+    ../../serial/portscanner.cpp \
+    ../../serial/portwatcher.cpp \
+    ../../serial/reconnector.cpp \
+    ../../serial/serial.cpp \
+    ../../serial/serialchannel.cpp \
+    ../../serial/serialworker.cpp \
+    ../../serial/writequeue.cpp
+
+HEADERS += \
+    ../../capture/captureformat.h \
+    ../../capture/capturewriter.h \
+    ../../Misc/HexDump.h \
+    ../../Misc/Instrumentation.h \
+    ../../protocol/checksum.h \
+    ../../protocol/deframer.h \
+    ../../serial/portmanager.h \
+    ../../serial/portscanner.h \
+    ../../serial/portwatcher.h \
+    ../../serial/reconnector.h \
+    ../../serial/ringbuffer.h \
+    ../../serial/serial.h \
+    ../../serial/serialchannel.h \
+    ../../serial/serialworker.h \
+    ../../serial/spscqueue.h \
+    ../../serial/writequeue.h
@@ -0,0 +1,75 @@
+#ifndef CAPTUREFORMAT_H
+#define CAPTUREFORMAT_H
+
+#include <QtGlobal>
+
+/**
+ * On-disk layout of the capture files (little-endian, no padding between
+ * records):
+ *
+ * - @c FileHeader
+ * - @c RecordHeader followed by @c size payload bytes, repeated
+ * - @c IndexEntry array, one entry every ~256 KiB or 1 s of records
+ * - @c FileFooter
+ *
+ * Record timestamps are monotonic nanoseconds since the capture started, the
+ * header stores the wall-clock time of that instant. The index & footer are
+ * written when the capture is closed, files without them (e.g. after a
+ * crash) are still readable, the index is then rebuilt by scanning them.
+ */
+namespace Capture
+{
+static const char MAGIC[8] = { 'Q', 'S', 'T', 'C', 'A', 'P', 0x0D, 0x0A };
+static const char INDEX_MAGIC[8] = { 'Q', 'S', 'T', 'I', 'N', 'D', 'E', 'X' };
+static const quint32 VERSION = 2;
+
+static const quint64 INDEX_SPACING_BYTES = 256 * 1024;
+static const quint64 INDEX_SPACING_NS = 1000000000ULL;
+
+enum Direction
+{
+    Received = 0,
+    Transmitted = 1,
+};
+
+#pragma pack(push, 1)
+struct FileHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 headerSize;
+    qint64 startTimeMs;
+    quint64 reserved;
+};
+
+struct RecordHeader
+{
+    quint64 timestampNs;
+    quint32 size;
+    quint16 portId;
+    quint8 direction;
+    quint8 reserved;
+};
+
+struct IndexEntry
+{
+    quint64 timestampNs;
+    quint64 offset;
+};
+
+struct FileFooter
+{
+    char magic[8];
+    quint64 indexOffset;
+    quint64 entryCount;
+    quint64 endTimestampNs;
+};
+#pragma pack(pop)
+
+Q_STATIC_ASSERT(sizeof(FileHeader) == 32);
+Q_STATIC_ASSERT(sizeof(RecordHeader) == 16);
+Q_STATIC_ASSERT(sizeof(IndexEntry) == 16);
+Q_STATIC_ASSERT(sizeof(FileFooter) == 32);
+}
+
+#endif // CAPTUREFORMAT_H
@@ -0,0 +1,352 @@
+#include "capturereader.h"
+#include <algorithm>
+#include <cstring>
+
+//----------------------------------------------------------------------------------------
+// Constructor/destructor
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function
+ */
+CaptureReader::CaptureReader()
+    : m_data(Q_NULLPTR)
+    , m_size(0)
+    , m_endOffset(0)
+    , m_startTimeMs(0)
+    , m_endTimestampNs(0)
+    , m_indexRecovered(false)
+{
+}
+
+/**
+ * Destructor function, unmaps & closes the file
+ */
+CaptureReader::~CaptureReader()
+{
+    close();
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns @c true if a capture file is open
+ */
+bool CaptureReader::isOpen() const
+{
+    return m_data != Q_NULLPTR;
+}
+
+/**
+ * Returns the path of the capture file
+ */
+QString CaptureReader::fileName() const
+{
+    return m_file.fileName();
+}
+
+/**
+ * Returns the description of the last error
+ */
+QString CaptureReader::errorString() const
+{
+    return m_errorString;
+}
+
+/**
+ * Returns @c true if the file had no valid index (e.g. the recording was not
+ * closed properly) & the index was rebuilt by scanning the records
+ */
+bool CaptureReader::indexRecovered() const
+{
+    return m_indexRecovered;
+}
+
+/**
+ * Returns the wall-clock time (ms since epoch) at which the capture started
+ */
+qint64 CaptureReader::startTimeMs() const
+{
+    return m_startTimeMs;
+}
+
+/**
+ * Returns the timestamp of the last record
+ */
+quint64 CaptureReader::durationNs() const
+{
+    return m_endTimestampNs;
+}
+
+/**
+ * Returns the size of the capture file in bytes
+ */
+qint64 CaptureReader::fileSize() const
+{
+    return m_size;
+}
+
+/**
+ * Returns the offset of the first record
+ */
+qint64 CaptureReader::firstOffset() const
+{
+    return sizeof(Capture::FileHeader);
+}
+
+/**
+ * Returns the offset just past the last record
+ */
+qint64 CaptureReader::endOffset() const
+{
+    return m_endOffset;
+}
+
+/**
+ * Returns the number of entries of the time/offset index
+ */
+int CaptureReader::indexSize() const
+{
+    return int(m_index.size());
+}
+
+//----------------------------------------------------------------------------------------
+// File control
+//----------------------------------------------------------------------------------------
+
+/**
+ * Maps the capture file at @a fileName & loads its index
+ */
+bool CaptureReader::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    if (m_size < qint64(sizeof(Capture::FileHeader)))
+    {
+        m_errorString = QStringLiteral("Not a capture file");
+        close();
+        return false;
+    }
+
+    m_data = m_file.map(0, m_size);
+    if (m_data == Q_NULLPTR)
+    {
+        m_errorString = m_file.errorString();
+        close();
+        return false;
+    }
+
+    Capture::FileHeader header;
+    memcpy(&header, m_data, sizeof(header));
+    if (memcmp(header.magic, Capture::MAGIC, sizeof(header.magic)) != 0
+        || header.version > Capture::VERSION
+        || header.headerSize != sizeof(header))
+    {
+        m_errorString = QStringLiteral("Not a capture file");
+        close();
+        return false;
+    }
+
+    m_startTimeMs = header.startTimeMs;
+    if (!loadIndex())
+        rebuildIndex();
+
+    return true;
+}
+
+/**
+ * Unmaps & closes the capture file
+ */
+void CaptureReader::close()
+{
+    if (m_data != Q_NULLPTR)
+        m_file.unmap(const_cast<uchar *>(m_data));
+
+    m_file.close();
+    m_data = Q_NULLPTR;
+    m_size = 0;
+    m_endOffset = 0;
+    m_startTimeMs = 0;
+    m_endTimestampNs = 0;
+    m_indexRecovered = false;
+    m_index.clear();
+}
+
+//----------------------------------------------------------------------------------------
+// Record access
+//----------------------------------------------------------------------------------------
+
+/**
+ * Reads the record that starts at @a offset, returns @c false if @a offset
+ * is past the last record or the record is truncated.
+ */
+bool CaptureReader::read(const qint64 offset, CaptureReader::Record &record) const
+{
+    if (offset < firstOffset() || offset + qint64(sizeof(Capture::RecordHeader)) > m_endOffset)
+        return false;
+
+    Capture::RecordHeader header;
+    memcpy(&header, m_data + offset, sizeof(header));
+
+    const qint64 payload = offset + qint64(sizeof(header));
+    if (payload + header.size > m_endOffset)
+        return false;
+
+    record.offset = offset;
+    record.timestampNs = header.timestampNs;
+    record.portId = header.portId;
+    record.direction = Capture::Direction(header.direction);
+    record.data = reinterpret_cast<const char *>(m_data + payload);
+    record.size = header.size;
+    return true;
+}
+
+/**
+ * Returns the offset of the first record with a timestamp greater than or
+ * equal to @a timestampNs, or @c endOffset() if there is none.
+ */
+qint64 CaptureReader::seek(const quint64 timestampNs) const
+{
+    if (!isOpen())
+        return 0;
+
+    // Last index entry at or before the requested time
+    auto it = std::upper_bound(m_index.begin(), m_index.end(), timestampNs,
+                               [](const quint64 ts, const Capture::IndexEntry &entry) {
+                                   return ts < entry.timestampNs;
+                               });
+
+    qint64 offset = firstOffset();
+    if (it != m_index.begin())
+        offset = qint64((it - 1)->offset);
+
+    // Short forward scan, the entries are at most ~256 KiB apart
+    Record record;
+    while (read(offset, record))
+    {
+        if (record.timestampNs >= timestampNs)
+            return offset;
+
+        offset += sizeof(Capture::RecordHeader) + record.size;
+    }
+
+    return m_endOffset;
+}
+
+/**
+ * Returns the offset of the nearest record that starts at least @a bytes
+ * before @a offset (or the first record), which allows to page backwards
+ * through a file whose records have different sizes.
+ */
+qint64 CaptureReader::rewind(const qint64 offset, const qint64 bytes) const
+{
+    if (!isOpen() || offset - bytes <= firstOffset())
+        return firstOffset();
+
+    // Start the scan from an index entry that is far enough back
+    int entry = indexBefore(offset - bytes);
+    qint64 position = entry >= 0 ? qint64(m_index[size_t(entry)].offset) : firstOffset();
+
+    qint64 result = position;
+    Record record;
+    while (position < offset && read(position, record))
+    {
+        if (offset - position < bytes)
+            break;
+
+        result = position;
+        position += sizeof(Capture::RecordHeader) + record.size;
+    }
+
+    return result;
+}
+
+//----------------------------------------------------------------------------------------
+// Index management
+//----------------------------------------------------------------------------------------
+
+/**
+ * Loads the index written after the last record, returns @c false if the
+ * file has no valid footer.
+ */
+bool CaptureReader::loadIndex()
+{
+    const qint64 footerOffset = m_size - qint64(sizeof(Capture::FileFooter));
+    if (footerOffset < firstOffset())
+        return false;
+
+    Capture::FileFooter footer;
+    memcpy(&footer, m_data + footerOffset, sizeof(footer));
+    if (memcmp(footer.magic, Capture::INDEX_MAGIC, sizeof(footer.magic)) != 0)
+        return false;
+
+    const quint64 indexSize = footer.entryCount * sizeof(Capture::IndexEntry);
+    if (footer.indexOffset < quint64(firstOffset())
+        || footer.indexOffset + indexSize != quint64(footerOffset))
+        return false;
+
+    // Copy the index, its offset in the mapping is not necessarily aligned
+    m_index.resize(size_t(footer.entryCount));
+    if (indexSize > 0)
+        memcpy(m_index.data(), m_data + footer.indexOffset, size_t(indexSize));
+
+    m_endOffset = qint64(footer.indexOffset);
+    m_endTimestampNs = footer.endTimestampNs;
+    m_indexRecovered = false;
+    return true;
+}
+
+/**
+ * Scans all the record headers to rebuild the index of a file that was not
+ * closed properly, a truncated last record is ignored.
+ */
+void CaptureReader::rebuildIndex()
+{
+    m_index.clear();
+    m_endOffset = m_size;
+    m_endTimestampNs = 0;
+    m_indexRecovered = true;
+
+    qint64 offset = firstOffset();
+    Record record;
+    while (read(offset, record))
+    {
+        if (m_index.empty()
+            || quint64(offset) - m_index.back().offset >= Capture::INDEX_SPACING_BYTES
+            || record.timestampNs - m_index.back().timestampNs >= Capture::INDEX_SPACING_NS)
+        {
+            Capture::IndexEntry entry;
+            entry.timestampNs = record.timestampNs;
+            entry.offset = quint64(offset);
+            m_index.push_back(entry);
+        }
+
+        m_endTimestampNs = record.timestampNs;
+        offset += sizeof(Capture::RecordHeader) + record.size;
+    }
+
+    m_endOffset = offset;
+}
+
+/**
+ * Returns the last index entry that starts at or before @a offset, or -1
+ */
+int CaptureReader::indexBefore(const qint64 offset) const
+{
+    auto it = std::upper_bound(m_index.begin(), m_index.end(), quint64(offset),
+                               [](const quint64 value, const Capture::IndexEntry &entry) {
+                                   return value < entry.offset;
+                               });
+
+    return int(it - m_index.begin()) - 1;
+}
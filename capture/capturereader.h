@@ -0,0 +1,72 @@
+#ifndef CAPTUREREADER_H
+#define CAPTUREREADER_H
+
+#include <QFile>
+#include <QString>
+#include <vector>
+#include "captureformat.h"
+
+/**
+ * Read-only access to a capture file written by @c CaptureWriter.
+ *
+ * The file is memory-mapped, so opening it only reads the header & the
+ * index, no matter how large the capture is. Records are returned as views
+ * into the mapping & a timestamp is located with a binary search over the
+ * sparse index followed by a short forward scan.
+ */
+class CaptureReader
+{
+public:
+    struct Record
+    {
+        qint64 offset;
+        quint64 timestampNs;
+        quint16 portId;
+        Capture::Direction direction;
+        const char *data;
+        quint32 size;
+    };
+
+    CaptureReader();
+    ~CaptureReader();
+
+    CaptureReader(const CaptureReader &) = delete;
+    CaptureReader &operator=(const CaptureReader &) = delete;
+
+    bool isOpen() const;
+    QString fileName() const;
+    QString errorString() const;
+    bool indexRecovered() const;
+
+    qint64 startTimeMs() const;
+    quint64 durationNs() const;
+    qint64 fileSize() const;
+    qint64 firstOffset() const;
+    qint64 endOffset() const;
+    int indexSize() const;
+
+    bool open(const QString &fileName);
+    void close();
+
+    bool read(const qint64 offset, Record &record) const;
+    qint64 seek(const quint64 timestampNs) const;
+    qint64 rewind(const qint64 offset, const qint64 bytes) const;
+
+private:
+    bool loadIndex();
+    void rebuildIndex();
+    int indexBefore(const qint64 offset) const;
+
+private:
+    QFile m_file;
+    QString m_errorString;
+    const uchar *m_data;
+    qint64 m_size;
+    qint64 m_endOffset;
+    qint64 m_startTimeMs;
+    quint64 m_endTimestampNs;
+    bool m_indexRecovered;
+    std::vector<Capture::IndexEntry> m_index;
+};
+
+#endif // CAPTUREREADER_H
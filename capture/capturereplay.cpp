@@ -0,0 +1,287 @@
+#include "capturereplay.h"
+#include "serial.h"
+
+/**
+ * Maximum time spent delivering records before returning to the event loop,
+ * so that the UI keeps repainting while playing as fast as possible.
+ */
+static const qint64 MAX_SLICE_NS = 10 * 1000 * 1000;
+
+/**
+ * Resolution & range of the lateness histogram used to compute percentiles
+ */
+static const int LATENESS_BUCKET_US = 50;
+static const int LATENESS_BUCKETS = 1000;
+
+//----------------------------------------------------------------------------------------
+// Constructor function
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function, the records are delivered through @a serial
+ */
+CaptureReplay::CaptureReplay(Serial *serial, QObject *parent)
+    : QObject(parent)
+    , m_serial(serial)
+    , m_mode(OriginalSpeed)
+    , m_speed(1.0)
+    , m_portFilter(-1)
+    , m_running(false)
+    , m_offset(0)
+    , m_firstTimestampNs(0)
+    , m_records(0)
+    , m_bytes(0)
+    , m_elapsedUs(0)
+    , m_latenessSumUs(0)
+    , m_maxLatenessUs(0)
+    , m_latenessSamples(0)
+    , m_latenessHistogram(LATENESS_BUCKETS, 0)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &CaptureReplay::playNext);
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns @c true while the capture is being played
+ */
+bool CaptureReplay::isRunning() const
+{
+    return m_running;
+}
+
+/**
+ * Returns the playback timing mode
+ */
+CaptureReplay::Mode CaptureReplay::mode() const
+{
+    return m_mode;
+}
+
+/**
+ * Returns the playback speed factor used by @c ScaledSpeed
+ */
+double CaptureReplay::speed() const
+{
+    return m_speed;
+}
+
+/**
+ * Returns the ID of the port that is played, or -1 for all ports
+ */
+int CaptureReplay::portFilter() const
+{
+    return m_portFilter;
+}
+
+/**
+ * Returns the description of the last file error
+ */
+QString CaptureReplay::errorString() const
+{
+    return m_reader.errorString();
+}
+
+/**
+ * Returns the throughput & timing accuracy of the current/last playback
+ */
+CaptureReplay::Statistics CaptureReplay::statistics() const
+{
+    Statistics stats;
+    stats.records = m_records;
+    stats.bytes = m_bytes;
+    stats.elapsedUs = m_running ? m_clock.nsecsElapsed() / 1000 : m_elapsedUs;
+    stats.throughput = stats.elapsedUs > 0 ? m_bytes * 1e6 / stats.elapsedUs : 0;
+    stats.maxLatenessUs = m_maxLatenessUs;
+    stats.meanLatenessUs = m_latenessSamples > 0
+                               ? qint64(m_latenessSumUs / qint64(m_latenessSamples))
+                               : 0;
+
+    // 99th percentile from the histogram
+    stats.p99LatenessUs = 0;
+    const quint64 threshold = (m_latenessSamples * 99 + 99) / 100;
+    quint64 count = 0;
+    for (int i = 0; i < m_latenessHistogram.count(); ++i)
+    {
+        count += m_latenessHistogram.at(i);
+        if (count >= threshold && count > 0)
+        {
+            stats.p99LatenessUs = qint64(i + 1) * LATENESS_BUCKET_US;
+            break;
+        }
+    }
+
+    return stats;
+}
+
+//----------------------------------------------------------------------------------------
+// File & playback control
+//----------------------------------------------------------------------------------------
+
+/**
+ * Opens the capture file to play
+ */
+bool CaptureReplay::open(const QString &fileName)
+{
+    stop();
+    return m_reader.open(fileName);
+}
+
+/**
+ * Stops the playback & closes the capture file
+ */
+void CaptureReplay::close()
+{
+    stop();
+    m_reader.close();
+}
+
+/**
+ * Starts playing from the record at @a offset (from the beginning if -1)
+ */
+void CaptureReplay::start(const qint64 offset)
+{
+    stop();
+    if (!m_reader.isOpen())
+        return;
+
+    m_offset = offset < 0 ? m_reader.firstOffset() : offset;
+
+    CaptureReader::Record record;
+    if (!m_reader.read(m_offset, record))
+        return;
+
+    m_firstTimestampNs = record.timestampNs;
+    m_records = 0;
+    m_bytes = 0;
+    m_elapsedUs = 0;
+    m_latenessSumUs = 0;
+    m_maxLatenessUs = 0;
+    m_latenessSamples = 0;
+    m_latenessHistogram.fill(0);
+
+    m_running = true;
+    m_clock.start();
+    Q_EMIT started();
+
+    playNext();
+}
+
+/**
+ * Stops the playback, the statistics are kept
+ */
+void CaptureReplay::stop()
+{
+    m_timer.stop();
+    if (!m_running)
+        return;
+
+    m_running = false;
+    m_elapsedUs = m_clock.nsecsElapsed() / 1000;
+    Q_EMIT finished();
+}
+
+/**
+ * Changes the playback timing mode, applied by the next @c start()
+ */
+void CaptureReplay::setMode(const CaptureReplay::Mode mode)
+{
+    m_mode = mode;
+}
+
+/**
+ * Changes the speed factor used by @c ScaledSpeed (2.0 = twice real time)
+ */
+void CaptureReplay::setSpeed(const double factor)
+{
+    m_speed = qMax(factor, 0.001);
+}
+
+/**
+ * Plays only the records of the port with the given ID (-1 = all ports)
+ */
+void CaptureReplay::setPortFilter(const int portId)
+{
+    m_portFilter = portId;
+}
+
+//----------------------------------------------------------------------------------------
+// Playback loop
+//----------------------------------------------------------------------------------------
+
+/**
+ * Delivers every record that is due, then sleeps until the next one is due
+ * (or yields to the event loop when playing as fast as possible).
+ */
+void CaptureReplay::playNext()
+{
+    if (!m_running)
+        return;
+
+    const qint64 sliceStart = m_clock.nsecsElapsed();
+    CaptureReader::Record record;
+    while (m_reader.read(m_offset, record))
+    {
+        const qint64 now = m_clock.nsecsElapsed();
+        const qint64 due = scheduledNs(record.timestampNs);
+        if (m_mode != AsFastAsPossible && due > now)
+        {
+            // Round up, a 0 ms timer would spin until the record is due
+            m_timer.start(int(qMax<qint64>((due - now + 999999) / 1000000, 1)));
+            Q_EMIT progress(record.timestampNs);
+            return;
+        }
+
+        if (m_mode == AsFastAsPossible && now - sliceStart > MAX_SLICE_NS)
+        {
+            m_timer.start(0);
+            Q_EMIT progress(record.timestampNs);
+            return;
+        }
+
+        m_offset += sizeof(Capture::RecordHeader) + record.size;
+        if (record.direction != Capture::Received)
+            continue;
+
+        if (m_portFilter >= 0 && record.portId != m_portFilter)
+            continue;
+
+        if (m_mode != AsFastAsPossible)
+            recordLateness(now - due);
+
+        m_serial->replayData(record.data, int(record.size));
+        ++m_records;
+        m_bytes += record.size;
+    }
+
+    stop();
+}
+
+/**
+ * Returns the playback time (ns since @c start()) at which the record with
+ * the given @a timestampNs must be delivered
+ */
+qint64 CaptureReplay::scheduledNs(const quint64 timestampNs) const
+{
+    const qint64 delta = qint64(timestampNs - m_firstTimestampNs);
+    if (m_mode == ScaledSpeed)
+        return qint64(delta / m_speed);
+
+    return delta;
+}
+
+/**
+ * Adds a lateness sample to the timing accuracy statistics
+ */
+void CaptureReplay::recordLateness(const qint64 latenessNs)
+{
+    const qint64 us = latenessNs / 1000;
+    m_latenessSumUs += us;
+    m_maxLatenessUs = qMax(m_maxLatenessUs, us);
+    ++m_latenessSamples;
+    ++m_latenessHistogram[qMin(int(us / LATENESS_BUCKET_US), LATENESS_BUCKETS - 1)];
+}
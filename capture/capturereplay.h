@@ -0,0 +1,99 @@
+#ifndef CAPTUREREPLAY_H
+#define CAPTUREREPLAY_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+#include "capturereader.h"
+
+class Serial;
+
+/**
+ * Plays the data received in a capture file back through @c Serial, so that
+ * it reaches every consumer of @c Serial::dataAvailable() and
+ * @c Serial::dataReceived() exactly like live data.
+ *
+ * Playback can follow the recorded timing (optionally scaled), or deliver
+ * the records as fast as possible, in which case the statistics measure the
+ * throughput of the whole decode/render pipeline. When the recorded timing
+ * is followed, the lateness of every record versus its scheduled time is
+ * measured to report the timing accuracy.
+ */
+class CaptureReplay : public QObject
+{
+    Q_OBJECT
+public:
+    enum Mode
+    {
+        OriginalSpeed,
+        ScaledSpeed,
+        AsFastAsPossible,
+    };
+
+    struct Statistics
+    {
+        quint64 records;
+        quint64 bytes;
+        qint64 elapsedUs;
+        double throughput;
+        qint64 meanLatenessUs;
+        qint64 p99LatenessUs;
+        qint64 maxLatenessUs;
+    };
+
+    explicit CaptureReplay(Serial *serial, QObject *parent = nullptr);
+
+    bool isRunning() const;
+    Mode mode() const;
+    double speed() const;
+    int portFilter() const;
+    QString errorString() const;
+    Statistics statistics() const;
+
+    bool open(const QString &fileName);
+    void close();
+
+Q_SIGNALS:
+    void started();
+    void finished();
+    void progress(const quint64 timestampNs);
+
+public Q_SLOTS:
+    void start(const qint64 offset = -1);
+    void stop();
+    void setMode(const Mode mode);
+    void setSpeed(const double factor);
+    void setPortFilter(const int portId);
+
+private Q_SLOTS:
+    void playNext();
+
+private:
+    qint64 scheduledNs(const quint64 timestampNs) const;
+    void recordLateness(const qint64 latenessNs);
+
+private:
+    Serial *m_serial;
+    CaptureReader m_reader;
+
+    Mode m_mode;
+    double m_speed;
+    int m_portFilter;
+    bool m_running;
+
+    qint64 m_offset;
+    quint64 m_firstTimestampNs;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+
+    quint64 m_records;
+    quint64 m_bytes;
+    qint64 m_elapsedUs;
+    qint64 m_latenessSumUs;
+    qint64 m_maxLatenessUs;
+    quint64 m_latenessSamples;
+    QVector<quint32> m_latenessHistogram;
+};
+
+#endif // CAPTUREREPLAY_H
@@ -0,0 +1,454 @@
+#include "capturewriter.h"
+#include <QDateTime>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#    include <io.h>
+#else
+#    include <unistd.h>
+#endif
+
+/**
+ * Default size of each of the two record buffers. At 2 Mbaud a port delivers
+ * ~200 KB/s, so one buffer holds several seconds of traffic of a dozen ports
+ * while the other one is being written.
+ */
+static const int DEFAULT_BUFFER_SIZE = 4 * 1024 * 1024;
+
+/**
+ * Maximum time that received data waits in memory before being written
+ */
+static const int FLUSH_INTERVAL_MS = 250;
+
+/**
+ * Thread that runs the write loop of a @c CaptureWriter
+ */
+class CaptureWriterThread : public QThread
+{
+public:
+    explicit CaptureWriterThread(CaptureWriter *writer)
+        : m_writer(writer)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        m_writer->writerLoop();
+    }
+
+private:
+    CaptureWriter *m_writer;
+};
+
+//----------------------------------------------------------------------------------------
+// Constructor/destructor
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function
+ */
+CaptureWriter::CaptureWriter()
+    : m_thread(Q_NULLPTR)
+    , m_syncPolicy(SyncPeriodic)
+    , m_syncIntervalMs(1000)
+    , m_bufferSize(DEFAULT_BUFFER_SIZE)
+    , m_lastTimestampNs(0)
+    , m_active(0)
+    , m_queued(-1)
+    , m_open(false)
+    , m_stop(false)
+{
+    m_fill[0] = 0;
+    m_fill[1] = 0;
+}
+
+/**
+ * Destructor function, flushes the pending records & closes the file
+ */
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns @c true if a capture file is being recorded
+ */
+bool CaptureWriter::isOpen() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_open;
+}
+
+/**
+ * Returns the path of the capture file
+ */
+QString CaptureWriter::fileName() const
+{
+    return m_file.fileName();
+}
+
+/**
+ * Returns the description of the last file error
+ */
+QString CaptureWriter::errorString() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_errorString;
+}
+
+/**
+ * Returns the current capture timestamp in nanoseconds
+ */
+qint64 CaptureWriter::timestampNs() const
+{
+    return m_clock.isValid() ? m_clock.nsecsElapsed() : 0;
+}
+
+/**
+ * Returns a snapshot of the capture counters. @c throughput is the average
+ * disk write speed (bytes/s) while the writer thread is actually writing.
+ */
+CaptureWriter::Statistics CaptureWriter::statistics() const
+{
+    Statistics stats;
+    stats.records = m_records.load();
+    stats.payloadBytes = m_payloadBytes.load();
+    stats.bytesWritten = m_bytesWritten.load();
+    stats.writeCalls = m_writeCalls.load();
+    stats.syncs = m_syncs.load();
+    stats.droppedRecords = m_droppedRecords.load();
+    stats.droppedBytes = m_droppedBytes.load();
+    stats.maxWriteUs = m_maxWriteUs.load();
+
+    const qint64 writeTimeUs = m_writeTimeUs.load();
+    stats.throughput = writeTimeUs > 0 ? stats.bytesWritten * 1e6 / writeTimeUs : 0;
+    return stats;
+}
+
+/**
+ * Changes the size of each record buffer, applied by the next @c open()
+ */
+void CaptureWriter::setBufferSize(const int bytes)
+{
+    m_bufferSize = qMax(bytes, 64 * 1024);
+}
+
+/**
+ * Selects when the written data is forced to the storage device:
+ * - @c SyncNever: left to the operating system (fastest)
+ * - @c SyncPeriodic: at most every @a intervalMs milliseconds
+ * - @c SyncEveryWrite: after every buffer write (safest)
+ */
+void CaptureWriter::setSyncPolicy(const CaptureWriter::SyncPolicy policy,
+                                  const int intervalMs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_syncPolicy = policy;
+    m_syncIntervalMs = qMax(intervalMs, 1);
+}
+
+//----------------------------------------------------------------------------------------
+// File control
+//----------------------------------------------------------------------------------------
+
+/**
+ * Creates the capture file at @a fileName & starts the writer thread
+ */
+bool CaptureWriter::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered))
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    // Write the file header, the timestamps are relative to this instant
+    Capture::FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, Capture::MAGIC, sizeof(header.magic));
+    header.version = Capture::VERSION;
+    header.headerSize = sizeof(header);
+    header.startTimeMs = QDateTime::currentMSecsSinceEpoch();
+    m_clock.start();
+
+    if (m_file.write(reinterpret_cast<const char *>(&header), sizeof(header))
+        != qint64(sizeof(header)))
+    {
+        m_errorString = m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    // Preallocate both buffers, nothing is allocated while recording
+    m_index.clear();
+    m_lastTimestampNs = 0;
+    for (int i = 0; i < 2; ++i)
+    {
+        m_buffers[i].resize(size_t(m_bufferSize));
+        m_fill[i] = 0;
+    }
+
+    m_records.store(0);
+    m_payloadBytes.store(0);
+    m_bytesWritten.store(sizeof(header));
+    m_writeCalls.store(0);
+    m_syncs.store(0);
+    m_droppedRecords.store(0);
+    m_droppedBytes.store(0);
+    m_maxWriteUs.store(0);
+    m_writeTimeUs.store(0);
+
+    m_active = 0;
+    m_queued = -1;
+    m_stop = false;
+    m_open = true;
+    m_errorString.clear();
+
+    m_thread = new CaptureWriterThread(this);
+    m_thread->setObjectName("CaptureWriter");
+    m_thread->start();
+    return true;
+}
+
+/**
+ * Writes the pending records, stops the writer thread & closes the file
+ */
+void CaptureWriter::close()
+{
+    if (m_thread == Q_NULLPTR)
+        return;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_open = false;
+        m_stop = true;
+        m_wakeWriter.wakeOne();
+    }
+
+    m_thread->wait();
+    delete m_thread;
+    m_thread = Q_NULLPTR;
+
+    if (!writeIndex())
+        m_errorString = m_file.errorString();
+
+    if (m_syncPolicy != SyncNever)
+        sync();
+
+    m_file.close();
+}
+
+//----------------------------------------------------------------------------------------
+// Producer functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Records @a size bytes of @a data, returns @c false if the record had to be
+ * dropped.
+ */
+bool CaptureWriter::append(const quint16 portId, const Capture::Direction direction,
+                           const char *data, const int size)
+{
+    return append(portId, direction, data, size, Q_NULLPTR, 0);
+}
+
+/**
+ * Records the concatenation of @a first & @a second as a single record, which
+ * allows to capture the two regions of a ring buffer without copying them
+ * first. Returns @c false if the record had to be dropped.
+ */
+bool CaptureWriter::append(const quint16 portId, const Capture::Direction direction,
+                           const char *first, const int firstSize,
+                           const char *second, const int secondSize)
+{
+    const size_t payload = size_t(firstSize) + size_t(secondSize);
+    const size_t bytes = sizeof(Capture::RecordHeader) + payload;
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_open)
+        return false;
+
+    // Hand the active buffer to the writer if the record does not fit
+    if (m_fill[m_active] + bytes > m_buffers[m_active].size())
+    {
+        if (m_queued >= 0 || bytes > m_buffers[m_active].size())
+        {
+            m_droppedRecords.fetch_add(1, std::memory_order_relaxed);
+            m_droppedBytes.fetch_add(payload, std::memory_order_relaxed);
+            return false;
+        }
+
+        m_queued = m_active;
+        m_active ^= 1;
+        m_wakeWriter.wakeOne();
+    }
+
+    // Timestamp inside the lock, so that records are stored in time order
+    Capture::RecordHeader header;
+    header.timestampNs = quint64(m_clock.nsecsElapsed());
+    header.size = quint32(payload);
+    header.portId = portId;
+    header.direction = quint8(direction);
+    header.reserved = 0;
+
+    char *dst = m_buffers[m_active].data() + m_fill[m_active];
+    memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    if (firstSize > 0)
+        memcpy(dst, first, size_t(firstSize));
+    if (secondSize > 0)
+        memcpy(dst + firstSize, second, size_t(secondSize));
+
+    m_fill[m_active] += bytes;
+    m_records.fetch_add(1, std::memory_order_relaxed);
+    m_payloadBytes.fetch_add(payload, std::memory_order_relaxed);
+    return true;
+}
+
+//----------------------------------------------------------------------------------------
+// Writer thread
+//----------------------------------------------------------------------------------------
+
+/**
+ * Writes every full buffer (and the partially filled active buffer at least
+ * every @c FLUSH_INTERVAL_MS) to the file, the lock is released during the
+ * write so the producers keep filling the other buffer.
+ */
+void CaptureWriter::writerLoop()
+{
+    QElapsedTimer sinceSync;
+    sinceSync.start();
+
+    m_mutex.lock();
+    forever
+    {
+        if (m_queued < 0 && !m_stop)
+            m_wakeWriter.wait(&m_mutex, FLUSH_INTERVAL_MS);
+
+        if (m_queued < 0 && m_fill[m_active] > 0)
+        {
+            m_queued = m_active;
+            m_active ^= 1;
+        }
+
+        if (m_queued < 0)
+        {
+            if (m_stop)
+                break;
+
+            continue;
+        }
+
+        const int index = m_queued;
+        const size_t size = m_fill[index];
+        const SyncPolicy policy = m_syncPolicy;
+        const int syncIntervalMs = m_syncIntervalMs;
+        m_mutex.unlock();
+
+        indexBuffer(m_buffers[index].data(), size, m_bytesWritten.load());
+
+        QElapsedTimer timer;
+        timer.start();
+        const qint64 written = m_file.write(m_buffers[index].data(), qint64(size));
+        const qint64 elapsedUs = timer.nsecsElapsed() / 1000;
+
+        if (written > 0)
+            m_bytesWritten.fetch_add(quint64(written));
+
+        m_writeCalls.fetch_add(1);
+        m_writeTimeUs.fetch_add(elapsedUs);
+        if (elapsedUs > m_maxWriteUs.load())
+            m_maxWriteUs.store(elapsedUs);
+
+        if (policy == SyncEveryWrite
+            || (policy == SyncPeriodic && sinceSync.elapsed() >= syncIntervalMs))
+        {
+            sync();
+            sinceSync.restart();
+        }
+
+        m_mutex.lock();
+        if (written != qint64(size))
+            m_errorString = m_file.errorString();
+
+        m_fill[index] = 0;
+        m_queued = -1;
+    }
+
+    m_mutex.unlock();
+}
+
+/**
+ * Adds an index entry for the records of the buffer at @a data that start at
+ * least @c INDEX_SPACING_BYTES or @c INDEX_SPACING_NS after the previous
+ * entry. Only the record headers are read.
+ */
+void CaptureWriter::indexBuffer(const char *data, const size_t size,
+                                const quint64 fileOffset)
+{
+    size_t position = 0;
+    while (position + sizeof(Capture::RecordHeader) <= size)
+    {
+        Capture::RecordHeader header;
+        memcpy(&header, data + position, sizeof(header));
+
+        const quint64 offset = fileOffset + position;
+        if (m_index.empty()
+            || offset - m_index.back().offset >= Capture::INDEX_SPACING_BYTES
+            || header.timestampNs - m_index.back().timestampNs >= Capture::INDEX_SPACING_NS)
+        {
+            Capture::IndexEntry entry;
+            entry.timestampNs = header.timestampNs;
+            entry.offset = offset;
+            m_index.push_back(entry);
+        }
+
+        m_lastTimestampNs = header.timestampNs;
+        position += sizeof(header) + header.size;
+    }
+}
+
+/**
+ * Appends the index & the footer after the last record
+ */
+bool CaptureWriter::writeIndex()
+{
+    Capture::FileFooter footer;
+    memcpy(footer.magic, Capture::INDEX_MAGIC, sizeof(footer.magic));
+    footer.indexOffset = m_bytesWritten.load();
+    footer.entryCount = m_index.size();
+    footer.endTimestampNs = m_lastTimestampNs;
+
+    const qint64 indexSize = qint64(m_index.size() * sizeof(Capture::IndexEntry));
+    if (indexSize > 0
+        && m_file.write(reinterpret_cast<const char *>(m_index.data()), indexSize) != indexSize)
+        return false;
+
+    return m_file.write(reinterpret_cast<const char *>(&footer), sizeof(footer))
+           == qint64(sizeof(footer));
+}
+
+/**
+ * Forces the data written so far to the storage device
+ */
+void CaptureWriter::sync()
+{
+    if (!m_file.isOpen())
+        return;
+
+#ifdef Q_OS_WIN
+    _commit(m_file.handle());
+#else
+    ::fsync(m_file.handle());
+#endif
+
+    m_syncs.fetch_add(1);
+}
@@ -0,0 +1,115 @@
+#ifndef CAPTUREWRITER_H
+#define CAPTUREWRITER_H
+
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <atomic>
+#include <vector>
+#include "captureformat.h"
+
+/**
+ * Records the serial traffic of any number of ports into a binary capture
+ * file (see @c captureformat.h).
+ *
+ * Producers only copy the record into the active in-memory buffer. A
+ * dedicated writer thread swaps the two buffers & writes the full one with a
+ * single large sequential write, so the disk never stalls the receive path.
+ * If the writer falls behind by a whole buffer, new records are dropped &
+ * counted instead of blocking the producer.
+ *
+ * The writer thread also builds the sparse time/offset index, which is
+ * appended to the file by @c close().
+ *
+ * @note @c append() is thread-safe, @c open() & @c close() must be called
+ *       from one thread.
+ */
+class CaptureWriter
+{
+public:
+    enum SyncPolicy
+    {
+        SyncNever,
+        SyncPeriodic,
+        SyncEveryWrite,
+    };
+
+    struct Statistics
+    {
+        quint64 records;
+        quint64 payloadBytes;
+        quint64 bytesWritten;
+        quint64 writeCalls;
+        quint64 syncs;
+        quint64 droppedRecords;
+        quint64 droppedBytes;
+        qint64 maxWriteUs;
+        double throughput;
+    };
+
+    CaptureWriter();
+    ~CaptureWriter();
+
+    CaptureWriter(const CaptureWriter &) = delete;
+    CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+    bool isOpen() const;
+    QString fileName() const;
+    QString errorString() const;
+    qint64 timestampNs() const;
+    Statistics statistics() const;
+
+    void setBufferSize(const int bytes);
+    void setSyncPolicy(const SyncPolicy policy, const int intervalMs = 1000);
+
+    bool open(const QString &fileName);
+    void close();
+
+    bool append(const quint16 portId, const Capture::Direction direction,
+                const char *data, const int size);
+    bool append(const quint16 portId, const Capture::Direction direction,
+                const char *first, const int firstSize,
+                const char *second, const int secondSize);
+
+private:
+    friend class CaptureWriterThread;
+    void writerLoop();
+    void indexBuffer(const char *data, const size_t size, const quint64 fileOffset);
+    bool writeIndex();
+    void sync();
+
+private:
+    QFile m_file;
+    QThread *m_thread;
+    QElapsedTimer m_clock;
+    QString m_errorString;
+
+    SyncPolicy m_syncPolicy;
+    int m_syncIntervalMs;
+    int m_bufferSize;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_wakeWriter;
+    std::vector<char> m_buffers[2];
+    std::vector<Capture::IndexEntry> m_index;
+    quint64 m_lastTimestampNs;
+    size_t m_fill[2];
+    int m_active;
+    int m_queued;
+    bool m_open;
+    bool m_stop;
+
+    std::atomic<quint64> m_records;
+    std::atomic<quint64> m_payloadBytes;
+    std::atomic<quint64> m_bytesWritten;
+    std::atomic<quint64> m_writeCalls;
+    std::atomic<quint64> m_syncs;
+    std::atomic<quint64> m_droppedRecords;
+    std::atomic<quint64> m_droppedBytes;
+    std::atomic<qint64> m_maxWriteUs;
+    std::atomic<qint64> m_writeTimeUs;
+};
+
+#endif // CAPTUREWRITER_H
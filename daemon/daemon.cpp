@@ -0,0 +1,636 @@
+#include "daemon.h"
+#include "Instrumentation.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QSocketNotifier>
+#include <QTextStream>
+
+#ifdef Q_OS_UNIX
+#    include <csignal>
+#    include <sys/resource.h>
+#    include <sys/socket.h>
+#    include <unistd.h>
+#endif
+
+/**
+ * Default interval between two metrics reports
+ */
+static const int DEFAULT_METRICS_INTERVAL_MS = 10000;
+
+#ifdef Q_OS_UNIX
+/**
+ * Self-pipe used to move the Unix signals to the event loop, only
+ * async-signal-safe calls are allowed in the handler itself
+ */
+static int SIGNAL_FD[2] = { -1, -1 };
+
+static void signalHandler(int signal)
+{
+    const char number = char(signal);
+    const ssize_t ret = ::write(SIGNAL_FD[0], &number, sizeof(number));
+    Q_UNUSED(ret);
+}
+#endif
+
+/**
+ * Receive buffer of every monitored port
+ */
+static const quint32 MONITOR_RX_BUFFER_SIZE = 256 * 1024;
+
+/**
+ * Returns the framing described by the "frameDelimiter" (hex) or
+ * "frameTimeoutUs" keys of @a config, lines by default
+ */
+static Deframer::Configuration framingFrom(const QJsonObject &config)
+{
+    Deframer::Configuration framing;
+    if (config.contains("frameTimeoutUs"))
+    {
+        framing.mode = Deframer::Timeout;
+        framing.interCharTimeoutUs = qint64(config.value("frameTimeoutUs").toDouble());
+    }
+    else if (config.contains("frameDelimiter"))
+    {
+        framing.mode = Deframer::Delimiter;
+        framing.delimiter = QByteArray::fromHex(config.value("frameDelimiter").toString().toLatin1());
+    }
+
+    return framing;
+}
+
+/**
+ * Returns a printable name for the given Modbus @a error
+ */
+static const char *errorName(const ModbusMaster::Error error)
+{
+    switch (error)
+    {
+        case ModbusMaster::NoError:
+            return "ok";
+        case ModbusMaster::TimeoutError:
+            return "timeout";
+        case ModbusMaster::CrcError:
+            return "crc";
+        case ModbusMaster::ExceptionError:
+            return "exception";
+        case ModbusMaster::InvalidResponseError:
+            return "invalid";
+        case ModbusMaster::WriteError:
+            return "write";
+    }
+
+    return "unknown";
+}
+
+//----------------------------------------------------------------------------------------
+// Constructor & destructor functions
+//----------------------------------------------------------------------------------------
+
+Daemon::Daemon(QObject *parent)
+    : QObject(parent)
+    , m_serial(Serial::instance())
+    , m_master(&m_serial)
+    , m_scheduler(&m_master)
+    , m_signalNotifier(Q_NULLPTR)
+{
+    connect(&m_scheduler, &PollScheduler::itemReply, this, &Daemon::onItemReply);
+    connect(&m_metricsTimer, &QTimer::timeout, this, &Daemon::writeMetrics);
+    connect(&m_serial, &Serial::connectionError, this, [](const QString &name) {
+        qWarning() << "Connection error on" << name;
+    });
+    connect(&m_serial, &Serial::reconnected, this, [](const qint64 outageMs) {
+        qWarning() << "Reconnected after" << outageMs << "ms";
+    });
+}
+
+Daemon::~Daemon()
+{
+    stop();
+}
+
+//----------------------------------------------------------------------------------------
+// Configuration
+//----------------------------------------------------------------------------------------
+
+/**
+ * Reads the JSON configuration in @a fileName, see the class description
+ * for its format
+ */
+bool Daemon::loadConfiguration(const QString &fileName, QString *error)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        *error = QString("Cannot open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    QJsonParseError parseError;
+    const auto document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError || !document.isObject())
+    {
+        *error = QString("Invalid configuration %1: %2")
+                     .arg(fileName, parseError.errorString());
+        return false;
+    }
+
+    m_config = document.object();
+    if (m_config.value("port").toString().isEmpty())
+    {
+        *error = QString("No \"port\" in %1").arg(fileName);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Applies the serial settings of the configuration, the textual values are
+ * the entries of the option lists of @c Serial
+ */
+bool Daemon::configureSerial(QString *error)
+{
+    struct Option
+    {
+        const char *key;
+        const char *defaultValue;
+        QStringList values;
+        void (Serial::*setter)(const quint8);
+    };
+
+    const Option options[] = {
+        { "dataBits", "8", m_serial.dataBitsList(), &Serial::setDataBits },
+        { "parity", "None", m_serial.parityList(), &Serial::setParity },
+        { "stopBits", "1", m_serial.stopBitsList(), &Serial::setStopBits },
+        { "flowControl", "None", m_serial.flowControlList(), &Serial::setFlowControl },
+    };
+
+    for (const auto &option : options)
+    {
+        const auto value = m_config.value(option.key).toVariant().toString();
+        const int index = option.values.indexOf(value.isEmpty() ? option.defaultValue : value);
+        if (index < 0)
+        {
+            *error = QString("Invalid %1 \"%2\", expected one of: %3")
+                         .arg(option.key, value, option.values.join(", "));
+            return false;
+        }
+
+        (m_serial.*option.setter)(quint8(index));
+    }
+
+    m_serial.setBaudRate(m_config.value("baudRate").toInt(9600));
+    m_serial.setIoThreadEnabled(m_config.value("ioThread").toBool(true));
+    m_serial.setAutoReconnect(m_config.value("autoReconnect").toBool(true));
+    return true;
+}
+
+//----------------------------------------------------------------------------------------
+// Start & stop
+//----------------------------------------------------------------------------------------
+
+/**
+ * Opens the capture file, the value log & the serial port, registers the
+ * poll items & starts polling
+ */
+bool Daemon::start(QString *error)
+{
+    if (!configureSerial(error))
+        return false;
+
+    Misc::Instrumentation::instance().setEnabled(
+        m_config.value("instrumentation").toBool(true));
+
+    // Capture everything from the first byte on
+    const auto capture = m_config.value("capture").toString();
+    if (!capture.isEmpty())
+    {
+        m_captureWriter.setSyncPolicy(CaptureWriter::SyncPeriodic, 1000);
+        if (!m_captureWriter.open(capture))
+        {
+            *error = QString("Cannot open capture %1: %2")
+                         .arg(capture, m_captureWriter.errorString());
+            return false;
+        }
+
+        m_serial.setCaptureWriter(&m_captureWriter);
+    }
+
+    // Value log
+    const auto log = m_config.value("log").toString();
+    if (!log.isEmpty())
+    {
+        m_log.setFileName(log);
+        if (!m_log.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+        {
+            *error = QString("Cannot open log %1: %2").arg(log, m_log.errorString());
+            return false;
+        }
+
+        if (m_log.size() == 0)
+            m_log.write("time,item,slave,function,address,status,round_trip_us,values\n");
+    }
+
+    // Local clients
+    if (!startServer(error))
+        return false;
+
+    // Listen-only ports, decoded on the decode pool
+    if (!startMonitors(error))
+        return false;
+
+    // Serial port, the reconnector keeps trying if it is not present yet
+    const auto port = m_config.value("port").toString();
+    if (!m_serial.open(port, QIODevice::ReadWrite))
+    {
+        qWarning() << "Cannot open" << port << "- waiting for the device";
+        m_serial.waitForDevice(port, QIODevice::ReadWrite);
+    }
+
+    // Poll items
+    m_master.setResponseTimeout(m_config.value("responseTimeoutMs").toInt(100));
+    const auto items = m_config.value("poll").toArray();
+    for (int i = 0; i < items.count(); ++i)
+    {
+        const auto item = items.at(i).toObject();
+
+        ModbusMaster::Request request;
+        request.id = 0;
+        request.slave = quint8(item.value("slave").toInt(1));
+        request.function = quint8(item.value("function").toInt(ModbusMaster::ReadHoldingRegisters));
+        request.address = quint16(item.value("address").toInt());
+        request.count = quint16(item.value("count").toInt(1));
+
+        const int period = item.value("periodMs").toInt(1000);
+        const int id = m_scheduler.addItem(request, period, item.value("priority").toInt());
+        m_itemNames.insert(id, item.value("name").toString(QString("item%1").arg(i)));
+    }
+
+    m_scheduler.start();
+
+    // Metrics
+    const auto metrics = m_config.value("metrics").toObject();
+    m_metricsFile = metrics.value("file").toString();
+    m_metricsTimer.start(metrics.value("intervalMs").toInt(DEFAULT_METRICS_INTERVAL_MS));
+
+    installSignalHandlers();
+    m_uptime.start();
+    return true;
+}
+
+/**
+ * Stops polling, closes the port & flushes the capture file & log
+ */
+void Daemon::stop()
+{
+    m_metricsTimer.stop();
+    m_scheduler.stop();
+    m_master.clear();
+
+    m_server.setSource(Q_NULLPTR);
+    m_server.close();
+
+    Q_FOREACH (SerialChannel *channel, m_monitors)
+    {
+        channel->disconnect(this);
+        channel->setCaptureWriter(Q_NULLPTR);
+        PortManager::instance().close(channel);
+    }
+
+    m_monitors.clear();
+    m_serial.disconnectDevice();
+    m_serial.setCaptureWriter(Q_NULLPTR);
+    m_captureWriter.close();
+
+    if (m_log.isOpen())
+        m_log.close();
+
+    // Leave a final report behind
+    if (m_uptime.isValid())
+    {
+        if (!m_metricsFile.isEmpty())
+            writeMetrics();
+
+        m_uptime.invalidate();
+    }
+}
+
+/**
+ * Starts the listeners of the @c server section of the configuration, if any
+ */
+bool Daemon::startServer(QString *error)
+{
+    const auto config = m_config.value("server").toObject();
+    if (config.isEmpty())
+        return true;
+
+    const auto overflow = config.value("overflow").toString("drop");
+    if (overflow != "drop" && overflow != "disconnect")
+    {
+        *error = QString("Invalid server overflow \"%1\", expected drop or disconnect")
+                     .arg(overflow);
+        return false;
+    }
+
+    m_server.setOverflowPolicy(overflow == "drop" ? FanoutServer::DropOldest
+                                                  : FanoutServer::Disconnect);
+    m_server.setMaxClients(config.value("maxClients").toInt(m_server.maxClients()));
+    m_server.setMaxQueueBytes(
+        qint64(config.value("maxQueueBytes").toDouble(double(m_server.maxQueueBytes()))));
+
+    m_server.setFraming(framingFrom(config));
+
+    // Local clients only unless another address is given explicitly
+    const QHostAddress address(config.value("address").toString("127.0.0.1"));
+    const auto tcpPort = config.value("tcpPort").toInt();
+    const auto frameTcpPort = config.value("frameTcpPort").toInt();
+    const auto localName = config.value("localName").toString();
+
+    bool ok = true;
+    if (tcpPort > 0)
+        ok = ok && m_server.listen(address, quint16(tcpPort), FanoutServer::RawStream);
+    if (frameTcpPort > 0)
+        ok = ok && m_server.listen(address, quint16(frameTcpPort), FanoutServer::FrameStream);
+    if (!localName.isEmpty())
+    {
+        ok = ok && m_server.listenLocal(localName, FanoutServer::RawStream);
+        ok = ok && m_server.listenLocal(localName + "-frames", FanoutServer::FrameStream);
+    }
+
+    if (!ok)
+    {
+        *error = QString("Cannot start the server: %1").arg(m_server.errorString());
+        m_server.close();
+        return false;
+    }
+
+    m_server.setSource(&m_serial);
+    return true;
+}
+
+/**
+ * Opens the ports of the @c monitors section of the configuration on the
+ * decode pool of @c PortManager
+ */
+bool Daemon::startMonitors(QString *error)
+{
+    const auto monitors = m_config.value("monitors").toArray();
+    for (int i = 0; i < monitors.count(); ++i)
+    {
+        const auto monitor = monitors.at(i).toObject();
+
+        SerialWorker::Configuration config;
+        config.systemLocation = monitor.value("port").toString();
+        config.baudRate = monitor.value("baudRate").toInt(9600);
+        config.parity = QSerialPort::NoParity;
+        config.dataBits = QSerialPort::Data8;
+        config.stopBits = QSerialPort::OneStop;
+        config.flowControl = QSerialPort::NoFlowControl;
+        config.openMode = QIODevice::ReadOnly;
+
+        SerialChannel *channel = PortManager::instance().open(config, MONITOR_RX_BUFFER_SIZE,
+                                                              PortManager::DecodePool);
+        if (!channel)
+        {
+            *error = QString("Cannot open monitored port %1").arg(config.systemLocation);
+            return false;
+        }
+
+        if (m_captureWriter.isOpen())
+            channel->setCaptureWriter(&m_captureWriter);
+
+        // Frames are found on the pool thread, only whole frames come here
+        channel->setFraming(framingFrom(monitor));
+        connect(channel, &SerialChannel::frameReceived, this, &Daemon::onMonitorFrame);
+        m_monitors.append(channel);
+    }
+
+    return true;
+}
+
+/**
+ * Republishes a frame of a monitored port to the frame stream of the server
+ */
+void Daemon::onMonitorFrame(const int channelId, const QByteArray &frame)
+{
+    Q_UNUSED(channelId);
+    m_server.publishFrame(frame.constData(), frame.size());
+}
+
+//----------------------------------------------------------------------------------------
+// Metrics
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns a plain-text report with the data path counters, the poll &
+ * capture statistics and the resource usage of the process
+ */
+QString Daemon::metrics() const
+{
+    QString text;
+    QTextStream stream(&text);
+
+    stream << "uptime_s " << (m_uptime.isValid() ? m_uptime.elapsed() / 1000 : 0) << "\n";
+    stream << "port_open " << (m_serial.isOpen() ? 1 : 0) << "\n";
+    stream << "rx_dropped_bytes " << m_serial.droppedBytes() << "\n";
+
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        stream << "cpu_user_ms "
+               << qint64(usage.ru_utime.tv_sec) * 1000 + usage.ru_utime.tv_usec / 1000 << "\n";
+        stream << "cpu_system_ms "
+               << qint64(usage.ru_stime.tv_sec) * 1000 + usage.ru_stime.tv_usec / 1000 << "\n";
+        stream << "max_rss_kb " << qint64(usage.ru_maxrss) << "\n";
+    }
+#endif
+#ifdef Q_OS_LINUX
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly))
+    {
+        const auto fields = statm.readAll().split(' ');
+        if (fields.count() > 1)
+            stream << "rss_kb " << fields.at(1).toLongLong() * (sysconf(_SC_PAGESIZE) / 1024)
+                   << "\n";
+    }
+#endif
+
+    const auto &master = m_master.statistics();
+    stream << "\n# Modbus\n";
+    stream << "bus_load " << m_scheduler.busLoad() << "\n";
+    stream << "overloaded " << (m_scheduler.overloaded() ? 1 : 0) << "\n";
+    stream << "requests " << master.requests << "\n";
+    stream << "completed " << master.completed << "\n";
+    stream << "timeouts " << master.timeouts << "\n";
+    stream << "crc_errors " << master.crcErrors << "\n";
+    stream << "exceptions " << master.exceptions << "\n";
+    stream << "unexpected_bytes " << master.unexpectedBytes << "\n";
+
+    for (const int id : m_scheduler.itemIds())
+    {
+        const auto item = m_scheduler.itemStatistics(id);
+        stream << "item " << m_itemNames.value(id) << " polls=" << item.polls
+               << " replies=" << item.replies << " errors=" << item.errors
+               << " skipped=" << item.skipped << " rate=" << item.achievedRate
+               << " jitter_us=" << item.jitterUs << " rtt_us=" << item.roundTripUs << "\n";
+    }
+
+    if (!m_monitors.isEmpty())
+    {
+        stream << "\n# Monitors\n";
+        stream << "decode_threads " << PortManager::instance().decodeThreadCount() << "\n";
+        Q_FOREACH (const SerialChannel *channel, m_monitors)
+        {
+            stream << "monitor " << channel->configuration().systemLocation
+                   << " open=" << (channel->isOpen() ? 1 : 0)
+                   << " bytes=" << channel->bytesReceived()
+                   << " frames=" << channel->framesReceived()
+                   << " dropped=" << channel->droppedBytes() << "\n";
+        }
+    }
+
+    if (m_captureWriter.isOpen())
+    {
+        const auto capture = m_captureWriter.statistics();
+        stream << "\n# Capture\n";
+        stream << "records " << capture.records << "\n";
+        stream << "bytes_written " << capture.bytesWritten << "\n";
+        stream << "dropped_records " << capture.droppedRecords << "\n";
+        stream << "max_write_us " << capture.maxWriteUs << "\n";
+    }
+
+    if (m_server.isListening())
+    {
+        const auto &server = m_server.statistics();
+        stream << "\n# Server\n";
+        stream << "clients " << m_server.clientCount() << "\n";
+        stream << "connections " << server.connections << "\n";
+        stream << "slow_disconnects " << server.slowDisconnects << "\n";
+        stream << "published_bytes " << server.publishedBytes << "\n";
+        stream << "published_frames " << server.publishedFrames << "\n";
+        stream << "dropped_chunks " << server.droppedChunks << "\n";
+        stream << "dropped_bytes " << server.droppedBytes << "\n";
+    }
+
+    if (Misc::Instrumentation::enabled())
+        stream << "\n" << Misc::Instrumentation::instance().report();
+
+    stream.flush();
+    return text;
+}
+
+/**
+ * Writes the metrics report to the metrics file (atomically, so that
+ * readers never see a partial report) or to the standard output
+ */
+void Daemon::writeMetrics()
+{
+    if (Misc::Instrumentation::enabled())
+        Misc::Instrumentation::instance().sample();
+
+    const auto report = metrics();
+    if (m_metricsFile.isEmpty())
+    {
+        QTextStream(stdout) << report << endl;
+        return;
+    }
+
+    QSaveFile file(m_metricsFile);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        file.write(report.toUtf8());
+        if (!file.commit())
+            qWarning() << "Cannot write" << m_metricsFile << file.errorString();
+    }
+}
+
+//----------------------------------------------------------------------------------------
+// Poll replies
+//----------------------------------------------------------------------------------------
+
+/**
+ * Appends the reply of the poll item @a id to the value log
+ */
+void Daemon::onItemReply(const int id, const ModbusMaster::Reply &reply)
+{
+    if (!m_log.isOpen())
+        return;
+
+    QByteArray line;
+    line.reserve(64 + reply.values.count() * 6);
+    line.append(QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs).toLatin1());
+    line.append(',').append(m_itemNames.value(id).toUtf8());
+    line.append(',').append(QByteArray::number(reply.slave));
+    line.append(',').append(QByteArray::number(reply.function));
+    line.append(',').append(QByteArray::number(reply.address));
+    line.append(',').append(errorName(reply.error));
+    line.append(',').append(QByteArray::number(reply.roundTripUs));
+    line.append(',');
+
+    for (int i = 0; i < reply.values.count(); ++i)
+    {
+        if (i > 0)
+            line.append(' ');
+
+        line.append(QByteArray::number(reply.values.at(i)));
+    }
+
+    line.append('\n');
+    m_log.write(line);
+}
+
+//----------------------------------------------------------------------------------------
+// Unix signals
+//----------------------------------------------------------------------------------------
+
+/**
+ * Routes @c SIGINT & @c SIGTERM to a clean shutdown and @c SIGUSR1 to an
+ * immediate metrics report
+ */
+bool Daemon::installSignalHandlers()
+{
+#ifdef Q_OS_UNIX
+    if (m_signalNotifier)
+        return true;
+
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, SIGNAL_FD) != 0)
+        return false;
+
+    m_signalNotifier = new QSocketNotifier(SIGNAL_FD[1], QSocketNotifier::Read, this);
+    connect(m_signalNotifier, SIGNAL(activated(int)), this, SLOT(onSignal()));
+
+    struct sigaction action;
+    action.sa_handler = signalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+
+    sigaction(SIGINT, &action, Q_NULLPTR);
+    sigaction(SIGTERM, &action, Q_NULLPTR);
+    sigaction(SIGUSR1, &action, Q_NULLPTR);
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Handles the signals queued by the signal handler
+ */
+void Daemon::onSignal()
+{
+#ifdef Q_OS_UNIX
+    char number = 0;
+    if (::read(SIGNAL_FD[1], &number, sizeof(number)) != sizeof(number))
+        return;
+
+    if (number == SIGUSR1)
+        writeMetrics();
+    else
+        QCoreApplication::quit();
+#endif
+}
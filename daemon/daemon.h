@@ -0,0 +1,107 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include "serial.h"
+#include "modbusmaster.h"
+#include "pollscheduler.h"
+#include "capturewriter.h"
+#include "fanoutserver.h"
+#include "portmanager.h"
+
+class QSocketNotifier;
+
+/**
+ * Headless polling & capture engine, the same serial, Modbus & capture code
+ * as the GUI without any widget.
+ *
+ * The configuration is a JSON file:
+ * @code
+ * {
+ *   "port": "/dev/ttyUSB0",
+ *   "baudRate": 9600, "dataBits": "8", "parity": "None",
+ *   "stopBits": "1", "flowControl": "None",
+ *   "ioThread": true, "autoReconnect": true,
+ *   "responseTimeoutMs": 100,
+ *   "capture": "/var/lib/serialtoold/bus.qcap",
+ *   "log": "/var/lib/serialtoold/values.csv",
+ *   "metrics": { "file": "/run/serialtoold/metrics.txt", "intervalMs": 10000 },
+ *   "server": { "address": "127.0.0.1", "tcpPort": 5020, "frameTcpPort": 5021,
+ *               "localName": "serialtoold", "frameDelimiter": "0d0a",
+ *               "maxQueueBytes": 4194304, "overflow": "drop" },
+ *   "monitors": [
+ *     { "port": "/dev/ttyUSB1", "baudRate": 9600, "frameTimeoutUs": 3500 }
+ *   ],
+ *   "poll": [
+ *     { "name": "ccr1", "slave": 1, "function": 3, "address": 0,
+ *       "count": 4, "periodMs": 100, "priority": 1 }
+ *   ]
+ * }
+ * @endcode
+ *
+ * The optional @c server section republishes the received bytes & frames to
+ * local clients through a @c FanoutServer ("overflow" is "drop" or
+ * "disconnect", frames are split at "frameDelimiter" given in hex, or after
+ * "frameTimeoutUs" of silence).
+ *
+ * The optional @c monitors are additional ports that are only listened to.
+ * They are opened through @c PortManager on its decode pool, so that every
+ * port is read on its own I/O thread & deframed on a pool thread; their
+ * frames go to the frame stream of the server & their traffic to the
+ * capture file (with the channel ID as port ID).
+ *
+ * Every reply is appended to the CSV log (time, item, status, values). The
+ * metrics file is rewritten periodically & on @c SIGUSR1 with the data path
+ * counters, poll/capture statistics and the CPU time & memory of the
+ * process. @c SIGINT & @c SIGTERM stop the daemon cleanly.
+ */
+class Daemon : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Daemon(QObject *parent = nullptr);
+    ~Daemon();
+
+    bool loadConfiguration(const QString &fileName, QString *error);
+    bool start(QString *error);
+    QString metrics() const;
+
+public Q_SLOTS:
+    void stop();
+    void writeMetrics();
+
+private Q_SLOTS:
+    void onItemReply(const int id, const ModbusMaster::Reply &reply);
+    void onMonitorFrame(const int channelId, const QByteArray &frame);
+    void onSignal();
+
+private:
+    bool configureSerial(QString *error);
+    bool startServer(QString *error);
+    bool startMonitors(QString *error);
+    bool installSignalHandlers();
+
+private:
+    QJsonObject m_config;
+    Serial &m_serial;
+    ModbusMaster m_master;
+    PollScheduler m_scheduler;
+    CaptureWriter m_captureWriter;
+    FanoutServer m_server;
+    QList<SerialChannel *> m_monitors;
+
+    QHash<int, QString> m_itemNames;
+    QFile m_log;
+    QString m_metricsFile;
+    QTimer m_metricsTimer;
+    QElapsedTimer m_uptime;
+
+    QSocketNotifier *m_signalNotifier;
+};
+
+#endif // DAEMON_H
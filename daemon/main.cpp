@@ -0,0 +1,43 @@
+#include "daemon.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Keep the serial settings apart from the ones of the GUI
+    QCoreApplication::setOrganizationName("QSerialTool");
+    QCoreApplication::setApplicationName("serialtoold");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless serial polling & capture service");
+    parser.addHelpOption();
+
+    QCommandLineOption configOption(QStringList { "c", "config" },
+                                    "JSON configuration file.", "file",
+                                    "/etc/serialtoold.json");
+    QCommandLineOption metricsOption(QStringList { "m", "print-metrics" },
+                                     "Print the metrics to stdout on exit.");
+    parser.addOption(configOption);
+    parser.addOption(metricsOption);
+    parser.process(app);
+
+    Daemon daemon;
+    QString error;
+    if (!daemon.loadConfiguration(parser.value(configOption), &error)
+        || !daemon.start(&error))
+    {
+        QTextStream(stderr) << error << endl;
+        return 1;
+    }
+
+    const int ret = app.exec();
+    daemon.stop();
+
+    if (parser.isSet(metricsOption))
+        QTextStream(stdout) << daemon.metrics() << endl;
+
+    return ret;
+}
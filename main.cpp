@@ -1,15 +1,24 @@
 #include "src/mainwindow.h"
+#include "StartupTrace.h"
 #include <QApplication>
 #include <QObject>
 int main(int argc, char *argv[])
 {
+    Misc::StartupTrace::start();
     QApplication a(argc, argv);
-    MainWindow w;
-    w.show();
+    Misc::StartupTrace::mark("QApplication");
+
+    //在创建窗口之前应用样式表, 避免显示后再重新计算所有控件的样式
     QFile  qssFile(":/qss/mystyle.qss");
     if(qssFile.open(QIODevice::ReadOnly))
     {
         a.setStyleSheet(qssFile.readAll());
     }
+    Misc::StartupTrace::mark("style sheet");
+
+    MainWindow w;
+    Misc::StartupTrace::mark("MainWindow");
+    w.show();
+    Misc::StartupTrace::mark("show");
     return a.exec();
 }
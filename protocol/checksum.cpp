@@ -0,0 +1,435 @@
+#include "checksum.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define CHECKSUM_SSE2
+#    include <emmintrin.h>
+#endif
+
+// The carry-less multiplication kernel is compiled with a function-level
+// target attribute and only used if the CPU supports it
+#if defined(CHECKSUM_SSE2) && defined(__GNUC__)
+#    define CHECKSUM_PCLMUL
+#    include <immintrin.h>
+#endif
+
+//----------------------------------------------------------------------------------------
+// Slicing-by-8 tables
+//----------------------------------------------------------------------------------------
+
+/**
+ * Lookup tables for a CRC of up to 32 bits. @c table[k][b] is the CRC of the
+ * byte @a b followed by @a k zero bytes, which allows processing 8 input
+ * bytes with 8 independent lookups.
+ */
+struct CrcTables
+{
+    quint32 table[8][256];
+
+    // LSB-first (reflected) CRC with the given reflected polynomial
+    static CrcTables reflected(const quint32 poly)
+    {
+        CrcTables t;
+        for (quint32 i = 0; i < 256; ++i)
+        {
+            quint32 crc = i;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+
+            t.table[0][i] = crc;
+        }
+
+        for (int k = 1; k < 8; ++k)
+            for (int i = 0; i < 256; ++i)
+                t.table[k][i] = (t.table[k - 1][i] >> 8) ^ t.table[0][t.table[k - 1][i] & 0xff];
+
+        return t;
+    }
+
+    // MSB-first 16-bit CRC with the given polynomial
+    static CrcTables normal16(const quint16 poly)
+    {
+        CrcTables t;
+        for (quint32 i = 0; i < 256; ++i)
+        {
+            quint32 crc = i << 8;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc & 0x8000) ? (crc << 1) ^ poly : crc << 1;
+
+            t.table[0][i] = crc & 0xffff;
+        }
+
+        for (int k = 1; k < 8; ++k)
+            for (int i = 0; i < 256; ++i)
+                t.table[k][i] = ((t.table[k - 1][i] << 8) & 0xffff)
+                                ^ t.table[0][t.table[k - 1][i] >> 8];
+
+        return t;
+    }
+};
+
+static const CrcTables CRC16_MODBUS = CrcTables::reflected(0xA001);
+static const CrcTables CRC16_CCITT = CrcTables::normal16(0x1021);
+static const CrcTables CRC32_IEEE = CrcTables::reflected(0xEDB88320);
+
+static inline quint32 readLe32(const uchar *p)
+{
+    return quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16) | (quint32(p[3]) << 24);
+}
+
+/**
+ * Updates a reflected CRC (CRC-16/Modbus, CRC-32) with slicing-by-8
+ */
+static quint32 crcReflected(const CrcTables &t, quint32 crc, const uchar *p, int size)
+{
+    while (size >= 8)
+    {
+        const quint32 one = readLe32(p) ^ crc;
+        const quint32 two = readLe32(p + 4);
+        crc = t.table[7][one & 0xff] ^ t.table[6][(one >> 8) & 0xff]
+              ^ t.table[5][(one >> 16) & 0xff] ^ t.table[4][one >> 24]
+              ^ t.table[3][two & 0xff] ^ t.table[2][(two >> 8) & 0xff]
+              ^ t.table[1][(two >> 16) & 0xff] ^ t.table[0][two >> 24];
+        p += 8;
+        size -= 8;
+    }
+
+    while (size-- > 0)
+        crc = (crc >> 8) ^ t.table[0][(crc ^ *p++) & 0xff];
+
+    return crc;
+}
+
+/**
+ * Updates a MSB-first 16-bit CRC (CRC-16/CCITT) with slicing-by-8
+ */
+static quint32 crcNormal16(const CrcTables &t, quint32 crc, const uchar *p, int size)
+{
+    while (size >= 8)
+    {
+        crc = t.table[7][(p[0] ^ (crc >> 8)) & 0xff] ^ t.table[6][(p[1] ^ crc) & 0xff]
+              ^ t.table[5][p[2]] ^ t.table[4][p[3]] ^ t.table[3][p[4]]
+              ^ t.table[2][p[5]] ^ t.table[1][p[6]] ^ t.table[0][p[7]];
+        p += 8;
+        size -= 8;
+    }
+
+    while (size-- > 0)
+        crc = ((crc << 8) & 0xffff) ^ t.table[0][((crc >> 8) ^ *p++) & 0xff];
+
+    return crc;
+}
+
+//----------------------------------------------------------------------------------------
+// CRC-32 carry-less multiplication kernel
+//----------------------------------------------------------------------------------------
+
+#ifdef CHECKSUM_PCLMUL
+/**
+ * Folds @a size bytes (at least 64, multiple of 16) into the running CRC-32
+ * with PCLMULQDQ, following Intel's "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction" (bit-reflected constants).
+ */
+__attribute__((target("pclmul,sse4.1"))) static quint32 crc32Pclmul(quint32 crc, const uchar *p,
+                                                                     int size)
+{
+    alignas(16) static const quint64 k1k2[] = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+    alignas(16) static const quint64 k3k4[] = { 0x01751997d0ULL, 0x00ccaa009eULL };
+    alignas(16) static const quint64 k5k0[] = { 0x0163cd6124ULL, 0x0000000000ULL };
+    alignas(16) static const quint64 poly[] = { 0x01db710641ULL, 0x01f7011641ULL };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x00));
+    x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x10));
+    x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x20));
+    x4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(int(crc)));
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i *>(k1k2));
+    p += 64;
+    size -= 64;
+
+    // Fold 4 x 128 bits in parallel
+    while (size >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x00));
+        y6 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x10));
+        y7 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x20));
+        y8 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        p += 64;
+        size -= 64;
+    }
+
+    // Fold into 128 bits
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i *>(k3k4));
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Fold the remaining 16-byte blocks
+    while (size >= 16)
+    {
+        x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        p += 16;
+        size -= 16;
+    }
+
+    // Fold 128 bits into 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(k5k0));
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i *>(poly));
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return quint32(_mm_extract_epi32(x1, 1));
+}
+
+static bool detectPclmul()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+
+static const bool HAVE_PCLMUL = detectPclmul();
+#else
+static const bool HAVE_PCLMUL = false;
+#endif
+
+/**
+ * Computes the CRC-32 of @a size bytes, using the folding kernel for the bulk
+ * of the data when available.
+ */
+static quint32 crc32(const uchar *p, int size)
+{
+    quint32 crc = 0xffffffff;
+
+#ifdef CHECKSUM_PCLMUL
+    if (HAVE_PCLMUL && size >= 64)
+    {
+        const int bulk = size & ~15;
+        crc = crc32Pclmul(crc, p, bulk);
+        p += bulk;
+        size -= bulk;
+    }
+#endif
+
+    return crcReflected(CRC32_IEEE, crc, p, size) ^ 0xffffffff;
+}
+
+//----------------------------------------------------------------------------------------
+// Sum/XOR checks
+//----------------------------------------------------------------------------------------
+
+static quint32 sum8(const uchar *p, int size)
+{
+    quint32 sum = 0;
+    int i = 0;
+
+#ifdef CHECKSUM_SSE2
+    // PSADBW adds 8 bytes at a time into two 64-bit lanes
+    __m128i acc = _mm_setzero_si128();
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+    }
+
+    sum = quint32(_mm_cvtsi128_si32(acc)) + quint32(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#endif
+
+    for (; i < size; ++i)
+        sum += p[i];
+
+    return sum & 0xff;
+}
+
+static quint32 xor8(const uchar *p, int size)
+{
+    quint32 value = 0;
+    int i = 0;
+
+#ifdef CHECKSUM_SSE2
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16)
+        acc = _mm_xor_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i)));
+
+    alignas(16) uchar lanes[16];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes), acc);
+    for (int j = 0; j < 16; ++j)
+        value ^= lanes[j];
+#endif
+
+    for (; i < size; ++i)
+        value ^= p[i];
+
+    return value;
+}
+
+//----------------------------------------------------------------------------------------
+// Public interface
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns the names of the supported algorithms in the order of the
+ * @c Algorithm enum. This function can be used with a combo-box to build UIs.
+ */
+QStringList Checksum::algorithmList()
+{
+    return QStringList { "None", "SUM8", "XOR8", "CRC-16/MODBUS", "CRC-16/CCITT", "CRC-32" };
+}
+
+/**
+ * Returns the number of bytes that the checksum occupies in a frame
+ */
+int Checksum::size(const Algorithm algorithm)
+{
+    switch (algorithm)
+    {
+        case Sum8:
+        case Xor8:
+            return 1;
+        case Crc16Modbus:
+        case Crc16Ccitt:
+            return 2;
+        case Crc32:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Returns @c true if the checksum is transmitted most significant byte first.
+ * Modbus & CRC-32 send the low byte first, CRC-16/CCITT the high byte first.
+ */
+bool Checksum::bigEndian(const Algorithm algorithm)
+{
+    return algorithm == Crc16Ccitt;
+}
+
+/**
+ * Returns @c true if a hardware-specific kernel is used for @a algorithm
+ */
+bool Checksum::hardwareAccelerated(const Algorithm algorithm)
+{
+    switch (algorithm)
+    {
+        case Crc32:
+            return HAVE_PCLMUL;
+#ifdef CHECKSUM_SSE2
+        case Sum8:
+        case Xor8:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+/**
+ * Computes the checksum of @a size bytes of @a data
+ */
+quint32 Checksum::compute(const Algorithm algorithm, const char *data, const int size)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    switch (algorithm)
+    {
+        case Sum8:
+            return sum8(p, size);
+        case Xor8:
+            return xor8(p, size);
+        case Crc16Modbus:
+            return crcReflected(CRC16_MODBUS, 0xffff, p, size);
+        case Crc16Ccitt:
+            return crcNormal16(CRC16_CCITT, 0xffff, p, size);
+        case Crc32:
+            return crc32(p, size);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Computes the checksum of @a data
+ */
+quint32 Checksum::compute(const Algorithm algorithm, const QByteArray &data)
+{
+    return compute(algorithm, data.constData(), data.size());
+}
+
+/**
+ * Computes the checksum of @a frame (skipping the first @a offset bytes) and
+ * appends it to the frame in the byte order used on the wire.
+ */
+void Checksum::append(const Algorithm algorithm, QByteArray &frame, const int offset)
+{
+    const int bytes = size(algorithm);
+    if (bytes == 0)
+        return;
+
+    const quint32 value = compute(algorithm, frame.constData() + offset, frame.size() - offset);
+    for (int i = 0; i < bytes; ++i)
+    {
+        const int shift = bigEndian(algorithm) ? 8 * (bytes - 1 - i) : 8 * i;
+        frame.append(char((value >> shift) & 0xff));
+    }
+}
+
+/**
+ * Returns @c true if the checksum at the end of the @a size bytes of @a frame
+ * matches the checksum of the preceding bytes (skipping the first @a offset).
+ */
+bool Checksum::verify(const Algorithm algorithm, const char *frame, const int size,
+                      const int offset)
+{
+    const int bytes = Checksum::size(algorithm);
+    if (bytes == 0)
+        return true;
+
+    const int payload = size - bytes;
+    if (payload < offset)
+        return false;
+
+    quint32 received = 0;
+    const uchar *p = reinterpret_cast<const uchar *>(frame + payload);
+    for (int i = 0; i < bytes; ++i)
+    {
+        const int shift = bigEndian(algorithm) ? 8 * (bytes - 1 - i) : 8 * i;
+        received |= quint32(p[i]) << shift;
+    }
+
+    return compute(algorithm, frame + offset, payload - offset) == received;
+}
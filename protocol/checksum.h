@@ -0,0 +1,41 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <QByteArray>
+#include <QStringList>
+
+/**
+ * Checksum/CRC kernels used to validate received frames & to complete the
+ * frames that are sent to the devices.
+ *
+ * The CRCs use slicing-by-8 lookup tables (8 bytes per iteration). On x86
+ * CPUs with carry-less multiplication (PCLMULQDQ) CRC-32 is computed by
+ * folding 64-byte blocks instead, and the sum/XOR checks use SSE2.
+ */
+class Checksum
+{
+public:
+    enum Algorithm
+    {
+        None = 0,
+        Sum8 = 1,
+        Xor8 = 2,
+        Crc16Modbus = 3,
+        Crc16Ccitt = 4,
+        Crc32 = 5,
+    };
+
+    static QStringList algorithmList();
+    static int size(const Algorithm algorithm);
+    static bool bigEndian(const Algorithm algorithm);
+    static bool hardwareAccelerated(const Algorithm algorithm);
+
+    static quint32 compute(const Algorithm algorithm, const char *data, const int size);
+    static quint32 compute(const Algorithm algorithm, const QByteArray &data);
+
+    static void append(const Algorithm algorithm, QByteArray &frame, const int offset = 0);
+    static bool verify(const Algorithm algorithm, const char *frame, const int size,
+                       const int offset = 0);
+};
+
+#endif // CHECKSUM_H
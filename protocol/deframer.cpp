@@ -0,0 +1,430 @@
+#include "deframer.h"
+#include <cstring>
+
+//----------------------------------------------------------------------------------------
+// Configuration
+//----------------------------------------------------------------------------------------
+
+/**
+ * Default configuration: newline-terminated frames of up to 4 KiB
+ */
+Deframer::Configuration::Configuration()
+    : mode(Delimiter)
+    , delimiter("\n")
+    , lengthOffset(2)
+    , lengthSize(1)
+    , lengthBigEndian(true)
+    , lengthAdjustment(0)
+    , maxFrameSize(4096)
+    , interCharTimeoutUs(0)
+    , checksum(Checksum::None)
+    , checksumOffset(0)
+{
+}
+
+//----------------------------------------------------------------------------------------
+// Constructor & configuration functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function, uses the default configuration
+ */
+Deframer::Deframer()
+{
+    setConfiguration(Configuration());
+}
+
+/**
+ * Constructor function, uses the given @a config
+ */
+Deframer::Deframer(const Configuration &config)
+{
+    setConfiguration(config);
+}
+
+/**
+ * Returns the framing rules used by the deframer
+ */
+const Deframer::Configuration &Deframer::configuration() const
+{
+    return m_config;
+}
+
+/**
+ * Changes the framing rules & discards any partially received frame
+ */
+void Deframer::setConfiguration(const Configuration &config)
+{
+    Q_ASSERT(config.lengthSize >= 1 && config.lengthSize <= 4);
+    Q_ASSERT(config.mode != HeaderLength || !config.header.isEmpty());
+    Q_ASSERT(config.mode != Delimiter || !config.delimiter.isEmpty());
+
+    m_config = config;
+    buildFailureTable(m_config.header, m_headerTable);
+    buildFailureTable(m_config.delimiter, m_delimiterTable);
+
+    m_partial.reserve(size_t(qMax(0, m_config.maxFrameSize)));
+    reset();
+    resetStatistics();
+}
+
+/**
+ * Sets the function that receives every complete frame. The frame data is
+ * only valid during the call.
+ */
+void Deframer::setFrameHandler(const FrameHandler &handler)
+{
+    m_handler = handler;
+}
+
+//----------------------------------------------------------------------------------------
+// Stream processing
+//----------------------------------------------------------------------------------------
+
+/**
+ * Consumes @a size bytes of @a data received at @a timestampUs (monotonic
+ * microseconds, only needed for inter-character timeouts).
+ */
+void Deframer::process(const char *data, const int size, const qint64 timestampUs)
+{
+    if (m_config.mode == Timeout)
+    {
+        processTimeout(data, size, timestampUs);
+        return;
+    }
+
+    if (size <= 0)
+        return;
+
+    // Drop a stale frame if the line was silent for too long
+    checkTimeout(timestampUs);
+
+    int pos = 0;
+    int begin = -1;
+    while (pos < size)
+    {
+        switch (m_state)
+        {
+            case SeekHeader:
+            {
+                // Frames without start header begin with the first byte
+                if (m_config.header.isEmpty())
+                {
+                    startFrame();
+                    begin = pos;
+                    m_state = SeekDelimiter;
+                    break;
+                }
+
+                if (!matchPattern(m_config.header, m_headerTable, m_matched, data, size, pos))
+                    break;
+
+                // The header may have started in a previous call, its bytes are known
+                const int headerSize = m_config.header.size();
+                startFrame();
+                if (pos >= headerSize)
+                    begin = pos - headerSize;
+                else
+                {
+                    begin = -1;
+                    m_partial.assign(m_config.header.constData(),
+                                     m_config.header.constData() + (headerSize - pos));
+                }
+
+                m_frameSize = headerSize;
+                m_state = (m_config.mode == HeaderLength) ? ReadLength : SeekDelimiter;
+                break;
+            }
+            case ReadLength:
+            {
+                const int fieldEnd = m_config.lengthOffset + m_config.lengthSize;
+                while (pos < size && m_frameSize < fieldEnd)
+                {
+                    if (m_frameSize >= m_config.lengthOffset)
+                    {
+                        const quint32 byte = quint8(data[pos]);
+                        const int i = m_frameSize - m_config.lengthOffset;
+                        if (m_config.lengthBigEndian)
+                            m_lengthValue = (m_lengthValue << 8) | byte;
+                        else
+                            m_lengthValue |= byte << (8 * i);
+                    }
+
+                    ++pos;
+                    ++m_frameSize;
+                }
+
+                if (m_frameSize < fieldEnd)
+                    break;
+
+                // Validate the length field, resynchronize on garbage
+                const qint64 expected = qint64(m_lengthValue) + m_config.lengthAdjustment;
+                if (expected < fieldEnd || expected > m_config.maxFrameSize)
+                {
+                    abortFrame(m_frameSize);
+                    begin = -1;
+                    break;
+                }
+
+                m_expectedSize = int(expected);
+                m_state = ReadBody;
+                if (m_frameSize == m_expectedSize)
+                {
+                    completeFrame(data, begin, pos);
+                    begin = -1;
+                }
+                break;
+            }
+            case ReadBody:
+            {
+                // Skip over the body in a single step
+                const int bytes = qMin(m_expectedSize - m_frameSize, size - pos);
+                pos += bytes;
+                m_frameSize += bytes;
+                if (m_frameSize == m_expectedSize)
+                {
+                    completeFrame(data, begin, pos);
+                    begin = -1;
+                }
+                break;
+            }
+            case SeekDelimiter:
+            {
+                const int start = pos;
+                const bool found = matchPattern(m_config.delimiter, m_delimiterTable, m_matched,
+                                                data, size, pos);
+                m_frameSize += pos - start;
+                if (found)
+                {
+                    completeFrame(data, begin, pos);
+                    begin = -1;
+                }
+                else if (m_frameSize > m_config.maxFrameSize)
+                {
+                    abortFrame(m_frameSize);
+                    begin = -1;
+                }
+                break;
+            }
+        }
+    }
+
+    // Keep the bytes of an unfinished frame for the next call
+    if (m_state != SeekHeader)
+    {
+        const int from = (begin >= 0) ? begin : 0;
+        m_partial.insert(m_partial.end(), data + from, data + size);
+    }
+
+    m_lastByteTime = timestampUs;
+}
+
+/**
+ * Must be called periodically (e.g. from a timer) with the current monotonic
+ * time. In @c Timeout mode it completes the pending frame once the line has
+ * been silent long enough, in the other modes it discards a frame whose
+ * remaining bytes never arrived.
+ */
+void Deframer::checkTimeout(const qint64 nowUs)
+{
+    if (m_config.interCharTimeoutUs <= 0 || nowUs - m_lastByteTime <= m_config.interCharTimeoutUs)
+        return;
+
+    if (m_config.mode == Timeout)
+    {
+        if (!m_partial.empty())
+            completeFrame(Q_NULLPTR, -1, 0);
+    }
+    else if (m_state != SeekHeader)
+    {
+        abortFrame(int(m_partial.size()));
+    }
+}
+
+/**
+ * Discards any partially received frame
+ */
+void Deframer::reset()
+{
+    m_state = SeekHeader;
+    m_matched = 0;
+    m_frameSize = 0;
+    m_expectedSize = 0;
+    m_lengthValue = 0;
+    m_lastByteTime = 0;
+    m_partial.clear();
+}
+
+/**
+ * Returns the number of frames, discarded bytes & framing errors
+ */
+const Deframer::Statistics &Deframer::statistics() const
+{
+    return m_statistics;
+}
+
+/**
+ * Clears the frame, discarded bytes & framing error counters
+ */
+void Deframer::resetStatistics()
+{
+    m_statistics.frames = 0;
+    m_statistics.discardedBytes = 0;
+    m_statistics.errors = 0;
+    m_statistics.checksumErrors = 0;
+}
+
+//----------------------------------------------------------------------------------------
+// Internal functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Builds the KMP failure table of @a pattern, which allows resuming a partial
+ * match without going back in the input.
+ */
+void Deframer::buildFailureTable(const QByteArray &pattern, std::vector<int> &table)
+{
+    table.assign(size_t(pattern.size()), 0);
+    int k = 0;
+    for (int i = 1; i < pattern.size(); ++i)
+    {
+        while (k > 0 && pattern.at(i) != pattern.at(k))
+            k = table[size_t(k - 1)];
+
+        if (pattern.at(i) == pattern.at(k))
+            ++k;
+
+        table[size_t(i)] = k;
+    }
+}
+
+/**
+ * Advances @a pos until @a pattern has been completely matched (returns
+ * @c true, @a pos points past the match) or the data is exhausted. The number
+ * of matched bytes is kept in @a matched across calls. Bytes that cannot be
+ * part of a header are accounted as discarded.
+ */
+bool Deframer::matchPattern(const QByteArray &pattern, const std::vector<int> &table,
+                            int &matched, const char *data, const int size, int &pos)
+{
+    const bool seekingHeader = (&pattern == &m_config.header);
+    const char *p = pattern.constData();
+    const int length = pattern.size();
+
+    while (pos < size)
+    {
+        // Fast skip to the next candidate
+        if (matched == 0)
+        {
+            const void *hit = std::memchr(data + pos, p[0], size_t(size - pos));
+            const int next = hit ? int(static_cast<const char *>(hit) - data) : size;
+            if (seekingHeader)
+                m_statistics.discardedBytes += quint64(next - pos);
+
+            pos = next;
+            if (pos == size)
+                return false;
+        }
+
+        const char c = data[pos++];
+        while (matched > 0 && c != p[matched])
+        {
+            const int fallback = table[size_t(matched - 1)];
+            if (seekingHeader)
+                m_statistics.discardedBytes += quint64(matched - fallback);
+
+            matched = fallback;
+        }
+
+        if (c == p[matched])
+            ++matched;
+        else if (seekingHeader)
+            ++m_statistics.discardedBytes;
+
+        if (matched == length)
+        {
+            matched = 0;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Collects the whole input in @c Timeout mode, frames are delimited by the
+ * silence between two calls.
+ */
+void Deframer::processTimeout(const char *data, const int size, const qint64 timestampUs)
+{
+    checkTimeout(timestampUs);
+    if (size <= 0)
+        return;
+
+    if (int(m_partial.size()) + size > m_config.maxFrameSize)
+    {
+        abortFrame(int(m_partial.size()) + size);
+        return;
+    }
+
+    m_partial.insert(m_partial.end(), data, data + size);
+    m_lastByteTime = timestampUs;
+}
+
+/**
+ * Prepares the parser state for a new frame
+ */
+void Deframer::startFrame()
+{
+    m_partial.clear();
+    m_matched = 0;
+    m_frameSize = 0;
+    m_expectedSize = 0;
+    m_lengthValue = 0;
+}
+
+/**
+ * Validates & reports the frame that ends at @a end. If the frame started in
+ * the current input (@a begin >= 0) it is reported in place, otherwise the
+ * remaining bytes are appended to the assembly buffer.
+ */
+void Deframer::completeFrame(const char *data, const int begin, const int end)
+{
+    const char *frame = data + begin;
+    int size = end - begin;
+    if (begin < 0)
+    {
+        if (end > 0)
+            m_partial.insert(m_partial.end(), data, data + end);
+
+        frame = m_partial.data();
+        size = int(m_partial.size());
+    }
+
+    if (Checksum::verify(m_config.checksum, frame, size, m_config.checksumOffset))
+    {
+        ++m_statistics.frames;
+        if (m_handler)
+            m_handler(frame, size);
+    }
+    else
+    {
+        ++m_statistics.checksumErrors;
+        m_statistics.discardedBytes += quint64(size);
+    }
+
+    m_state = SeekHeader;
+    startFrame();
+}
+
+/**
+ * Drops the current frame (@a bytes long) after a framing error
+ */
+void Deframer::abortFrame(const int bytes)
+{
+    ++m_statistics.errors;
+    m_statistics.discardedBytes += quint64(qMax(0, bytes));
+
+    m_state = SeekHeader;
+    startFrame();
+}
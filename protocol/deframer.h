@@ -0,0 +1,112 @@
+#ifndef DEFRAMER_H
+#define DEFRAMER_H
+
+#include <QByteArray>
+#include <functional>
+#include <vector>
+#include "checksum.h"
+
+/**
+ * Resumable frame reassembler for the byte stream delivered by @c Serial.
+ *
+ * Bytes are consumed incrementally as they arrive, the parser state (partial
+ * header/delimiter match, length field, remaining body bytes) is carried over
+ * between calls so no byte is ever scanned twice. A frame that lies entirely
+ * inside the data passed to @c process() is reported as a view into that data;
+ * only frames that cross a chunk boundary are assembled in an internal buffer.
+ *
+ * Supported framing rules:
+ * - @c HeaderLength: sync header followed by a length field
+ * - @c Delimiter: frames terminated by a delimiter (optional start header)
+ * - @c Timeout: frames separated by an inter-character silence
+ *
+ * If a checksum algorithm is configured, frames whose trailing checksum does
+ * not match are dropped instead of being reported.
+ */
+class Deframer
+{
+public:
+    enum Mode
+    {
+        HeaderLength,
+        Delimiter,
+        Timeout,
+    };
+
+    struct Configuration
+    {
+        Configuration();
+
+        Mode mode;
+        QByteArray header;
+        QByteArray delimiter;
+        int lengthOffset;
+        int lengthSize;
+        bool lengthBigEndian;
+        int lengthAdjustment;
+        int maxFrameSize;
+        qint64 interCharTimeoutUs;
+        Checksum::Algorithm checksum;
+        int checksumOffset;
+    };
+
+    struct Statistics
+    {
+        quint64 frames;
+        quint64 discardedBytes;
+        quint64 errors;
+        quint64 checksumErrors;
+    };
+
+    typedef std::function<void(const char *data, int size)> FrameHandler;
+
+    Deframer();
+    explicit Deframer(const Configuration &config);
+
+    const Configuration &configuration() const;
+    void setConfiguration(const Configuration &config);
+    void setFrameHandler(const FrameHandler &handler);
+
+    void process(const char *data, const int size, const qint64 timestampUs = 0);
+    void checkTimeout(const qint64 nowUs);
+    void reset();
+
+    const Statistics &statistics() const;
+    void resetStatistics();
+
+private:
+    enum State
+    {
+        SeekHeader,
+        ReadLength,
+        ReadBody,
+        SeekDelimiter,
+    };
+
+    void buildFailureTable(const QByteArray &pattern, std::vector<int> &table);
+    bool matchPattern(const QByteArray &pattern, const std::vector<int> &table, int &matched,
+                      const char *data, const int size, int &pos);
+
+    void processTimeout(const char *data, const int size, const qint64 timestampUs);
+    void startFrame();
+    void completeFrame(const char *data, const int begin, const int end);
+    void abortFrame(const int bytes);
+
+private:
+    Configuration m_config;
+    FrameHandler m_handler;
+    Statistics m_statistics;
+
+    State m_state;
+    int m_matched;
+    int m_frameSize;
+    int m_expectedSize;
+    quint32 m_lengthValue;
+    qint64 m_lastByteTime;
+
+    std::vector<int> m_headerTable;
+    std::vector<int> m_delimiterTable;
+    std::vector<char> m_partial;
+};
+
+#endif // DEFRAMER_H
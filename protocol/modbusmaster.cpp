@@ -0,0 +1,597 @@
+#include "modbusmaster.h"
+#include "checksum.h"
+#include <QPointer>
+
+/**
+ * Default time to wait for the first byte of a response, in milliseconds
+ */
+static const int DEFAULT_RESPONSE_TIMEOUT = 100;
+
+/**
+ * Above 19200 baud the Modbus over serial line specification fixes the
+ * inter-frame delay (t3.5) to 1.75 ms instead of 3.5 character times.
+ */
+static const qint32 FIXED_DELAY_BAUD_RATE = 19200;
+static const qint64 FIXED_INTER_FRAME_DELAY_US = 1750;
+
+/**
+ * Size of an exception response: slave, function | 0x80, exception code, CRC
+ */
+static const int EXCEPTION_RESPONSE_SIZE = 5;
+
+/**
+ * Maximum number of registers per read (FC 3/4) & write (FC 16) request
+ */
+static const int MAX_READ_REGISTERS = 125;
+static const int MAX_WRITE_REGISTERS = 123;
+
+static inline void appendWord(QByteArray &frame, const quint16 value)
+{
+    frame.append(char(value >> 8));
+    frame.append(char(value & 0xFF));
+}
+
+static inline quint16 readWord(const char *data)
+{
+    return quint16((quint8(data[0]) << 8) | quint8(data[1]));
+}
+
+//----------------------------------------------------------------------------------------
+// Constructor function
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function, requests are sent & responses are read through
+ * @a serial.
+ */
+ModbusMaster::ModbusMaster(Serial *serial, QObject *parent)
+    : QObject(parent)
+    , m_serial(serial)
+    , m_state(Idle)
+    , m_nextId(1)
+    , m_responseTimeout(DEFAULT_RESPONSE_TIMEOUT)
+    , m_expectedSize(0)
+    , m_writeFailed(false)
+    , m_lastActivityUs(0)
+    , m_sentUs(0)
+{
+    resetStatistics();
+    m_response.reserve(256);
+    m_clock.start();
+
+    m_gapTimer.setSingleShot(true);
+    m_gapTimer.setTimerType(Qt::PreciseTimer);
+    m_timeoutTimer.setSingleShot(true);
+    m_timeoutTimer.setTimerType(Qt::PreciseTimer);
+
+    connect(&m_gapTimer, &QTimer::timeout, this, &ModbusMaster::sendNext);
+    connect(&m_timeoutTimer, &QTimer::timeout, this, &ModbusMaster::onResponseTimeout);
+    connect(m_serial, &Serial::dataAvailable, this, &ModbusMaster::onDataAvailable,
+            Qt::DirectConnection);
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns the time to wait for a response after the request has been
+ * transmitted, in milliseconds
+ */
+int ModbusMaster::responseTimeout() const
+{
+    return m_responseTimeout;
+}
+
+/**
+ * Returns the number of queued requests, excluding the one in flight
+ */
+int ModbusMaster::pendingRequests() const
+{
+    return m_queue.count();
+}
+
+/**
+ * Returns @c true if a request is in flight or waiting for the bus to be idle
+ */
+bool ModbusMaster::isBusy() const
+{
+    return m_state != Idle;
+}
+
+/**
+ * Returns the request/response counters
+ */
+const ModbusMaster::Statistics &ModbusMaster::statistics() const
+{
+    return m_statistics;
+}
+
+/**
+ * Clears the request/response counters
+ */
+void ModbusMaster::resetStatistics()
+{
+    m_statistics.requests = 0;
+    m_statistics.completed = 0;
+    m_statistics.timeouts = 0;
+    m_statistics.crcErrors = 0;
+    m_statistics.exceptions = 0;
+    m_statistics.unexpectedBytes = 0;
+}
+
+/**
+ * Returns the time needed to transmit a single character with the current
+ * serial configuration (start bit, data bits, parity bit & stop bits), in
+ * microseconds.
+ */
+qint64 ModbusMaster::characterTimeUs() const
+{
+    const qint32 baudRate = qMax(m_serial->baudRate(), 1);
+
+    // Count bits in half-bit units so that 1.5 stop bits stay exact
+    int halfBits = 2 * (1 + int(m_serial->dataBits()));
+    if (m_serial->parity() != QSerialPort::NoParity)
+        halfBits += 2;
+
+    switch (m_serial->stopBits())
+    {
+        case QSerialPort::OneAndHalfStop:
+            halfBits += 3;
+            break;
+        case QSerialPort::TwoStop:
+            halfBits += 4;
+            break;
+        default:
+            halfBits += 2;
+            break;
+    }
+
+    return (qint64(halfBits) * 1000000 + 2 * baudRate - 1) / (2 * qint64(baudRate));
+}
+
+/**
+ * Returns the minimum bus silence between two frames (t3.5), in microseconds
+ */
+qint64 ModbusMaster::interFrameDelayUs() const
+{
+    if (m_serial->baudRate() > FIXED_DELAY_BAUD_RATE)
+        return FIXED_INTER_FRAME_DELAY_US;
+
+    return (characterTimeUs() * 7 + 1) / 2;
+}
+
+//----------------------------------------------------------------------------------------
+// Request functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Queues a read holding registers (FC 3) request, returns the request ID
+ */
+quint64 ModbusMaster::readHoldingRegisters(const quint8 slave, const quint16 address,
+                                           const quint16 count)
+{
+    Request request;
+    request.slave = slave;
+    request.function = ReadHoldingRegisters;
+    request.address = address;
+    request.count = count;
+    return enqueue(request);
+}
+
+/**
+ * Queues a read input registers (FC 4) request, returns the request ID
+ */
+quint64 ModbusMaster::readInputRegisters(const quint8 slave, const quint16 address,
+                                         const quint16 count)
+{
+    Request request;
+    request.slave = slave;
+    request.function = ReadInputRegisters;
+    request.address = address;
+    request.count = count;
+    return enqueue(request);
+}
+
+/**
+ * Queues a write single register (FC 6) request, returns the request ID
+ */
+quint64 ModbusMaster::writeSingleRegister(const quint8 slave, const quint16 address,
+                                          const quint16 value)
+{
+    Request request;
+    request.slave = slave;
+    request.function = WriteSingleRegister;
+    request.address = address;
+    request.count = 1;
+    request.values.append(value);
+    return enqueue(request);
+}
+
+/**
+ * Queues a write multiple registers (FC 16) request, returns the request ID
+ */
+quint64 ModbusMaster::writeMultipleRegisters(const quint8 slave, const quint16 address,
+                                             const QVector<quint16> &values)
+{
+    Request request;
+    request.slave = slave;
+    request.function = WriteMultipleRegisters;
+    request.address = address;
+    request.count = quint16(values.count());
+    request.values = values;
+    return enqueue(request);
+}
+
+/**
+ * Queues the given @a request & starts transmitting if the bus is idle.
+ * Returns the ID assigned to the request, or 0 if the request is invalid.
+ */
+quint64 ModbusMaster::enqueue(const ModbusMaster::Request &request)
+{
+    switch (request.function)
+    {
+        case ReadHoldingRegisters:
+        case ReadInputRegisters:
+            if (request.count == 0 || request.count > MAX_READ_REGISTERS)
+                return 0;
+            break;
+        case WriteSingleRegister:
+            if (request.values.count() != 1)
+                return 0;
+            break;
+        case WriteMultipleRegisters:
+            if (request.values.isEmpty() || request.values.count() > MAX_WRITE_REGISTERS
+                || request.values.count() != request.count)
+                return 0;
+            break;
+        default:
+            return 0;
+    }
+
+    Request copy = request;
+    copy.id = m_nextId++;
+    m_queue.enqueue(copy);
+
+    if (m_state == Idle)
+        scheduleNext();
+
+    return copy.id;
+}
+
+/**
+ * Drops all the queued requests, the request in flight (if any) still
+ * completes.
+ */
+void ModbusMaster::clear()
+{
+    m_queue.clear();
+}
+
+/**
+ * Changes the time to wait for a response after transmitting a request
+ */
+void ModbusMaster::setResponseTimeout(const int ms)
+{
+    m_responseTimeout = qMax(ms, 1);
+}
+
+//----------------------------------------------------------------------------------------
+// Frame encoding/decoding
+//----------------------------------------------------------------------------------------
+
+/**
+ * Builds the RTU frame (including the CRC) for the given @a request
+ */
+QByteArray ModbusMaster::encodeRequest(const ModbusMaster::Request &request)
+{
+    QByteArray frame;
+    frame.reserve(9 + 2 * request.values.count());
+    frame.append(char(request.slave));
+    frame.append(char(request.function));
+    appendWord(frame, request.address);
+
+    switch (request.function)
+    {
+        case WriteSingleRegister:
+            appendWord(frame, request.values.value(0));
+            break;
+        case WriteMultipleRegisters:
+            appendWord(frame, quint16(request.values.count()));
+            frame.append(char(2 * request.values.count()));
+            for (int i = 0; i < request.values.count(); ++i)
+                appendWord(frame, request.values.at(i));
+            break;
+        default:
+            appendWord(frame, request.count);
+            break;
+    }
+
+    Checksum::append(Checksum::Crc16Modbus, frame);
+    return frame;
+}
+
+/**
+ * Returns the size of a normal (non-exception) response to @a request, or 0
+ * for broadcast requests, which are never answered.
+ */
+int ModbusMaster::expectedResponseSize(const ModbusMaster::Request &request)
+{
+    if (request.slave == 0)
+        return 0;
+
+    switch (request.function)
+    {
+        case ReadHoldingRegisters:
+        case ReadInputRegisters:
+            return 5 + 2 * request.count;
+        default:
+            return 8;
+    }
+}
+
+/**
+ * Validates the response @a frame received for @a request & extracts the
+ * register values (for read requests).
+ */
+ModbusMaster::Reply ModbusMaster::decodeResponse(const ModbusMaster::Request &request,
+                                                 const char *frame, const int size)
+{
+    Reply reply;
+    reply.id = request.id;
+    reply.slave = request.slave;
+    reply.function = request.function;
+    reply.address = request.address;
+    reply.error = NoError;
+    reply.exceptionCode = 0;
+    reply.roundTripUs = 0;
+
+    if (size < EXCEPTION_RESPONSE_SIZE || quint8(frame[0]) != request.slave)
+    {
+        reply.error = InvalidResponseError;
+        return reply;
+    }
+
+    if (!Checksum::verify(Checksum::Crc16Modbus, frame, size))
+    {
+        reply.error = CrcError;
+        return reply;
+    }
+
+    const quint8 function = quint8(frame[1]);
+    if (function == (request.function | 0x80))
+    {
+        reply.error = ExceptionError;
+        reply.exceptionCode = quint8(frame[2]);
+        return reply;
+    }
+
+    if (function != request.function || size != expectedResponseSize(request))
+    {
+        reply.error = InvalidResponseError;
+        return reply;
+    }
+
+    switch (request.function)
+    {
+        case ReadHoldingRegisters:
+        case ReadInputRegisters:
+            if (quint8(frame[2]) != 2 * request.count)
+            {
+                reply.error = InvalidResponseError;
+                return reply;
+            }
+
+            reply.values.resize(request.count);
+            for (int i = 0; i < request.count; ++i)
+                reply.values[i] = readWord(frame + 3 + 2 * i);
+            break;
+        case WriteSingleRegister:
+            if (readWord(frame + 2) != request.address
+                || readWord(frame + 4) != request.values.value(0))
+                reply.error = InvalidResponseError;
+            break;
+        case WriteMultipleRegisters:
+            if (readWord(frame + 2) != request.address
+                || readWord(frame + 4) != request.count)
+                reply.error = InvalidResponseError;
+            break;
+    }
+
+    return reply;
+}
+
+//----------------------------------------------------------------------------------------
+// Bus state machine
+//----------------------------------------------------------------------------------------
+
+/**
+ * Sends the next queued request as soon as the bus has been silent for t3.5.
+ *
+ * The response is usually detected well after its last byte arrived (driver
+ * latency, USB polling interval...), so in most cases the gap has already
+ * elapsed & the next request leaves immediately.
+ */
+void ModbusMaster::scheduleNext()
+{
+    if (m_queue.isEmpty())
+    {
+        m_state = Idle;
+        Q_EMIT idle();
+        return;
+    }
+
+    m_state = WaitingGap;
+    const qint64 elapsed = m_clock.nsecsElapsed() / 1000 - m_lastActivityUs;
+    const qint64 remaining = interFrameDelayUs() - elapsed;
+    if (remaining <= 0)
+        sendNext();
+    else
+        m_gapTimer.start(int((remaining + 999) / 1000));
+}
+
+/**
+ * Transmits the request at the front of the queue
+ */
+void ModbusMaster::sendNext()
+{
+    if (m_queue.isEmpty())
+    {
+        scheduleNext();
+        return;
+    }
+
+    m_current = m_queue.dequeue();
+    m_writeFailed = false;
+    m_response.resize(0);
+    m_expectedSize = expectedResponseSize(m_current);
+    ++m_statistics.requests;
+
+    // The frame may wait in the write queue, the timing starts once it was
+    // written to the driver
+    m_state = Sending;
+    const QByteArray frame = encodeRequest(m_current);
+    const quint64 id = m_current.id;
+    const int size = frame.size();
+    QPointer<ModbusMaster> self(this);
+    m_serial->send(frame, WriteQueue::Normal, 0, [=](const WriteQueue::Status status) {
+        if (self)
+            self->onWriteCompleted(id, size, status);
+    });
+}
+
+/**
+ * Starts waiting for the response to the request @a id (of @a size bytes)
+ * once it was written to the driver, or fails it if it could not be written
+ */
+void ModbusMaster::onWriteCompleted(const quint64 id, const int size,
+                                    const WriteQueue::Status status)
+{
+    if (m_state != Sending || m_current.id != id)
+        return;
+
+    m_state = WaitingResponse;
+    if (status != WriteQueue::Written)
+    {
+        // Report the failure from the event loop, so that enqueue() never
+        // completes a request before returning its ID
+        m_writeFailed = true;
+        m_timeoutTimer.start(0);
+        return;
+    }
+
+    // The bus is busy until the request has been fully shifted out
+    const qint64 txTimeUs = characterTimeUs() * size;
+    m_sentUs = m_clock.nsecsElapsed() / 1000;
+    m_lastActivityUs = m_sentUs + txTimeUs;
+
+    // Broadcast requests are never answered, wait for the transmission only
+    if (m_expectedSize == 0)
+        m_timeoutTimer.start(int((txTimeUs + 999) / 1000));
+    else
+        m_timeoutTimer.start(int((txTimeUs + 999) / 1000) + m_responseTimeout);
+}
+
+/**
+ * Fails the request in flight (broadcast requests complete successfully)
+ */
+void ModbusMaster::onResponseTimeout()
+{
+    if (m_state != WaitingResponse)
+        return;
+
+    if (m_writeFailed)
+    {
+        complete(makeReply(m_current, WriteError));
+        return;
+    }
+
+    if (m_expectedSize == 0)
+    {
+        complete(makeReply(m_current, NoError));
+        return;
+    }
+
+    ++m_statistics.timeouts;
+    complete(makeReply(m_current, m_response.isEmpty() ? TimeoutError
+                                                       : InvalidResponseError));
+}
+
+/**
+ * Collects the response bytes straight from the receive buffer. The response
+ * is complete as soon as the number of bytes implied by the request (or by an
+ * exception response) has been received.
+ */
+void ModbusMaster::onDataAvailable(const RingBuffer::Span &first,
+                                   const RingBuffer::Span &second)
+{
+    m_lastActivityUs = m_clock.nsecsElapsed() / 1000;
+
+    if (m_state != WaitingResponse || m_expectedSize == 0 || m_writeFailed)
+    {
+        m_statistics.unexpectedBytes += first.size + second.size;
+
+        // Late bytes (e.g. the response of a slave that timed out) are
+        // dropped & the next request waits for t3.5 of silence after them,
+        // so that they are never parsed as part of its response
+        if (m_state == WaitingGap)
+            scheduleNext();
+
+        return;
+    }
+
+    m_response.append(first.data, int(first.size));
+    m_response.append(second.data, int(second.size));
+
+    int expected = m_expectedSize;
+    if (m_response.size() >= 2 && (quint8(m_response.at(1)) & 0x80))
+        expected = EXCEPTION_RESPONSE_SIZE;
+
+    if (m_response.size() < expected)
+        return;
+
+    if (m_response.size() > expected)
+    {
+        m_statistics.unexpectedBytes += m_response.size() - expected;
+        m_response.resize(expected);
+    }
+
+    m_timeoutTimer.stop();
+    Reply reply = decodeResponse(m_current, m_response.constData(), m_response.size());
+    reply.roundTripUs = m_lastActivityUs - m_sentUs;
+    if (reply.error == CrcError)
+        ++m_statistics.crcErrors;
+    else if (reply.error == ExceptionError)
+        ++m_statistics.exceptions;
+
+    complete(reply);
+}
+
+/**
+ * Reports the result of the request in flight & moves on to the next one
+ */
+void ModbusMaster::complete(const ModbusMaster::Reply &reply)
+{
+    m_timeoutTimer.stop();
+    ++m_statistics.completed;
+
+    Q_EMIT finished(reply);
+    scheduleNext();
+}
+
+/**
+ * Returns an empty reply to @a request with the given @a error
+ */
+ModbusMaster::Reply ModbusMaster::makeReply(const ModbusMaster::Request &request,
+                                            const ModbusMaster::Error error) const
+{
+    Reply reply;
+    reply.id = request.id;
+    reply.slave = request.slave;
+    reply.function = request.function;
+    reply.address = request.address;
+    reply.error = error;
+    reply.exceptionCode = 0;
+    reply.roundTripUs = m_clock.nsecsElapsed() / 1000 - m_sentUs;
+    return reply;
+}
@@ -0,0 +1,154 @@
+#ifndef MODBUSMASTER_H
+#define MODBUSMASTER_H
+
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+#include <QVector>
+#include <QElapsedTimer>
+#include "serial.h"
+
+/**
+ * Modbus RTU master for RS-485 buses driven through @c Serial.
+ *
+ * Requests are queued & sent one at a time. The next request leaves as soon
+ * as the current one is answered (the expected response length is known from
+ * the request, so there is no need to wait for the end-of-frame silence) or
+ * times out, respecting only the 3.5 character inter-frame gap computed from
+ * the current serial configuration. Bytes received outside of a response
+ * are discarded & delay the next request until the bus was silent for t3.5.
+ *
+ * Requests go through the write queue of @c Serial: the transmission time &
+ * the response timeout are measured from the moment the request was written
+ * to the driver, not from the moment it was queued.
+ *
+ * Supported function codes: 3 (read holding registers), 4 (read input
+ * registers), 6 (write single register) & 16 (write multiple registers).
+ */
+class ModbusMaster : public QObject
+{
+    Q_OBJECT
+public:
+    enum FunctionCode
+    {
+        ReadHoldingRegisters = 0x03,
+        ReadInputRegisters = 0x04,
+        WriteSingleRegister = 0x06,
+        WriteMultipleRegisters = 0x10,
+    };
+
+    enum Error
+    {
+        NoError,
+        TimeoutError,
+        CrcError,
+        ExceptionError,
+        InvalidResponseError,
+        WriteError,
+    };
+
+    struct Request
+    {
+        quint64 id;
+        quint8 slave;
+        quint8 function;
+        quint16 address;
+        quint16 count;
+        QVector<quint16> values;
+    };
+
+    struct Reply
+    {
+        quint64 id;
+        quint8 slave;
+        quint8 function;
+        quint16 address;
+        Error error;
+        quint8 exceptionCode;
+        QVector<quint16> values;
+        qint64 roundTripUs;
+    };
+
+    struct Statistics
+    {
+        quint64 requests;
+        quint64 completed;
+        quint64 timeouts;
+        quint64 crcErrors;
+        quint64 exceptions;
+        quint64 unexpectedBytes;
+    };
+
+    explicit ModbusMaster(Serial *serial, QObject *parent = nullptr);
+
+    int responseTimeout() const;
+    int pendingRequests() const;
+    bool isBusy() const;
+    const Statistics &statistics() const;
+    void resetStatistics();
+
+    qint64 characterTimeUs() const;
+    qint64 interFrameDelayUs() const;
+
+    quint64 readHoldingRegisters(const quint8 slave, const quint16 address, const quint16 count);
+    quint64 readInputRegisters(const quint8 slave, const quint16 address, const quint16 count);
+    quint64 writeSingleRegister(const quint8 slave, const quint16 address, const quint16 value);
+    quint64 writeMultipleRegisters(const quint8 slave, const quint16 address,
+                                   const QVector<quint16> &values);
+    quint64 enqueue(const Request &request);
+
+    static QByteArray encodeRequest(const Request &request);
+    static int expectedResponseSize(const Request &request);
+    static Reply decodeResponse(const Request &request, const char *frame, const int size);
+
+Q_SIGNALS:
+    void finished(const ModbusMaster::Reply &reply);
+    void idle();
+
+public Q_SLOTS:
+    void setResponseTimeout(const int ms);
+    void clear();
+
+private Q_SLOTS:
+    void sendNext();
+    void onResponseTimeout();
+    void onDataAvailable(const RingBuffer::Span &first, const RingBuffer::Span &second);
+
+private:
+    void scheduleNext();
+    void onWriteCompleted(const quint64 id, const int size, const WriteQueue::Status status);
+    void complete(const Reply &reply);
+    Reply makeReply(const Request &request, const Error error) const;
+
+private:
+    enum State
+    {
+        Idle,
+        WaitingGap,
+        Sending,
+        WaitingResponse,
+    };
+
+    Serial *m_serial;
+    State m_state;
+    quint64 m_nextId;
+    int m_responseTimeout;
+
+    Request m_current;
+    QByteArray m_response;
+    int m_expectedSize;
+    bool m_writeFailed;
+    QQueue<Request> m_queue;
+
+    QTimer m_gapTimer;
+    QTimer m_timeoutTimer;
+    QElapsedTimer m_clock;
+    qint64 m_lastActivityUs;
+    qint64 m_sentUs;
+
+    Statistics m_statistics;
+};
+
+Q_DECLARE_METATYPE(ModbusMaster::Reply)
+
+#endif // MODBUSMASTER_H
@@ -0,0 +1,429 @@
+#include "pollscheduler.h"
+
+/**
+ * Registers that may be read in excess to merge two nearby register ranges
+ * into a single request. None by default: slaves may answer exception 02
+ * (illegal data address) for the unmapped registers of the gap, which would
+ * fail every merged item on every cycle.
+ */
+static const int DEFAULT_MERGE_GAP = 0;
+
+/**
+ * Maximum number of registers returned by a single read request
+ */
+static const int MAX_READ_REGISTERS = 125;
+
+/**
+ * The bus is considered overloaded when the estimated load exceeds
+ * @c OVERLOAD_ON and back to normal once it drops below @c OVERLOAD_OFF.
+ */
+static const double OVERLOAD_ON = 1.0;
+static const double OVERLOAD_OFF = 0.85;
+
+/**
+ * Weight of the latest sample in the moving averages (1/8)
+ */
+static const int EMA_SHIFT = 3;
+
+static inline qint64 ema(const qint64 average, const qint64 sample)
+{
+    return average + ((sample - average) >> EMA_SHIFT);
+}
+
+static inline bool isRead(const quint8 function)
+{
+    return function == ModbusMaster::ReadHoldingRegisters
+           || function == ModbusMaster::ReadInputRegisters;
+}
+
+//----------------------------------------------------------------------------------------
+// Constructor function
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function, the polls are sent through @a master
+ */
+PollScheduler::PollScheduler(ModbusMaster *master, QObject *parent)
+    : QObject(parent)
+    , m_master(master)
+    , m_running(false)
+    , m_overloaded(false)
+    , m_busLoad(0)
+    , m_nextId(1)
+    , m_mergeGap(DEFAULT_MERGE_GAP)
+    , m_inFlight(0)
+    , m_inFlightSentUs(0)
+{
+    m_clock.start();
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+
+    connect(&m_timer, &QTimer::timeout, this, &PollScheduler::dispatch);
+    connect(m_master, &ModbusMaster::idle, this, &PollScheduler::dispatch);
+    connect(m_master, &ModbusMaster::finished, this, &PollScheduler::onFinished);
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns @c true if the scheduler is polling the items
+ */
+bool PollScheduler::isRunning() const
+{
+    return m_running;
+}
+
+/**
+ * Returns @c true if the bus cannot sustain the configured poll rates, in
+ * which case the items are served in priority order.
+ */
+bool PollScheduler::overloaded() const
+{
+    return m_overloaded;
+}
+
+/**
+ * Returns the estimated bus load, i.e. the sum of the measured transaction
+ * time of every item divided by its period (1.0 = bus saturated).
+ */
+double PollScheduler::busLoad() const
+{
+    return m_busLoad;
+}
+
+/**
+ * Returns the IDs of the registered items
+ */
+QList<int> PollScheduler::itemIds() const
+{
+    return m_items.keys();
+}
+
+/**
+ * Returns the counters & timing measurements of the item with the given @a id
+ */
+PollScheduler::ItemStatistics PollScheduler::itemStatistics(const int id) const
+{
+    return m_items.value(id).statistics;
+}
+
+//----------------------------------------------------------------------------------------
+// Item management
+//----------------------------------------------------------------------------------------
+
+/**
+ * Registers a new item that sends @a request every @a periodMs milliseconds,
+ * items with a higher @a priority are preferred when the bus is overloaded.
+ * Returns the ID of the item.
+ */
+int PollScheduler::addItem(const ModbusMaster::Request &request, const int periodMs,
+                           const int priority)
+{
+    Item item;
+    item.request = request;
+    item.periodUs = qint64(qMax(periodMs, 1)) * 1000;
+    item.priority = priority;
+    item.deadlineUs = nowUs();
+    item.lastPollUs = -1;
+    item.transactionUs = 0;
+    item.statistics = ItemStatistics();
+
+    const int id = m_nextId++;
+    m_items.insert(id, item);
+
+    if (m_running)
+        dispatch();
+
+    return id;
+}
+
+/**
+ * Unregisters the item with the given @a id
+ */
+void PollScheduler::removeItem(const int id)
+{
+    m_items.remove(id);
+    updateLoad();
+}
+
+/**
+ * Changes the poll period of the item with the given @a id
+ */
+void PollScheduler::setItemPeriod(const int id, const int periodMs)
+{
+    auto it = m_items.find(id);
+    if (it == m_items.end())
+        return;
+
+    it->periodUs = qint64(qMax(periodMs, 1)) * 1000;
+    updateLoad();
+}
+
+/**
+ * Changes the priority of the item with the given @a id
+ */
+void PollScheduler::setItemPriority(const int id, const int priority)
+{
+    auto it = m_items.find(id);
+    if (it != m_items.end())
+        it->priority = priority;
+}
+
+/**
+ * Starts polling, every item is due immediately
+ */
+void PollScheduler::start()
+{
+    const qint64 now = nowUs();
+    for (auto it = m_items.begin(); it != m_items.end(); ++it)
+    {
+        it->deadlineUs = now;
+        it->lastPollUs = -1;
+    }
+
+    m_running = true;
+    dispatch();
+}
+
+/**
+ * Stops polling, the transaction in flight (if any) still completes
+ */
+void PollScheduler::stop()
+{
+    m_running = false;
+    m_timer.stop();
+}
+
+/**
+ * Changes the number of unused registers that may be read to merge two polls
+ * (0 by default, only adjacent & overlapping ranges are merged). Reading a
+ * few unused registers is cheaper than the request header, CRC, inter-frame
+ * gap & slave turnaround of a second poll, but the slave must accept reads
+ * of the whole merged range.
+ */
+void PollScheduler::setMergeGap(const int registers)
+{
+    m_mergeGap = qMax(registers, 0);
+}
+
+//----------------------------------------------------------------------------------------
+// Scheduling
+//----------------------------------------------------------------------------------------
+
+/**
+ * Hands the most urgent due item (merged with its compatible neighbours) to
+ * the bus, or arms the timer for the next deadline if no item is due.
+ *
+ * Only one transaction is handed to the master at a time, so that the choice
+ * of the next poll is made as late as possible.
+ */
+void PollScheduler::dispatch()
+{
+    if (!m_running || m_inFlight != 0 || m_master->isBusy())
+        return;
+
+    // Find the most urgent due item, a linear scan is negligible compared to
+    // the duration of a bus transaction
+    const qint64 now = nowUs();
+    qint64 nextDeadline = -1;
+    auto best = m_items.end();
+    for (auto it = m_items.begin(); it != m_items.end(); ++it)
+    {
+        if (it->deadlineUs <= now)
+        {
+            if (best == m_items.end() || before(*it, *best))
+                best = it;
+        }
+
+        else if (nextDeadline < 0 || it->deadlineUs < nextDeadline)
+            nextDeadline = it->deadlineUs;
+    }
+
+    if (best == m_items.end())
+    {
+        if (nextDeadline >= 0)
+            m_timer.start(int((nextDeadline - now + 999) / 1000));
+
+        return;
+    }
+
+    // Merge the due reads of the same slave into a single request
+    ModbusMaster::Request request = best->request;
+    m_inFlightSlices.clear();
+    m_inFlightSlices.append(Slice { best.key(), 0 });
+
+    if (isRead(request.function))
+    {
+        int first = request.address;
+        int last = request.address + request.count;
+        for (auto it = m_items.begin(); it != m_items.end(); ++it)
+        {
+            if (it == best || it->deadlineUs > now || !canMerge(*best, *it))
+                continue;
+
+            const int start = it->request.address;
+            const int end = start + it->request.count;
+            if (start > last + m_mergeGap || end < first - m_mergeGap)
+                continue;
+
+            if (qMax(last, end) - qMin(first, start) > MAX_READ_REGISTERS)
+                continue;
+
+            first = qMin(first, start);
+            last = qMax(last, end);
+            m_inFlightSlices.append(Slice { it.key(), 0 });
+        }
+
+        request.address = quint16(first);
+        request.count = quint16(last - first);
+    }
+
+    for (int i = 0; i < m_inFlightSlices.count(); ++i)
+    {
+        Item &item = m_items[m_inFlightSlices[i].id];
+        m_inFlightSlices[i].offset = item.request.address - request.address;
+        if (i > 0)
+            ++item.statistics.merged;
+
+        release(item, now);
+    }
+
+    m_inFlightRequest = request;
+    m_inFlightSentUs = now;
+    m_inFlight = m_master->enqueue(request);
+
+    // Invalid request, account it & move on to the next due item
+    if (m_inFlight == 0)
+    {
+        for (int i = 0; i < m_inFlightSlices.count(); ++i)
+            ++m_items[m_inFlightSlices[i].id].statistics.errors;
+
+        m_timer.start(0);
+    }
+}
+
+/**
+ * Splits the reply of the transaction in flight among the polled items
+ */
+void PollScheduler::onFinished(const ModbusMaster::Reply &reply)
+{
+    if (m_inFlight == 0 || reply.id != m_inFlight)
+        return;
+
+    m_inFlight = 0;
+    const qint64 elapsed = nowUs() - m_inFlightSentUs;
+    const qint64 share = elapsed / qMax(m_inFlightSlices.count(), 1);
+    const QVector<Slice> slices = m_inFlightSlices;
+
+    for (int i = 0; i < slices.count(); ++i)
+    {
+        auto it = m_items.find(slices[i].id);
+        if (it == m_items.end())
+            continue;
+
+        it->transactionUs = it->transactionUs ? ema(it->transactionUs, share) : share;
+        it->statistics.roundTripUs = reply.roundTripUs;
+        if (reply.error == ModbusMaster::NoError)
+            ++it->statistics.replies;
+        else
+            ++it->statistics.errors;
+
+        ModbusMaster::Reply result = reply;
+        result.address = it->request.address;
+        if (isRead(reply.function) && reply.error == ModbusMaster::NoError)
+            result.values = reply.values.mid(slices[i].offset, it->request.count);
+
+        Q_EMIT itemReply(slices[i].id, result);
+    }
+
+    updateLoad();
+}
+
+/**
+ * Returns the monotonic time in microseconds
+ */
+qint64 PollScheduler::nowUs() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+/**
+ * Returns @c true if item @a a must be polled before item @a b: earliest
+ * deadline first, or highest priority first while the bus is overloaded.
+ */
+bool PollScheduler::before(const PollScheduler::Item &a, const PollScheduler::Item &b) const
+{
+    if (m_overloaded && a.priority != b.priority)
+        return a.priority > b.priority;
+
+    if (a.deadlineUs != b.deadlineUs)
+        return a.deadlineUs < b.deadlineUs;
+
+    return a.priority > b.priority;
+}
+
+/**
+ * Returns @c true if the polls of @a a & @a b can be served by one request
+ */
+bool PollScheduler::canMerge(const PollScheduler::Item &a, const PollScheduler::Item &b) const
+{
+    return a.request.slave == b.request.slave
+           && a.request.function == b.request.function
+           && isRead(a.request.function);
+}
+
+/**
+ * Accounts a poll of @a item sent at @a now & moves its deadline to the next
+ * period. Instances that are already more than one period late are skipped
+ * instead of being sent back to back.
+ */
+void PollScheduler::release(PollScheduler::Item &item, const qint64 now)
+{
+    ItemStatistics &stats = item.statistics;
+    if (item.lastPollUs >= 0)
+    {
+        const qint64 interval = now - item.lastPollUs;
+        const qint64 deviation = qAbs(interval - item.periodUs);
+
+        if (stats.meanIntervalUs == 0)
+            stats.meanIntervalUs = interval;
+        else
+            stats.meanIntervalUs = ema(stats.meanIntervalUs, interval);
+
+        stats.jitterUs = ema(stats.jitterUs, deviation);
+        stats.maxJitterUs = qMax(stats.maxJitterUs, deviation);
+        if (stats.meanIntervalUs > 0)
+            stats.achievedRate = 1e6 / stats.meanIntervalUs;
+    }
+
+    ++stats.polls;
+    item.lastPollUs = now;
+    item.deadlineUs += item.periodUs;
+    if (item.deadlineUs <= now)
+    {
+        const qint64 missed = (now - item.deadlineUs) / item.periodUs + 1;
+        item.deadlineUs += missed * item.periodUs;
+        stats.skipped += quint64(missed);
+    }
+}
+
+/**
+ * Recomputes the estimated bus load & updates the overload state
+ */
+void PollScheduler::updateLoad()
+{
+    double load = 0;
+    for (auto it = m_items.constBegin(); it != m_items.constEnd(); ++it)
+        load += double(it->transactionUs) / it->periodUs;
+
+    m_busLoad = load;
+
+    const bool overloaded = m_overloaded ? load > OVERLOAD_OFF : load > OVERLOAD_ON;
+    if (overloaded != m_overloaded)
+    {
+        m_overloaded = overloaded;
+        Q_EMIT overloadedChanged();
+    }
+}
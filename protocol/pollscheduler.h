@@ -0,0 +1,110 @@
+#ifndef POLLSCHEDULER_H
+#define POLLSCHEDULER_H
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "modbusmaster.h"
+
+/**
+ * Periodic poll scheduler for the devices on a Modbus bus.
+ *
+ * Each item polls one register range with its own period & priority. The bus
+ * is handed one transaction at a time, always to the due item with the
+ * earliest deadline; items that are due at the same time on the same slave
+ * are merged into a single request when their register ranges are adjacent
+ * (or closer than @c setMergeGap() registers).
+ *
+ * When the bus cannot sustain the configured rates the scheduler switches to
+ * priority order, so that high-priority items keep their rate while the
+ * missed instances of low-priority items are skipped.
+ */
+class PollScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    struct ItemStatistics
+    {
+        quint64 polls;
+        quint64 replies;
+        quint64 errors;
+        quint64 skipped;
+        quint64 merged;
+        double achievedRate;
+        qint64 meanIntervalUs;
+        qint64 jitterUs;
+        qint64 maxJitterUs;
+        qint64 roundTripUs;
+    };
+
+    explicit PollScheduler(ModbusMaster *master, QObject *parent = nullptr);
+
+    bool isRunning() const;
+    bool overloaded() const;
+    double busLoad() const;
+    QList<int> itemIds() const;
+    ItemStatistics itemStatistics(const int id) const;
+
+    int addItem(const ModbusMaster::Request &request, const int periodMs,
+                const int priority = 0);
+    void removeItem(const int id);
+    void setItemPeriod(const int id, const int periodMs);
+    void setItemPriority(const int id, const int priority);
+
+Q_SIGNALS:
+    void itemReply(const int id, const ModbusMaster::Reply &reply);
+    void overloadedChanged();
+
+public Q_SLOTS:
+    void start();
+    void stop();
+    void setMergeGap(const int registers);
+
+private Q_SLOTS:
+    void dispatch();
+    void onFinished(const ModbusMaster::Reply &reply);
+
+private:
+    struct Item
+    {
+        ModbusMaster::Request request;
+        qint64 periodUs;
+        int priority;
+        qint64 deadlineUs;
+        qint64 lastPollUs;
+        qint64 transactionUs;
+        ItemStatistics statistics;
+    };
+
+    struct Slice
+    {
+        int id;
+        int offset;
+    };
+
+    qint64 nowUs() const;
+    bool before(const Item &a, const Item &b) const;
+    bool canMerge(const Item &a, const Item &b) const;
+    void release(Item &item, const qint64 now);
+    void updateLoad();
+
+private:
+    ModbusMaster *m_master;
+    bool m_running;
+    bool m_overloaded;
+    double m_busLoad;
+    int m_nextId;
+    int m_mergeGap;
+
+    QHash<int, Item> m_items;
+    quint64 m_inFlight;
+    qint64 m_inFlightSentUs;
+    ModbusMaster::Request m_inFlightRequest;
+    QVector<Slice> m_inFlightSlices;
+
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+};
+
+#endif // POLLSCHEDULER_H
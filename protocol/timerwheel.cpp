@@ -0,0 +1,191 @@
+#include "timerwheel.h"
+
+/**
+ * Marks the end of an intrusive list
+ */
+static const int NIL = -1;
+
+//----------------------------------------------------------------------------------------
+// Constructor function
+//----------------------------------------------------------------------------------------
+
+/**
+ * Creates a wheel with (at least) @a slots slots of @a tickUs microseconds,
+ * one revolution of the wheel lasts @c slots * @c tickUs.
+ */
+TimerWheel::TimerWheel(const int slots, const qint64 tickUs)
+    : m_tickUs(qMax<qint64>(tickUs, 1))
+    , m_currentTick(0)
+    , m_count(0)
+    , m_freeList(NIL)
+{
+    size_t size = 2;
+    while (size < size_t(qMax(slots, 2)))
+        size <<= 1;
+
+    m_slots.assign(size, NIL);
+    m_mask = size - 1;
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns the resolution of the wheel in microseconds
+ */
+qint64 TimerWheel::tickUs() const
+{
+    return m_tickUs;
+}
+
+/**
+ * Returns the number of scheduled timers
+ */
+int TimerWheel::count() const
+{
+    return m_count;
+}
+
+/**
+ * Returns @c true if no timer is scheduled
+ */
+bool TimerWheel::isEmpty() const
+{
+    return m_count == 0;
+}
+
+//----------------------------------------------------------------------------------------
+// Timers
+//----------------------------------------------------------------------------------------
+
+/**
+ * Schedules a timer that expires at @a deadlineUs (rounded up to the next
+ * tick) & returns its handle, @a payload is reported by @c advance().
+ */
+quint64 TimerWheel::schedule(const qint64 deadlineUs, const quint64 payload)
+{
+    // Deadlines in the past expire on the next advance
+    const qint64 tick = qMax((deadlineUs + m_tickUs - 1) / m_tickUs, m_currentTick + 1);
+
+    int index = m_freeList;
+    if (index != NIL)
+        m_freeList = m_entries[size_t(index)].next;
+    else
+    {
+        index = int(m_entries.size());
+        m_entries.push_back(Entry());
+        m_entries.back().generation = 0;
+    }
+
+    Entry &entry = m_entries[size_t(index)];
+    entry.tick = tick;
+    entry.payload = payload;
+    entry.slot = int(size_t(tick) & m_mask);
+    entry.prev = NIL;
+    entry.next = m_slots[size_t(entry.slot)];
+    if (entry.next != NIL)
+        m_entries[size_t(entry.next)].prev = index;
+
+    m_slots[size_t(entry.slot)] = index;
+    ++m_count;
+
+    return (quint64(entry.generation) << 32) | quint64(quint32(index));
+}
+
+/**
+ * Cancels the timer with the given @a handle, returns @c false if it has
+ * already expired or was cancelled
+ */
+bool TimerWheel::cancel(const quint64 handle)
+{
+    const int index = int(quint32(handle));
+    const quint32 generation = quint32(handle >> 32);
+    if (index < 0 || size_t(index) >= m_entries.size())
+        return false;
+
+    const Entry &entry = m_entries[size_t(index)];
+    if (entry.generation != generation || entry.slot == NIL)
+        return false;
+
+    unlink(index);
+    release(index);
+    return true;
+}
+
+/**
+ * Moves the wheel to @a nowUs & appends the payloads of the timers that
+ * expired to @a expired, in no particular order
+ */
+void TimerWheel::advance(const qint64 nowUs, std::vector<quint64> &expired)
+{
+    const qint64 nowTick = nowUs / m_tickUs;
+    if (nowTick <= m_currentTick)
+        return;
+
+    // After more than one revolution every slot has to be visited once
+    const qint64 ticks = qMin<qint64>(nowTick - m_currentTick, qint64(m_slots.size()));
+    for (qint64 i = 1; i <= ticks && m_count > 0; ++i)
+    {
+        const size_t slot = size_t(m_currentTick + i) & m_mask;
+        int index = m_slots[slot];
+        while (index != NIL)
+        {
+            const int next = m_entries[size_t(index)].next;
+            if (m_entries[size_t(index)].tick <= nowTick)
+            {
+                expired.push_back(m_entries[size_t(index)].payload);
+                unlink(index);
+                release(index);
+            }
+
+            index = next;
+        }
+    }
+
+    m_currentTick = nowTick;
+}
+
+/**
+ * Cancels all the timers
+ */
+void TimerWheel::clear()
+{
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+        if (m_entries[i].slot != NIL)
+        {
+            unlink(int(i));
+            release(int(i));
+        }
+    }
+}
+
+/**
+ * Removes the entry at @a index from the list of its slot
+ */
+void TimerWheel::unlink(const int index)
+{
+    Entry &entry = m_entries[size_t(index)];
+    if (entry.prev != NIL)
+        m_entries[size_t(entry.prev)].next = entry.next;
+    else
+        m_slots[size_t(entry.slot)] = entry.next;
+
+    if (entry.next != NIL)
+        m_entries[size_t(entry.next)].prev = entry.prev;
+}
+
+/**
+ * Returns the entry at @a index to the pool, invalidating its handles
+ */
+void TimerWheel::release(const int index)
+{
+    Entry &entry = m_entries[size_t(index)];
+    ++entry.generation;
+    entry.slot = NIL;
+    entry.prev = NIL;
+    entry.next = m_freeList;
+    m_freeList = index;
+    --m_count;
+}
@@ -0,0 +1,59 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QtGlobal>
+#include <vector>
+#include <cstddef>
+
+/**
+ * Hashed timer wheel for large numbers of concurrent timeouts.
+ *
+ * Time is divided into ticks of @c tickUs() microseconds. A timer is stored
+ * in the slot of its deadline tick modulo the number of slots, in an
+ * intrusive list, so that scheduling & cancelling are O(1) & allocation-free
+ * once the pool has grown. Advancing the wheel only visits the slots of the
+ * elapsed ticks; timers that are one or more revolutions away stay in their
+ * slot until their tick comes.
+ *
+ * Handles contain a generation counter, cancelling a timer that already
+ * expired (and whose entry was reused) has no effect.
+ */
+class TimerWheel
+{
+public:
+    explicit TimerWheel(const int slots = 512, const qint64 tickUs = 1000);
+
+    qint64 tickUs() const;
+    int count() const;
+    bool isEmpty() const;
+
+    quint64 schedule(const qint64 deadlineUs, const quint64 payload);
+    bool cancel(const quint64 handle);
+    void advance(const qint64 nowUs, std::vector<quint64> &expired);
+    void clear();
+
+private:
+    struct Entry
+    {
+        qint64 tick;
+        quint64 payload;
+        quint32 generation;
+        int prev;
+        int next;
+        int slot;
+    };
+
+    void unlink(const int index);
+    void release(const int index);
+
+private:
+    qint64 m_tickUs;
+    qint64 m_currentTick;
+    int m_count;
+    int m_freeList;
+    size_t m_mask;
+    std::vector<int> m_slots;
+    std::vector<Entry> m_entries;
+};
+
+#endif // TIMERWHEEL_H
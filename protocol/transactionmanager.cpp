@@ -0,0 +1,469 @@
+#include "transactionmanager.h"
+
+/**
+ * Default time to wait for a response after the request was written
+ */
+static const int DEFAULT_TIMEOUT_MS = 200;
+
+/**
+ * Resolution of the timeouts: duration of one tick of the wheel & interval of
+ * the timer that advances it while transactions are outstanding
+ */
+static const int TICK_MS = 5;
+
+/**
+ * Number of slots of the wheel, one revolution lasts ~2.5 seconds; longer
+ * timeouts simply stay in their slot for more than one revolution
+ */
+static const int WHEEL_SLOTS = 512;
+
+//----------------------------------------------------------------------------------------
+// Constructor/destructor
+//----------------------------------------------------------------------------------------
+
+/**
+ * Default options: 200 ms timeout, no retries, normal priority
+ */
+TransactionManager::Options::Options()
+    : timeoutMs(DEFAULT_TIMEOUT_MS)
+    , retries(0)
+    , priority(WriteQueue::Normal)
+{
+}
+
+/**
+ * Constructor function, transports are added with @c addTransport()
+ */
+TransactionManager::TransactionManager(QObject *parent)
+    : QObject(parent)
+    , m_nextId(1)
+    , m_wheel(WHEEL_SLOTS, TICK_MS * 1000)
+{
+    resetStatistics();
+    m_clock.start();
+
+    m_tickTimer.setInterval(TICK_MS);
+    m_tickTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_tickTimer, &QTimer::timeout, this, &TransactionManager::onTick);
+}
+
+/**
+ * Destructor function, the outstanding transactions are not reported
+ */
+TransactionManager::~TransactionManager()
+{
+    qDeleteAll(m_transports);
+}
+
+//----------------------------------------------------------------------------------------
+// Configuration
+//----------------------------------------------------------------------------------------
+
+/**
+ * Sends requests & receives responses through @a serial, returns the index
+ * of the transport to use with @c send()
+ */
+int TransactionManager::addTransport(Serial *serial)
+{
+    Transport *transport = new Transport;
+    transport->serial = serial;
+    transport->channel = Q_NULLPTR;
+
+    const int index = addTransport(transport);
+    connect(serial, &Serial::dataAvailable, this,
+            [=](const RingBuffer::Span &first, const RingBuffer::Span &second) {
+                onData(index, first, second);
+            },
+            Qt::DirectConnection);
+
+    // Serial may complete a write before send() returns its ID, queue the
+    // completions so that the ID is always registered first
+    connect(serial, &Serial::writeCompleted, this, &TransactionManager::onWriteCompleted,
+            Qt::QueuedConnection);
+    return index;
+}
+
+/**
+ * Sends requests & receives responses through @a channel, returns the index
+ * of the transport to use with @c send()
+ */
+int TransactionManager::addTransport(SerialChannel *channel)
+{
+    Transport *transport = new Transport;
+    transport->serial = Q_NULLPTR;
+    transport->channel = channel;
+
+    const int index = addTransport(transport);
+    connect(channel, &SerialChannel::dataAvailable, this,
+            [=](const RingBuffer::Span &first, const RingBuffer::Span &second) {
+                onData(index, first, second);
+            },
+            Qt::DirectConnection);
+    connect(channel, &SerialChannel::writeCompleted, this,
+            &TransactionManager::onWriteCompleted);
+    return index;
+}
+
+/**
+ * Splits the data received by every transport into frames according to
+ * @a config
+ */
+void TransactionManager::setFraming(const Deframer::Configuration &config)
+{
+    Q_FOREACH (Transport *transport, m_transports)
+        transport->deframer.setConfiguration(config);
+}
+
+/**
+ * Changes the function that extracts the correlation key of a response
+ * frame, frames for which it returns @c false are reported as unmatched
+ */
+void TransactionManager::setKeyFunction(const KeyFunction &function)
+{
+    m_keyFunction = function;
+}
+
+/**
+ * Returns a correlation key made of an @a address (e.g. slave or node ID), a
+ * @a function (e.g. command code) & a @a sequence number, for protocols that
+ * have some of them in their requests and responses
+ */
+quint64 TransactionManager::makeKey(const quint16 address, const quint16 function,
+                                    const quint32 sequence)
+{
+    return (quint64(address) << 48) | (quint64(function) << 32) | quint64(sequence);
+}
+
+/**
+ * Registers @a transport & feeds its frames to @c onFrame()
+ */
+int TransactionManager::addTransport(Transport *transport)
+{
+    const int index = m_transports.count();
+    if (!m_transports.isEmpty())
+        transport->deframer.setConfiguration(m_transports.first()->deframer.configuration());
+
+    transport->deframer.setFrameHandler([=](const char *frame, int size) {
+        onFrame(index, frame, size);
+    });
+
+    m_transports.append(transport);
+    return index;
+}
+
+//----------------------------------------------------------------------------------------
+// Transactions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Sends @a request through @a transport & waits for a response with the
+ * correlation @a key, returns the ID of the transaction.
+ *
+ * The outcome is reported exactly once through @a callback (if any) and
+ * @c finished(), never before this function returns.
+ */
+quint64 TransactionManager::send(const int transport, const QByteArray &request,
+                                 const quint64 key, const Options &options,
+                                 const Callback &callback)
+{
+    Transaction transaction;
+    transaction.id = m_nextId++;
+    transaction.transport = transport;
+    transaction.key = key;
+    transaction.request = request;
+    transaction.options = options;
+    transaction.callback = callback;
+    transaction.attempts = 0;
+    transaction.writeId = 0;
+    transaction.timer = 0;
+    transaction.transmittedUs = 0;
+    transaction.sentUs = 0;
+
+    ++m_statistics.requests;
+    const quint64 id = transaction.id;
+    m_transactions.insert(id, transaction);
+    m_outstanding[Correlation(transport, key)].append(id);
+    transmit(m_transactions[id]);
+    return id;
+}
+
+/**
+ * Cancels the transaction @a id, returns @c false if it already finished
+ */
+bool TransactionManager::cancel(const quint64 id)
+{
+    if (!m_transactions.contains(id))
+        return false;
+
+    finish(id, Cancelled);
+    return true;
+}
+
+/**
+ * Cancels all the outstanding transactions
+ */
+void TransactionManager::cancelAll()
+{
+    const QList<quint64> ids = m_transactions.keys();
+    Q_FOREACH (const quint64 id, ids)
+        finish(id, Cancelled);
+}
+
+/**
+ * Returns the number of transactions waiting for a response
+ */
+int TransactionManager::pendingTransactions() const
+{
+    return m_transactions.count();
+}
+
+/**
+ * Returns the average round-trip time of the completed transactions
+ */
+qint64 TransactionManager::meanRoundTripUs() const
+{
+    if (m_statistics.completed == 0)
+        return 0;
+
+    return m_statistics.totalRoundTripUs / qint64(m_statistics.completed);
+}
+
+/**
+ * Returns the transaction counters & round-trip times
+ */
+const TransactionManager::Statistics &TransactionManager::statistics() const
+{
+    return m_statistics;
+}
+
+/**
+ * Resets the transaction counters & round-trip times
+ */
+void TransactionManager::resetStatistics()
+{
+    m_statistics.requests = 0;
+    m_statistics.completed = 0;
+    m_statistics.timeouts = 0;
+    m_statistics.retries = 0;
+    m_statistics.sendFailures = 0;
+    m_statistics.unmatched = 0;
+    m_statistics.minRoundTripUs = 0;
+    m_statistics.maxRoundTripUs = 0;
+    m_statistics.totalRoundTripUs = 0;
+}
+
+/**
+ * Returns the time in microseconds since the manager was created
+ */
+qint64 TransactionManager::nowUs() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+/**
+ * Writes the request of @a transaction (again), its timeout is armed once
+ * the request was written
+ */
+void TransactionManager::transmit(Transaction &transaction)
+{
+    ++transaction.attempts;
+    transaction.transmittedUs = nowUs();
+    transaction.sentUs = 0;
+    if (transaction.timer != 0)
+    {
+        m_wheel.cancel(transaction.timer);
+        transaction.timer = 0;
+    }
+
+    quint64 writeId = 0;
+    Transport *transport = m_transports.value(transaction.transport);
+    if (transport && transport->serial)
+        writeId = transport->serial->send(transaction.request, transaction.options.priority);
+    else if (transport && transport->channel)
+        writeId = transport->channel->write(transaction.request, transaction.options.priority);
+
+    // Report the failure from the event loop, so that send() never finishes
+    // a transaction before returning its ID
+    if (writeId == 0)
+    {
+        transaction.writeId = 0;
+        arm(transaction, transaction.transmittedUs - transaction.options.timeoutMs * 1000LL);
+        return;
+    }
+
+    transaction.writeId = writeId;
+    m_writes.insert(writeId, transaction.id);
+}
+
+/**
+ * (Re)schedules the timeout of @a transaction at @a fromUs + its timeout
+ */
+void TransactionManager::arm(Transaction &transaction, const qint64 fromUs)
+{
+    if (transaction.timer != 0)
+        m_wheel.cancel(transaction.timer);
+
+    const qint64 deadline = fromUs + transaction.options.timeoutMs * 1000LL;
+    transaction.timer = m_wheel.schedule(deadline, transaction.id);
+    if (!m_tickTimer.isActive())
+        m_tickTimer.start();
+}
+
+/**
+ * Starts the timeout of a request once it was written to the driver, or
+ * fails the transaction if the request could not be written
+ */
+void TransactionManager::onWriteCompleted(const quint64 writeId,
+                                          const WriteQueue::Status status)
+{
+    const quint64 id = m_writes.take(writeId);
+    if (id == 0 || !m_transactions.contains(id))
+        return;
+
+    Transaction &transaction = m_transactions[id];
+    transaction.writeId = 0;
+    if (status == WriteQueue::Written)
+    {
+        transaction.sentUs = nowUs();
+        arm(transaction, transaction.sentUs);
+    }
+
+    else
+        finish(id, SendFailed);
+}
+
+/**
+ * Expires the timeouts that are due, retries the requests that have attempts
+ * left & stops the timer when nothing is outstanding
+ */
+void TransactionManager::onTick()
+{
+    const qint64 now = nowUs();
+    Q_FOREACH (Transport *transport, m_transports)
+        transport->deframer.checkTimeout(now);
+
+    m_expired.clear();
+    m_wheel.advance(now, m_expired);
+    for (const quint64 id : m_expired)
+    {
+        if (!m_transactions.contains(id))
+            continue;
+
+        // Timeouts are only armed once the request was written, or right
+        // away when it could not be handed to the port at all
+        Transaction &transaction = m_transactions[id];
+        transaction.timer = 0;
+        if (transaction.sentUs == 0)
+            finish(id, SendFailed);
+
+        else if (transaction.attempts <= transaction.options.retries)
+        {
+            ++m_statistics.retries;
+            transmit(transaction);
+        }
+
+        else
+            finish(id, Timeout);
+    }
+
+    if (m_wheel.isEmpty())
+        m_tickTimer.stop();
+}
+
+/**
+ * Feeds the data received by @a transport to its deframer
+ */
+void TransactionManager::onData(const int transport, const RingBuffer::Span &first,
+                                const RingBuffer::Span &second)
+{
+    Transport *target = m_transports.value(transport);
+    if (!target)
+        return;
+
+    const qint64 now = nowUs();
+    target->deframer.process(first.data, int(first.size), now);
+    if (second.size > 0)
+        target->deframer.process(second.data, int(second.size), now);
+}
+
+/**
+ * Completes the oldest outstanding transaction of @a transport whose key
+ * matches the one of the received @a frame
+ */
+void TransactionManager::onFrame(const int transport, const char *frame, const int size)
+{
+    quint64 key = 0;
+    const bool hasKey = m_keyFunction && m_keyFunction(frame, size, key);
+    const QList<quint64> ids = hasKey ? m_outstanding.value(Correlation(transport, key))
+                                      : QList<quint64>();
+    if (ids.isEmpty())
+    {
+        ++m_statistics.unmatched;
+        Q_EMIT unmatchedResponse(transport, QByteArray(frame, size));
+        return;
+    }
+
+    finish(ids.first(), Completed, frame, size);
+}
+
+/**
+ * Removes the transaction @a id & reports its outcome
+ */
+void TransactionManager::finish(const quint64 id, const Status status, const char *frame,
+                                const int size)
+{
+    const Transaction transaction = m_transactions.take(id);
+    if (transaction.timer != 0)
+        m_wheel.cancel(transaction.timer);
+    if (transaction.writeId != 0)
+        m_writes.remove(transaction.writeId);
+
+    const Correlation correlation(transaction.transport, transaction.key);
+    QList<quint64> &ids = m_outstanding[correlation];
+    ids.removeOne(id);
+    if (ids.isEmpty())
+        m_outstanding.remove(correlation);
+
+    Result result;
+    result.id = id;
+    result.transport = transaction.transport;
+    result.key = transaction.key;
+    result.status = status;
+    result.attempts = transaction.attempts;
+    result.roundTripUs = 0;
+
+    switch (status)
+    {
+        case Completed:
+        {
+            // A response may be parsed before the write completion arrives
+            const qint64 start = transaction.sentUs != 0 ? transaction.sentUs
+                                                         : transaction.transmittedUs;
+            result.roundTripUs = nowUs() - start;
+            result.response = QByteArray(frame, size);
+
+            if (m_statistics.completed == 0 || result.roundTripUs < m_statistics.minRoundTripUs)
+                m_statistics.minRoundTripUs = result.roundTripUs;
+            m_statistics.maxRoundTripUs = qMax(m_statistics.maxRoundTripUs, result.roundTripUs);
+            m_statistics.totalRoundTripUs += result.roundTripUs;
+            ++m_statistics.completed;
+            break;
+        }
+        case Timeout:
+            ++m_statistics.timeouts;
+            break;
+        case SendFailed:
+            ++m_statistics.sendFailures;
+            break;
+        case Cancelled:
+            break;
+    }
+
+    if (m_wheel.isEmpty())
+        m_tickTimer.stop();
+
+    if (transaction.callback)
+        transaction.callback(result);
+
+    Q_EMIT finished(result);
+}
@@ -0,0 +1,175 @@
+#ifndef TRANSACTIONMANAGER_H
+#define TRANSACTIONMANAGER_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <functional>
+#include "serial.h"
+#include "serialchannel.h"
+#include "deframer.h"
+#include "timerwheel.h"
+
+/**
+ * Protocol-agnostic request/response correlation on top of @c Serial and the
+ * channels of @c PortManager.
+ *
+ * Every request is sent with a correlation key (e.g. built with @c makeKey()
+ * from the slave address, function code & sequence number). Received bytes
+ * are split into frames by a @c Deframer, the key of each frame is extracted
+ * by the configured key function & the frame completes the oldest
+ * outstanding request with the same key on the same transport.
+ *
+ * All the timeouts share a single @c TimerWheel driven by one coarse timer,
+ * so that thousands of outstanding transactions cost one timer & O(1) work
+ * per request instead of one @c QTimer each. The timeout of an attempt is
+ * measured from the moment the request was written to the driver, so time
+ * spent in the write queue (e.g. while flow control holds the line) does not
+ * count against the device. Timed out requests are retried up to
+ * @c Options::retries times; since the timeout only starts once the previous
+ * copy was written, a retry never queues a second copy behind the first one.
+ * A request stuck in the queue waits until it is written, fails (e.g. the
+ * port is closed) or the transaction is cancelled.
+ *
+ * @note The transports must deliver their data on the thread of the manager
+ *       (channels are opened with @c PortManager::CallerThread), since the
+ *       frames are parsed in place.
+ */
+class TransactionManager : public QObject
+{
+    Q_OBJECT
+public:
+    enum Status
+    {
+        Completed,
+        Timeout,
+        SendFailed,
+        Cancelled,
+    };
+    Q_ENUM(Status)
+
+    struct Options
+    {
+        Options();
+
+        int timeoutMs;
+        int retries;
+        WriteQueue::Priority priority;
+    };
+
+    struct Result
+    {
+        quint64 id;
+        int transport;
+        quint64 key;
+        Status status;
+        int attempts;
+        qint64 roundTripUs;
+        QByteArray response;
+    };
+
+    struct Statistics
+    {
+        quint64 requests;
+        quint64 completed;
+        quint64 timeouts;
+        quint64 retries;
+        quint64 sendFailures;
+        quint64 unmatched;
+        qint64 minRoundTripUs;
+        qint64 maxRoundTripUs;
+        qint64 totalRoundTripUs;
+    };
+
+    typedef std::function<bool(const char *frame, int size, quint64 &key)> KeyFunction;
+    typedef std::function<void(const TransactionManager::Result &result)> Callback;
+
+    explicit TransactionManager(QObject *parent = nullptr);
+    ~TransactionManager();
+
+    int addTransport(Serial *serial);
+    int addTransport(SerialChannel *channel);
+
+    void setFraming(const Deframer::Configuration &config);
+    void setKeyFunction(const KeyFunction &function);
+
+    static quint64 makeKey(const quint16 address, const quint16 function,
+                           const quint32 sequence = 0);
+
+    quint64 send(const int transport, const QByteArray &request, const quint64 key,
+                 const Options &options = Options(),
+                 const Callback &callback = Callback());
+
+    int pendingTransactions() const;
+    qint64 meanRoundTripUs() const;
+    const Statistics &statistics() const;
+    void resetStatistics();
+
+Q_SIGNALS:
+    void finished(const TransactionManager::Result &result);
+    void unmatchedResponse(const int transport, const QByteArray &frame);
+
+public Q_SLOTS:
+    bool cancel(const quint64 id);
+    void cancelAll();
+
+private Q_SLOTS:
+    void onTick();
+    void onWriteCompleted(const quint64 writeId, const WriteQueue::Status status);
+
+private:
+    struct Transport
+    {
+        Serial *serial;
+        SerialChannel *channel;
+        Deframer deframer;
+    };
+
+    struct Transaction
+    {
+        quint64 id;
+        int transport;
+        quint64 key;
+        QByteArray request;
+        Options options;
+        Callback callback;
+        int attempts;
+        quint64 writeId;
+        quint64 timer;
+        qint64 transmittedUs;
+        qint64 sentUs;
+    };
+
+    typedef QPair<int, quint64> Correlation;
+
+    int addTransport(Transport *transport);
+    qint64 nowUs() const;
+    void transmit(Transaction &transaction);
+    void arm(Transaction &transaction, const qint64 fromUs);
+    void onData(const int transport, const RingBuffer::Span &first,
+                const RingBuffer::Span &second);
+    void onFrame(const int transport, const char *frame, const int size);
+    void finish(const quint64 id, const Status status, const char *frame = Q_NULLPTR,
+                const int size = 0);
+
+private:
+    QList<Transport *> m_transports;
+    KeyFunction m_keyFunction;
+
+    quint64 m_nextId;
+    QHash<quint64, Transaction> m_transactions;
+    QHash<Correlation, QList<quint64>> m_outstanding;
+    QHash<quint64, quint64> m_writes;
+
+    TimerWheel m_wheel;
+    QTimer m_tickTimer;
+    QElapsedTimer m_clock;
+    std::vector<quint64> m_expired;
+
+    Statistics m_statistics;
+};
+
+#endif // TRANSACTIONMANAGER_H
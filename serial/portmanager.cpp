@@ -0,0 +1,172 @@
+#include "portmanager.h"
+
+//----------------------------------------------------------------------------------------
+// Constructor/destructor & singleton access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function
+ */
+PortManager::PortManager(QObject *parent)
+    : QObject(parent)
+    , m_nextId(1)
+{
+    // Construct the counters first, so that they outlive the channels
+    Misc::Instrumentation::instance();
+}
+
+/**
+ * Destructor function, closes all the ports & stops the decode threads
+ */
+PortManager::~PortManager()
+{
+    Q_FOREACH (SerialChannel *channel, m_channels)
+        channel->close();
+
+    Q_FOREACH (QThread *thread, m_decodeThreads)
+    {
+        thread->quit();
+        thread->wait();
+    }
+
+    // No decode thread is running anymore, the channels can be deleted here
+    qDeleteAll(m_channels);
+    qDeleteAll(m_decodeThreads);
+}
+
+/**
+ * Returns the only instance of the class
+ */
+PortManager &PortManager::instance()
+{
+    static PortManager singleton;
+    return singleton;
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns the number of decode threads started so far
+ */
+int PortManager::decodeThreadCount() const
+{
+    return m_decodeThreads.count();
+}
+
+/**
+ * Returns the IDs of the open channels
+ */
+QList<int> PortManager::channelIds() const
+{
+    return m_channels.keys();
+}
+
+/**
+ * Returns the channel with the given @a id, or @c Q_NULLPTR
+ */
+SerialChannel *PortManager::channel(const int id) const
+{
+    return m_channels.value(id, Q_NULLPTR);
+}
+
+//----------------------------------------------------------------------------------------
+// Port control
+//----------------------------------------------------------------------------------------
+
+/**
+ * Opens the serial port described by @a config with a receive buffer of (at
+ * least) @a rxBufferSize bytes. Returns the new channel, or @c Q_NULLPTR if
+ * the port could not be opened.
+ *
+ * With @c DecodePool the data is handed to the consumers & deframed on a
+ * decode thread, otherwise on the calling thread.
+ */
+SerialChannel *PortManager::open(const SerialWorker::Configuration &config,
+                                 const quint32 rxBufferSize,
+                                 const PortManager::Affinity affinity)
+{
+    const int id = m_nextId++;
+    SerialChannel *channel = new SerialChannel(id, rxBufferSize);
+    if (!channel->open(config))
+    {
+        delete channel;
+        return Q_NULLPTR;
+    }
+
+    // Pending data notifications follow the channel to its decode thread
+    if (affinity == DecodePool)
+        channel->moveToThread(leastLoadedDecodeThread());
+
+    m_channels.insert(id, channel);
+    Q_EMIT channelOpened(id);
+    return channel;
+}
+
+/**
+ * Closes the port of @a channel & deletes the channel on its own thread
+ */
+void PortManager::close(SerialChannel *channel)
+{
+    if (channel == Q_NULLPTR || !m_channels.contains(channel->id()))
+        return;
+
+    const int id = channel->id();
+    m_channels.remove(id);
+    channel->close();
+    channel->deleteLater();
+
+    Q_EMIT channelClosed(id);
+}
+
+/**
+ * Closes all the open ports
+ */
+void PortManager::closeAll()
+{
+    Q_FOREACH (SerialChannel *channel, m_channels)
+        close(channel);
+}
+
+/**
+ * Returns the decode thread with the lowest sum of configured baud rates,
+ * starting a new thread while there are fewer threads than CPU cores.
+ */
+QThread *PortManager::leastLoadedDecodeThread()
+{
+    QMap<QThread *, qint64> load;
+    Q_FOREACH (QThread *thread, m_decodeThreads)
+        load.insert(thread, 0);
+
+    Q_FOREACH (SerialChannel *channel, m_channels)
+    {
+        if (load.contains(channel->thread()))
+            load[channel->thread()] += channel->configuration().baudRate;
+    }
+
+    // Use an idle thread if there is one
+    for (auto it = load.constBegin(); it != load.constEnd(); ++it)
+    {
+        if (it.value() == 0)
+            return it.key();
+    }
+
+    if (m_decodeThreads.count() < qMax(QThread::idealThreadCount(), 1))
+    {
+        QThread *thread = new QThread;
+        thread->setObjectName(QString("SerialDecode-%1").arg(m_decodeThreads.count()));
+        thread->start(QThread::HighPriority);
+        m_decodeThreads.append(thread);
+        return thread;
+    }
+
+    QThread *best = m_decodeThreads.first();
+    Q_FOREACH (QThread *thread, m_decodeThreads)
+    {
+        if (load.value(thread) < load.value(best))
+            best = thread;
+    }
+
+    return best;
+}
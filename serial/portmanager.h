@@ -0,0 +1,71 @@
+#ifndef PORTMANAGER_H
+#define PORTMANAGER_H
+
+#include <QObject>
+#include <QMap>
+#include <QVector>
+#include <QThread>
+#include "serialchannel.h"
+
+/**
+ * Opens & keeps track of any number of concurrent serial ports.
+ *
+ * Every port runs on its own I/O thread (see @c SerialChannel). Channels
+ * opened with @c DecodePool are drained & deframed (see
+ * @c SerialChannel::setFraming()) on a pool of decode threads sized to the
+ * number of CPU cores, each channel is assigned to the thread with the
+ * lowest aggregated baud rate, so that the decoding throughput scales with
+ * the cores while the bytes of a given port are always processed in order on
+ * one thread. Consumers on other threads receive whole frames through
+ * @c SerialChannel::frameReceived().
+ *
+ * @c Serial remains the facade used by the UI for the "current" port, its
+ * channel is drained on the GUI thread instead of the pool.
+ *
+ * @note The manager must only be used from the GUI thread.
+ */
+class PortManager : public QObject
+{
+    Q_OBJECT
+public:
+    enum Affinity
+    {
+        DecodePool,
+        CallerThread,
+    };
+
+    static PortManager &instance();
+
+    int decodeThreadCount() const;
+    QList<int> channelIds() const;
+    SerialChannel *channel(const int id) const;
+
+    SerialChannel *open(const SerialWorker::Configuration &config,
+                        const quint32 rxBufferSize,
+                        const Affinity affinity = DecodePool);
+    void close(SerialChannel *channel);
+
+Q_SIGNALS:
+    void channelOpened(const int id);
+    void channelClosed(const int id);
+
+public Q_SLOTS:
+    void closeAll();
+
+private:
+    explicit PortManager(QObject *parent = nullptr);
+    PortManager(PortManager &&) = delete;
+    PortManager(const PortManager &) = delete;
+    PortManager &operator=(PortManager &&) = delete;
+    PortManager &operator=(const PortManager &) = delete;
+    ~PortManager();
+
+    QThread *leastLoadedDecodeThread();
+
+private:
+    int m_nextId;
+    QMap<int, SerialChannel *> m_channels;
+    QVector<QThread *> m_decodeThreads;
+};
+
+#endif // PORTMANAGER_H
@@ -0,0 +1,256 @@
+#include "portscanner.h"
+#include <QSocketNotifier>
+
+#ifdef Q_OS_LINUX
+#    include <sys/inotify.h>
+#    include <unistd.h>
+#endif
+
+/**
+ * Time to wait after the first notification before enumerating, so that the
+ * burst of events caused by a single device (node creation, udev database,
+ * permissions, symlinks) results in a single scan.
+ */
+static const int SETTLE_INTERVAL_MS = 15;
+
+/**
+ * Polling interval used when device notifications are not available
+ */
+static const int POLL_INTERVAL_MS = 1000;
+
+/**
+ * Returns @c true if @a a and @a b describe the same device at the same
+ * location, the USB identity is compared as well because the udev data of
+ * a new device may become available after its node was created.
+ */
+static bool samePort(const QSerialPortInfo &a, const QSerialPortInfo &b)
+{
+    return a.systemLocation() == b.systemLocation()
+        && a.serialNumber() == b.serialNumber()
+        && a.vendorIdentifier() == b.vendorIdentifier()
+        && a.productIdentifier() == b.productIdentifier();
+}
+
+/**
+ * Returns the ports of @a ports that have no equivalent in @a reference
+ */
+static QVector<QSerialPortInfo> difference(const QVector<QSerialPortInfo> &ports,
+                                           const QVector<QSerialPortInfo> &reference)
+{
+    QVector<QSerialPortInfo> result;
+    Q_FOREACH (const QSerialPortInfo &info, ports)
+    {
+        bool found = false;
+        Q_FOREACH (const QSerialPortInfo &other, reference)
+        {
+            if (samePort(info, other))
+            {
+                found = true;
+                break;
+            }
+        }
+
+        if (!found)
+            result.append(info);
+    }
+
+    return result;
+}
+
+//----------------------------------------------------------------------------------------
+// Constructor/destructor
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function, the timers are children of the scanner so that they
+ * follow it to the thread of @c PortWatcher
+ */
+PortScanner::PortScanner(QObject *parent)
+    : QObject(parent)
+    , m_inotifyFd(-1)
+    , m_notifier(Q_NULLPTR)
+    , m_settleTimer(this)
+    , m_pollTimer(this)
+{
+    m_settleTimer.setSingleShot(true);
+    m_settleTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_settleTimer, &QTimer::timeout, this, &PortScanner::scan);
+    connect(&m_pollTimer, &QTimer::timeout, this, &PortScanner::scan);
+}
+
+/**
+ * Destructor function, releases the notification descriptor
+ */
+PortScanner::~PortScanner()
+{
+    stopNotifications();
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns @c true if the scanner is woken up by the operating system instead
+ * of polling
+ */
+bool PortScanner::eventDriven() const
+{
+    return m_notifier != Q_NULLPTR;
+}
+
+/**
+ * Returns a list with all the valid serial port objects, the call may block
+ * for a few milliseconds per device & should not be made on the GUI thread.
+ */
+QVector<QSerialPortInfo> PortScanner::enumerate()
+{
+    QVector<QSerialPortInfo> ports;
+    Q_FOREACH (QSerialPortInfo info, QSerialPortInfo::availablePorts())
+    {
+        if (!info.isNull())
+        {
+            // Only accept *.cu devices on macOS (remove *.tty)
+            // https://stackoverflow.com/a/37688347
+#ifdef Q_OS_MACOS
+            if (info.portName().toLower().startsWith("tty."))
+                continue;
+#endif
+            ports.append(info);
+        }
+    }
+
+    return ports;
+}
+
+//----------------------------------------------------------------------------------------
+// Scanning
+//----------------------------------------------------------------------------------------
+
+/**
+ * Enumerates the current ports & starts waiting for device notifications,
+ * falls back to polling if the notifications are not available.
+ */
+void PortScanner::start()
+{
+    if (!startNotifications())
+        m_pollTimer.start(POLL_INTERVAL_MS);
+
+    scan();
+}
+
+/**
+ * Stops watching for device changes
+ */
+void PortScanner::stop()
+{
+    m_settleTimer.stop();
+    m_pollTimer.stop();
+    stopNotifications();
+}
+
+/**
+ * Enumerates the serial ports & emits @c portsChanged() with the differences
+ * to the previous scan, if any.
+ */
+void PortScanner::scan()
+{
+    const QVector<QSerialPortInfo> ports = enumerate();
+    const QVector<QSerialPortInfo> added = difference(ports, m_ports);
+    const QVector<QSerialPortInfo> removed = difference(m_ports, ports);
+    if (added.isEmpty() && removed.isEmpty())
+        return;
+
+    m_ports = ports;
+    Q_EMIT portsChanged(ports, added, removed);
+}
+
+/**
+ * Drains the pending notifications & schedules a scan if any of them refers
+ * to a device that may be a serial port.
+ */
+void PortScanner::onNotification()
+{
+#ifdef Q_OS_LINUX
+    bool relevant = false;
+    alignas(struct inotify_event) char buffer[4096];
+    for (;;)
+    {
+        const ssize_t bytes = ::read(m_inotifyFd, buffer, sizeof(buffer));
+        if (bytes <= 0)
+            break;
+
+        for (ssize_t offset = 0; offset < bytes;)
+        {
+            const struct inotify_event *event
+                = reinterpret_cast<const struct inotify_event *>(buffer + offset);
+            offset += ssize_t(sizeof(struct inotify_event) + event->len);
+
+            // Overflowed queue, rescan to be safe
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                relevant = true;
+                continue;
+            }
+
+            // Character devices in /dev & their entries in the udev database
+            // (e.g. c188:0), which are written once udev has the USB identity
+            const QByteArray name(event->len > 0 ? event->name : "");
+            if (name.startsWith("tty") || name.startsWith("rfcomm")
+                || name.startsWith("c"))
+                relevant = true;
+        }
+    }
+
+    if (relevant && !m_settleTimer.isActive())
+        m_settleTimer.start(SETTLE_INTERVAL_MS);
+#endif
+}
+
+/**
+ * Starts watching the device directories, returns @c false if device
+ * notifications are not supported on this system.
+ */
+bool PortScanner::startNotifications()
+{
+#ifdef Q_OS_LINUX
+    if (m_notifier)
+        return true;
+
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0)
+        return false;
+
+    const quint32 mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+    if (inotify_add_watch(m_inotifyFd, "/dev", mask) < 0)
+    {
+        stopNotifications();
+        return false;
+    }
+
+    // Optional, only present on systems that run udev
+    inotify_add_watch(m_inotifyFd, "/run/udev/data", mask);
+
+    m_notifier = new QSocketNotifier(m_inotifyFd, QSocketNotifier::Read, this);
+    connect(m_notifier, SIGNAL(activated(int)), this, SLOT(onNotification()));
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Stops watching the device directories
+ */
+void PortScanner::stopNotifications()
+{
+    delete m_notifier;
+    m_notifier = Q_NULLPTR;
+
+#ifdef Q_OS_LINUX
+    if (m_inotifyFd >= 0)
+        ::close(m_inotifyFd);
+#endif
+
+    m_inotifyFd = -1;
+}
@@ -0,0 +1,57 @@
+#ifndef PORTSCANNER_H
+#define PORTSCANNER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include <QSerialPortInfo>
+
+class QSocketNotifier;
+
+Q_DECLARE_METATYPE(QSerialPortInfo)
+
+/**
+ * Enumerates the serial ports on the thread of @c PortWatcher whenever the
+ * operating system reports that a device node was added or removed.
+ *
+ * On Linux the scanner sleeps on an inotify descriptor watching @c /dev and
+ * the udev database, so that it costs no CPU while idle and re-enumerates a
+ * few milliseconds after a hotplug event. Elsewhere (or if inotify is not
+ * available) it falls back to polling, still off the GUI thread.
+ */
+class PortScanner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PortScanner(QObject *parent = nullptr);
+    ~PortScanner();
+
+    bool eventDriven() const;
+    static QVector<QSerialPortInfo> enumerate();
+
+Q_SIGNALS:
+    void portsChanged(const QVector<QSerialPortInfo> &ports,
+                      const QVector<QSerialPortInfo> &added,
+                      const QVector<QSerialPortInfo> &removed);
+
+public Q_SLOTS:
+    void start();
+    void stop();
+    void scan();
+
+private Q_SLOTS:
+    void onNotification();
+
+private:
+    bool startNotifications();
+    void stopNotifications();
+
+private:
+    int m_inotifyFd;
+    QSocketNotifier *m_notifier;
+    QTimer m_settleTimer;
+    QTimer m_pollTimer;
+    QVector<QSerialPortInfo> m_ports;
+};
+
+#endif // PORTSCANNER_H
@@ -0,0 +1,84 @@
+#include "portwatcher.h"
+
+//----------------------------------------------------------------------------------------
+// Constructor/destructor
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function, creates the scanner on its own thread
+ */
+PortWatcher::PortWatcher(QObject *parent)
+    : QObject(parent)
+    , m_scanner(new PortScanner)
+{
+    qRegisterMetaType<QSerialPortInfo>("QSerialPortInfo");
+    qRegisterMetaType<QVector<QSerialPortInfo>>("QVector<QSerialPortInfo>");
+
+    m_scanner->moveToThread(&m_thread);
+    connect(m_scanner, &PortScanner::portsChanged, this, &PortWatcher::portsChanged,
+            Qt::QueuedConnection);
+
+    m_thread.setObjectName("PortWatcher");
+}
+
+/**
+ * Destructor function, stops the background thread
+ */
+PortWatcher::~PortWatcher()
+{
+    stop();
+    delete m_scanner;
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns @c true if the watcher is reporting device changes
+ */
+bool PortWatcher::isRunning() const
+{
+    return m_thread.isRunning();
+}
+
+//----------------------------------------------------------------------------------------
+// Watcher control
+//----------------------------------------------------------------------------------------
+
+/**
+ * Starts watching for devices, @c portsChanged() is emitted shortly after with
+ * all the ports that are currently present.
+ */
+void PortWatcher::start()
+{
+    if (m_thread.isRunning())
+        return;
+
+    m_thread.start(QThread::LowPriority);
+    QMetaObject::invokeMethod(m_scanner, "start", Qt::QueuedConnection);
+}
+
+/**
+ * Stops watching for devices, blocks until the background thread exits
+ */
+void PortWatcher::stop()
+{
+    if (!m_thread.isRunning())
+        return;
+
+    QMetaObject::invokeMethod(
+        m_scanner, [=]() { m_scanner->stop(); }, Qt::BlockingQueuedConnection);
+
+    m_thread.quit();
+    m_thread.wait();
+}
+
+/**
+ * Enumerates the ports immediately on the background thread, e.g. after the
+ * user asked for a refresh
+ */
+void PortWatcher::rescan()
+{
+    QMetaObject::invokeMethod(m_scanner, "scan", Qt::QueuedConnection);
+}
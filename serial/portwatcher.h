@@ -0,0 +1,40 @@
+#ifndef PORTWATCHER_H
+#define PORTWATCHER_H
+
+#include <QObject>
+#include <QThread>
+#include "portscanner.h"
+
+/**
+ * Reports serial ports being plugged/unplugged without blocking the GUI
+ * thread: the ports are enumerated by a @c PortScanner on a background
+ * thread, and only when the operating system signals a device change.
+ *
+ * @c portsChanged() is delivered on the thread that the watcher lives in,
+ * with the complete list of ports & the differences to the previous list.
+ */
+class PortWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PortWatcher(QObject *parent = nullptr);
+    ~PortWatcher();
+
+    bool isRunning() const;
+
+Q_SIGNALS:
+    void portsChanged(const QVector<QSerialPortInfo> &ports,
+                      const QVector<QSerialPortInfo> &added,
+                      const QVector<QSerialPortInfo> &removed);
+
+public Q_SLOTS:
+    void start();
+    void stop();
+    void rescan();
+
+private:
+    QThread m_thread;
+    PortScanner *m_scanner;
+};
+
+#endif // PORTWATCHER_H
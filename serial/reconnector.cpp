@@ -0,0 +1,307 @@
+#include "reconnector.h"
+
+/**
+ * Delay before the first retry after a failed reopen, doubled after every
+ * failure up to @c MAX_RETRY_DELAY_MS
+ */
+static const int INITIAL_RETRY_DELAY_MS = 20;
+static const int MAX_RETRY_DELAY_MS = 1000;
+
+//----------------------------------------------------------------------------------------
+// Constructor function
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function
+ */
+Reconnector::Reconnector(QObject *parent)
+    : QObject(parent)
+    , m_state(Idle)
+    , m_attempts(0)
+    , m_retryDelay(INITIAL_RETRY_DELAY_MS)
+    , m_lastOutageMs(-1)
+    , m_hasUsbIdentifiers(false)
+    , m_vendorIdentifier(0)
+    , m_productIdentifier(0)
+    , m_enumerated(false)
+{
+    m_retryTimer.setSingleShot(true);
+    m_retryTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_retryTimer, &QTimer::timeout, this, &Reconnector::attempt);
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns the current state of the connection
+ */
+Reconnector::State Reconnector::state() const
+{
+    return m_state;
+}
+
+/**
+ * Returns the number of failed reopen attempts during the current outage
+ */
+int Reconnector::attempts() const
+{
+    return m_attempts;
+}
+
+/**
+ * Returns the duration of the current outage in milliseconds, or 0 if the
+ * device is not being reconnected
+ */
+qint64 Reconnector::outageMs() const
+{
+    if (m_state != WaitingForDevice && m_state != Reopening)
+        return 0;
+
+    return m_outage.elapsed();
+}
+
+/**
+ * Returns the duration of the last outage that ended with a reconnection, or
+ * -1 if the device was never reconnected
+ */
+qint64 Reconnector::lastOutageMs() const
+{
+    return m_lastOutageMs;
+}
+
+/**
+ * Returns the location (e.g. /dev/ttyUSB0) at which the device was last
+ * connected
+ */
+QString Reconnector::systemLocation() const
+{
+    return m_systemLocation;
+}
+
+/**
+ * Returns @c true if the connected device is still listed in @a ports. Always
+ * returns @c true for devices that are not enumerated (e.g. pseudo-terminals),
+ * since their removal cannot be observed in the port list.
+ */
+bool Reconnector::devicePresent(const QVector<QSerialPortInfo> &ports) const
+{
+    if (!m_enumerated)
+        return true;
+
+    Q_FOREACH (const QSerialPortInfo &info, ports)
+    {
+        if (info.systemLocation() == m_systemLocation)
+            return true;
+    }
+
+    return false;
+}
+
+//----------------------------------------------------------------------------------------
+// State machine
+//----------------------------------------------------------------------------------------
+
+/**
+ * Called after the port at @a systemLocation was opened, remembers the
+ * identity of its device & reports the duration of the outage if this was a
+ * reconnection.
+ */
+void Reconnector::connected(const QString &systemLocation)
+{
+    m_retryTimer.stop();
+    identify(systemLocation);
+
+    const bool reconnecting = m_state == WaitingForDevice || m_state == Reopening;
+    m_attempts = 0;
+    m_retryDelay = INITIAL_RETRY_DELAY_MS;
+    setState(Connected);
+
+    if (reconnecting)
+    {
+        m_lastOutageMs = m_outage.elapsed();
+        Q_EMIT reconnected(m_lastOutageMs);
+    }
+}
+
+/**
+ * Called after the connected device stopped responding or disappeared,
+ * starts waiting for it to come back
+ */
+void Reconnector::connectionLost()
+{
+    if (m_state != Connected)
+        return;
+
+    m_outage.start();
+    m_attempts = 0;
+    m_retryDelay = INITIAL_RETRY_DELAY_MS;
+    setState(WaitingForDevice);
+
+    // The device may still be listed if only the connection failed
+    m_retryTimer.start(0);
+}
+
+/**
+ * Called if the port at @a systemLocation could not be opened, keeps trying
+ * to open it until it succeeds. The device is identified as soon as it
+ * appears in the port list, until then it is retried by location.
+ */
+void Reconnector::waitFor(const QString &systemLocation)
+{
+    m_retryTimer.stop();
+    identify(systemLocation);
+
+    m_outage.start();
+    m_attempts = 0;
+    m_retryDelay = INITIAL_RETRY_DELAY_MS;
+    setState(WaitingForDevice);
+    m_retryTimer.start(m_retryDelay);
+}
+
+/**
+ * Called if the port could not be reopened, retries after a delay that
+ * doubles with every failure
+ */
+void Reconnector::reopenFailed()
+{
+    if (m_state != Reopening)
+        return;
+
+    ++m_attempts;
+    setState(WaitingForDevice);
+    m_retryTimer.start(m_retryDelay);
+    m_retryDelay = qMin(m_retryDelay * 2, MAX_RETRY_DELAY_MS);
+}
+
+/**
+ * Forgets the device, e.g. because the user disconnected it
+ */
+void Reconnector::stop()
+{
+    m_retryTimer.stop();
+    setState(Idle);
+}
+
+/**
+ * Updates the list of available ports, reopens the device immediately if
+ * it has just reappeared
+ */
+void Reconnector::updatePorts(const QVector<QSerialPortInfo> &ports)
+{
+    m_ports = ports;
+
+    // A device that was never opened is identified once it is listed
+    if (m_state == WaitingForDevice && !m_enumerated)
+        identify(m_systemLocation);
+
+    if (m_state == WaitingForDevice && findDevice(ports) >= 0)
+        m_retryTimer.start(0);
+}
+
+/**
+ * Asks the owner to reopen the device if it is currently listed, otherwise
+ * waits for the next port list update
+ */
+void Reconnector::attempt()
+{
+    if (m_state != WaitingForDevice)
+        return;
+
+    const int index = findDevice(m_ports);
+    if (index < 0 && m_enumerated)
+        return;
+
+    const QString location = index >= 0 ? m_ports.at(index).systemLocation()
+                                        : m_systemLocation;
+
+    setState(Reopening);
+    Q_EMIT reopenRequested(location);
+}
+
+/**
+ * Changes the state & notifies the UI
+ */
+void Reconnector::setState(const State state)
+{
+    if (m_state == state)
+        return;
+
+    m_state = state;
+    Q_EMIT stateChanged();
+}
+
+/**
+ * Remembers the identity of the device at @a systemLocation from the current
+ * port list, devices that are not listed are only known by their location
+ */
+void Reconnector::identify(const QString &systemLocation)
+{
+    m_systemLocation = systemLocation;
+    m_serialNumber.clear();
+    m_hasUsbIdentifiers = false;
+    m_vendorIdentifier = 0;
+    m_productIdentifier = 0;
+    m_enumerated = false;
+    Q_FOREACH (const QSerialPortInfo &info, m_ports)
+    {
+        if (info.systemLocation() == systemLocation)
+        {
+            m_serialNumber = info.serialNumber();
+            m_hasUsbIdentifiers = info.hasVendorIdentifier() && info.hasProductIdentifier();
+            m_vendorIdentifier = info.vendorIdentifier();
+            m_productIdentifier = info.productIdentifier();
+            m_enumerated = true;
+            break;
+        }
+    }
+}
+
+/**
+ * Returns the index of the connected device in @a ports, or -1.
+ *
+ * A USB serial number identifies the device regardless of its location. If
+ * the device has no serial number, a port with the same VID/PID is accepted
+ * at the previous location, or anywhere else if it is the only one with
+ * that VID/PID. Devices without USB identifiers are matched by location.
+ */
+int Reconnector::findDevice(const QVector<QSerialPortInfo> &ports) const
+{
+    if (!m_enumerated)
+        return -1;
+
+    int candidate = -1;
+    int candidates = 0;
+    for (int i = 0; i < ports.count(); ++i)
+    {
+        const QSerialPortInfo &info = ports.at(i);
+        if (!m_hasUsbIdentifiers)
+        {
+            if (info.systemLocation() == m_systemLocation)
+                return i;
+
+            continue;
+        }
+
+        if (info.vendorIdentifier() != m_vendorIdentifier
+            || info.productIdentifier() != m_productIdentifier)
+            continue;
+
+        if (!m_serialNumber.isEmpty())
+        {
+            if (info.serialNumber() == m_serialNumber)
+                return i;
+
+            continue;
+        }
+
+        if (info.systemLocation() == m_systemLocation)
+            return i;
+
+        candidate = i;
+        ++candidates;
+    }
+
+    return candidates == 1 ? candidate : -1;
+}
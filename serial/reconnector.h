@@ -0,0 +1,84 @@
+#ifndef RECONNECTOR_H
+#define RECONNECTOR_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QSerialPortInfo>
+
+/**
+ * Follows the device behind the current connection across USB glitches &
+ * replugs.
+ *
+ * The device is identified by its USB serial number (or VID/PID if it has
+ * none), so that it is found again even if the operating system assigns it
+ * a different port name. Once the connection is lost the reconnector waits
+ * for the device to reappear in the port list & asks its owner to reopen
+ * it, retrying with a bounded exponential backoff while the device is not
+ * ready (e.g. udev has not applied the permissions yet).
+ *
+ * @c waitFor() does the same for a device that could not be opened in the
+ * first place, e.g. because it has not been enumerated yet at startup.
+ */
+class Reconnector : public QObject
+{
+    Q_OBJECT
+public:
+    enum State
+    {
+        Idle,
+        Connected,
+        WaitingForDevice,
+        Reopening,
+    };
+
+    explicit Reconnector(QObject *parent = nullptr);
+
+    State state() const;
+    int attempts() const;
+    qint64 outageMs() const;
+    qint64 lastOutageMs() const;
+    QString systemLocation() const;
+    bool devicePresent(const QVector<QSerialPortInfo> &ports) const;
+
+Q_SIGNALS:
+    void stateChanged();
+    void reopenRequested(const QString &systemLocation);
+    void reconnected(const qint64 outageMs);
+
+public Q_SLOTS:
+    void connected(const QString &systemLocation);
+    void connectionLost();
+    void waitFor(const QString &systemLocation);
+    void reopenFailed();
+    void stop();
+    void updatePorts(const QVector<QSerialPortInfo> &ports);
+
+private Q_SLOTS:
+    void attempt();
+
+private:
+    void setState(const State state);
+    void identify(const QString &systemLocation);
+    int findDevice(const QVector<QSerialPortInfo> &ports) const;
+
+private:
+    State m_state;
+    int m_attempts;
+    int m_retryDelay;
+    qint64 m_lastOutageMs;
+    QTimer m_retryTimer;
+    QElapsedTimer m_outage;
+    QVector<QSerialPortInfo> m_ports;
+
+    // Identity of the device
+    QString m_systemLocation;
+    QString m_serialNumber;
+    bool m_hasUsbIdentifiers;
+    quint16 m_vendorIdentifier;
+    quint16 m_productIdentifier;
+    bool m_enumerated;
+};
+
+#endif // RECONNECTOR_H
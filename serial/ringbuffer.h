@@ -0,0 +1,244 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Fixed-capacity byte ring buffer for one producer thread and one consumer
+ * thread. The capacity is always a power of two, the producer reads straight
+ * into the free region returned by @c writeSpan() and the consumer parses the
+ * stored bytes in place through @c readSpans(), so no heap allocation happens
+ * on the receive path.
+ *
+ * The head/tail positions are free-running counters, the buffer offset is
+ * obtained by masking them with @c capacity() - 1.
+ */
+class RingBuffer
+{
+public:
+    struct Span
+    {
+        const char *data;
+        size_t size;
+    };
+
+    struct MutableSpan
+    {
+        char *data;
+        size_t size;
+    };
+
+    explicit RingBuffer(size_t capacity)
+        : m_capacity(0)
+        , m_mask(0)
+        , m_head(0)
+        , m_tail(0)
+        , m_highWaterMark(0)
+        , m_overflowBytes(0)
+        , m_overflowEvents(0)
+    {
+        reset(capacity);
+    }
+
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    /**
+     * Reallocates the buffer with at least @a capacity bytes (rounded up to
+     * the next power of two) & clears the statistics.
+     *
+     * @warning Not thread-safe, neither the producer nor the consumer may be
+     *          active while the buffer is being reset.
+     */
+    void reset(size_t capacity)
+    {
+        size_t size = 64;
+        while (size < capacity)
+            size <<= 1;
+
+        if (size != m_capacity)
+        {
+            m_data.reset(new char[size]);
+            m_capacity = size;
+            m_mask = size - 1;
+        }
+
+        m_head.store(0);
+        m_tail.store(0);
+        resetStatistics();
+    }
+
+    size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+    size_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire)
+               - m_head.load(std::memory_order_acquire);
+    }
+
+    size_t freeSpace() const
+    {
+        return m_capacity - size();
+    }
+
+    bool isEmpty() const
+    {
+        return size() == 0;
+    }
+
+    //------------------------------------------------------------------------------------
+    // Producer side
+    //------------------------------------------------------------------------------------
+
+    /**
+     * Returns the largest contiguous free region, the producer fills it and
+     * then publishes the bytes with @c commit().
+     */
+    MutableSpan writeSpan()
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t used = tail - m_head.load(std::memory_order_acquire);
+        const size_t offset = tail & m_mask;
+
+        MutableSpan span;
+        span.data = m_data.get() + offset;
+        span.size = minSize(m_capacity - used, m_capacity - offset);
+        return span;
+    }
+
+    /**
+     * Publishes @a bytes written into the region returned by @c writeSpan()
+     */
+    void commit(size_t bytes)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed) + bytes;
+        m_tail.store(tail, std::memory_order_release);
+
+        const size_t used = tail - m_head.load(std::memory_order_acquire);
+        if (used > m_highWaterMark.load(std::memory_order_relaxed))
+            m_highWaterMark.store(used, std::memory_order_relaxed);
+    }
+
+    /**
+     * Copies up to @a size bytes into the buffer, bytes that do not fit are
+     * discarded & accounted as overflow. Returns the number of bytes stored.
+     */
+    size_t write(const char *data, size_t size)
+    {
+        size_t written = 0;
+        while (written < size)
+        {
+            MutableSpan span = writeSpan();
+            if (span.size == 0)
+                break;
+
+            const size_t bytes = minSize(span.size, size - written);
+            std::memcpy(span.data, data + written, bytes);
+            commit(bytes);
+            written += bytes;
+        }
+
+        if (written < size)
+            recordOverflow(size - written);
+
+        return written;
+    }
+
+    /**
+     * Registers @a bytes that the producer had to discard because the buffer
+     * was full.
+     */
+    void recordOverflow(size_t bytes)
+    {
+        m_overflowBytes.fetch_add(bytes, std::memory_order_relaxed);
+        m_overflowEvents.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    //------------------------------------------------------------------------------------
+    // Consumer side
+    //------------------------------------------------------------------------------------
+
+    /**
+     * Returns the stored bytes as (at most) two contiguous regions, @a second
+     * is empty unless the data wraps around the end of the buffer. Returns the
+     * total number of readable bytes.
+     */
+    size_t readSpans(Span &first, Span &second) const
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t used = m_tail.load(std::memory_order_acquire) - head;
+        const size_t offset = head & m_mask;
+        const size_t firstSize = minSize(used, m_capacity - offset);
+
+        first.data = m_data.get() + offset;
+        first.size = firstSize;
+        second.data = m_data.get();
+        second.size = used - firstSize;
+        return used;
+    }
+
+    /**
+     * Releases @a bytes from the front of the buffer
+     */
+    void consume(size_t bytes)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        m_head.store(head + bytes, std::memory_order_release);
+    }
+
+    //------------------------------------------------------------------------------------
+    // Statistics
+    //------------------------------------------------------------------------------------
+
+    size_t highWaterMark() const
+    {
+        return m_highWaterMark.load(std::memory_order_relaxed);
+    }
+
+    uint64_t overflowBytes() const
+    {
+        return m_overflowBytes.load(std::memory_order_relaxed);
+    }
+
+    uint64_t overflowEvents() const
+    {
+        return m_overflowEvents.load(std::memory_order_relaxed);
+    }
+
+    void resetStatistics()
+    {
+        m_highWaterMark.store(0);
+        m_overflowBytes.store(0);
+        m_overflowEvents.store(0);
+    }
+
+private:
+    static size_t minSize(size_t a, size_t b)
+    {
+        return a < b ? a : b;
+    }
+
+private:
+    std::unique_ptr<char[]> m_data;
+    size_t m_capacity;
+    size_t m_mask;
+
+    char m_pad0[64];
+    std::atomic<size_t> m_head;
+    char m_pad1[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_tail;
+    char m_pad2[64 - sizeof(std::atomic<size_t>)];
+
+    std::atomic<size_t> m_highWaterMark;
+    std::atomic<uint64_t> m_overflowBytes;
+    std::atomic<uint64_t> m_overflowEvents;
+};
+
+#endif // RINGBUFFER_H
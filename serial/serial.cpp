@@ -1,6 +1,34 @@
 #include "serial.h"
-#include "utilities.h"
+#ifndef QSERIALTOOL_HEADLESS
+#    include "Utilities.h"
+#endif
+#include "HexDump.h"
 #include <QDebug>
+#include <QMetaMethod>
+
+/**
+ * Default capacity of the receive ring buffer, roughly 5 seconds of data at
+ * 2 Mbaud.
+ */
+static const quint32 DEFAULT_RX_BUFFER_SIZE = 1024 * 1024;
+
+/**
+ * Returns the port name (e.g. ttyUSB0) of the device at @a systemLocation,
+ * following the same convention as @c QSerialPort::portName()
+ */
+static QString portNameFromLocation(const QString &systemLocation)
+{
+#ifdef Q_OS_WIN
+    static const QString prefix = QStringLiteral("\\\\.\\");
+#else
+    static const QString prefix = QStringLiteral("/dev/");
+#endif
+
+    if (systemLocation.startsWith(prefix))
+        return systemLocation.mid(prefix.size());
+
+    return systemLocation;
+}
 //----------------------------------------------------------------------------------------
 // Constructor/destructor & singleton access functions
 //----------------------------------------------------------------------------------------
@@ -11,9 +39,23 @@
 Serial::Serial(QObject *parent) : QObject(parent)
     , m_port(Q_NULLPTR)
     , m_autoReconnect(false)
+    , m_openMode(QIODevice::NotOpen)
     , m_lastSerialDeviceIndex(0)
+    , m_ioThreadEnabled(true)
+    , m_channel(Q_NULLPTR)
+    , m_captureWriter(Q_NULLPTR)
+    , m_counters(Misc::Instrumentation::instance().port(0))
+    , m_writeQueue(m_counters)
+    , m_receiveBufferSize(DEFAULT_RX_BUFFER_SIZE)
+    , m_discardBuffer(4 * 1024, Qt::Uninitialized)
+    , m_rxBuffer(DEFAULT_RX_BUFFER_SIZE)
     , m_portIndex(0)
+    , m_displayMode(Misc::HexDump::Ascii)
+    , m_portListReady(false)
 {
+    // Construct the port manager first, so that it outlives this singleton
+    PortManager::instance();
+
     // Read settings
     readSettings();
 
@@ -24,18 +66,27 @@ Serial::Serial(QObject *parent) : QObject(parent)
     setStopBits(stopBitsList().indexOf("1"));
     setParity(parityList().indexOf(tr("None")));
     setFlowControl(flowControlList().indexOf(tr("None")));
-    refreshSerialDevices();
-    if(portList().count()>1)
-    {
-        setPortIndex(1);
-    }
 
     // clang-format off
 
-   //  Build serial devices list and refresh it every second
-    connect(&m_timerFreshPorts, &QTimer::timeout,
-            this, &Serial::refreshSerialDevices);
-    m_timerFreshPorts.start(1000);
+   //  Build serial devices list on the watcher's thread (so that the
+   //  enumeration does not delay the startup) and refresh it when devices
+   //  are plugged/unplugged
+    connect(&m_portWatcher, &PortWatcher::portsChanged,
+            this, &Serial::onPortsChanged);
+    m_portWatcher.start();
+
+    // Reopen the device after it was replugged
+    connect(&m_reconnector, &Reconnector::reopenRequested,
+            this, &Serial::onReopenRequested);
+    connect(&m_reconnector, &Reconnector::reconnected,
+            this, &Serial::reconnected);
+    connect(&m_reconnector, &Reconnector::stateChanged,
+            this, &Serial::reconnectStateChanged);
+
+    // Report the outcome of the messages written without I/O thread
+    connect(&m_writeQueue, &WriteQueue::completed,
+            this, &Serial::onWriteCompleted);
     // Update connect button status when user selects serial device
 //    connect(this, &Serial::portIndexChanged,
 //            this, &Serial::configurationChanged);
@@ -51,7 +102,7 @@ Serial::~Serial()
 {
     writeSettings();
 
-    if (port())
+    if (port() || m_channel)
         disconnectDevice();
 }
 
@@ -85,6 +136,9 @@ bool Serial::isOpen() const
     if (port())
         return port()->isOpen();
 
+    if (m_channel)
+        return m_channel->isOpen();
+
     return false;
 }
 
@@ -93,8 +147,11 @@ bool Serial::isOpen() const
  */
 bool Serial::isReadable() const
 {
-    if (isOpen())
-        return port()->isReadable();
+    if (port())
+        return port()->isOpen() && port()->isReadable();
+
+    if (m_channel)
+        return m_channel->isReadable();
 
     return false;
 }
@@ -104,8 +161,11 @@ bool Serial::isReadable() const
  */
 bool Serial::isWritable() const
 {
-    if (isOpen())
-        return port()->isWritable();
+    if (port())
+        return port()->isOpen() && port()->isWritable();
+
+    if (m_channel)
+        return m_channel->isWritable();
 
     return false;
 }
@@ -120,14 +180,86 @@ bool Serial::configurationOk() const
 }
 
 /**
- * Writes the given @a data to the serial device and returns the number of bytes written
+ * Queues the given @a data for transmission with normal priority, returns the
+ * number of bytes queued or -1 if the device is not writable or its transmit
+ * queue is full
+ */
+qint64 Serial::write(const QByteArray &data)
+{
+    return send(data) != 0 ? data.size() : -1;
+}
+
+/**
+ * Queues @a data for transmission & returns the ID of the message, or 0 if
+ * the device is not writable or its transmit queue is full.
+ *
+ * Messages are sent in @a priority order (e.g. an emergency command
+ * overtakes queued polls), a queued message is superseded by a newer one
+ * with the same non-zero @a coalesceKey. The call never blocks, even if
+ * hardware flow control holds the line: the data waits in the queue until
+ * the port reports that its buffer has drained.
+ *
+ * @a callback (if any) is called exactly once on this thread, when the
+ * message was written to the driver or could not be sent. It is also called
+ * (with @c WriteQueue::Dropped or @c WriteQueue::Failed) if this function
+ * returns 0. @c writeCompleted() is emitted for every message.
  */
-quint64 Serial::write(const QByteArray &data)
+quint64 Serial::send(const QByteArray &data, const WriteQueue::Priority priority,
+                     const quint32 coalesceKey, const WriteCallback &callback)
 {
-    if (isWritable())
-        return port()->write(data);
+    if (!isWritable())
+    {
+        if (callback)
+            callback(WriteQueue::Failed);
 
-    return -1;
+        return 0;
+    }
+
+    // Hand the data to the I/O thread, completions arrive queued
+    if (m_channel)
+    {
+        const quint64 id = m_channel->write(data, priority, coalesceKey);
+        if (id == 0)
+        {
+            if (callback)
+                callback(WriteQueue::Dropped);
+
+            return 0;
+        }
+
+        m_writeCallbacks.insert(id, callback);
+        return id;
+    }
+
+    if (Misc::Instrumentation::enabled())
+        m_counters->recordWrite(quint64(data.size()), quint64(m_writeQueue.pendingRequests()));
+
+    // The queue may complete the message before returning
+    WriteQueue::Request request;
+    request.id = WriteQueue::nextId();
+    request.data = data;
+    request.priority = priority;
+    request.coalesceKey = coalesceKey;
+    m_writeCallbacks.insert(request.id, callback);
+
+    return m_writeQueue.enqueue(request) ? request.id : 0;
+}
+
+/**
+ * Hands previously recorded @a data to the consumers exactly as if it had
+ * just been received from the serial port
+ */
+void Serial::replayData(const char *data, const int size)
+{
+    if (size <= 0)
+        return;
+
+    RingBuffer::Span first, second;
+    first.data = data;
+    first.size = size_t(size);
+    second.data = data + size;
+    second.size = 0;
+    forwardData(first, second);
 }
 
 /**
@@ -135,41 +267,103 @@ quint64 Serial::write(const QByteArray &data)
  */
 bool Serial::open(const QIODevice::OpenMode mode)
 {
+    // The port watcher has not listed the devices yet
+    if (!m_portListReady)
+        refreshSerialDevices();
+
     // Ignore the first item of the list (Select Port)
     auto ports = validPorts();
     auto portId = portIndex();
-    if (portId >= 0 && portId < validPorts().count())
+    if (portId >= 0 && portId < ports.count())
     {
-        // Update port index variable & disconnect from current serial port
-        disconnectDevice();
+        // Update port index variable
         m_lastSerialDeviceIndex = m_portIndex;
         Q_EMIT portIndexChanged();
 
-        // Create new serial port handler
-        m_port = new QSerialPort(ports.at(portId));
+        return open(ports.at(portId).systemLocation(), mode);
+    }
 
-        // Configure serial port
-        port()->setParity(parity());
-        port()->setBaudRate(baudRate());
-        port()->setDataBits(dataBits());
-        port()->setStopBits(stopBits());
-        port()->setFlowControl(flowControl());
+    // Disconnect serial port
+    disconnectDevice();
+    return false;
+}
+
+/**
+ * Connects to the device at @a systemLocation (e.g. /dev/ttyUSB0) with the
+ * current serial configuration, including devices that are not enumerated by
+ * @c QSerialPortInfo such as pseudo-terminals. Returns @c true on success.
+ */
+bool Serial::open(const QString &systemLocation, const QIODevice::OpenMode mode)
+{
+    // Forget the previous device unless this is an attempt to reconnect it
+    if (m_reconnector.state() != Reconnector::Reopening)
+        m_reconnector.stop();
 
-        // Connect signals/slots
-        connect(port(), SIGNAL(errorOccurred(QSerialPort::SerialPortError)), this,
-                SLOT(handleError(QSerialPort::SerialPortError)));
+    // Disconnect from current serial port
+    closeDevice();
 
-        // Open device
-        if (port()->open(mode))
+    // Nobody is reading/writing the receive buffer at this point
+    m_rxBuffer.reset(receiveBufferSize());
+
+    // Let the port manager run the serial port on its own I/O thread, the
+    // data of the current port is still handed out on the GUI thread
+    if (ioThreadEnabled())
+    {
+        const auto config = configuration(systemLocation, mode);
+        m_channel = PortManager::instance().open(config, receiveBufferSize(),
+                                                 PortManager::CallerThread);
+
+        if (m_channel)
         {
-            connect(port(), &QIODevice::readyRead, this,
-                    &Serial::onReadyRead);
+            m_channel->setCaptureWriter(m_captureWriter);
+            connect(m_channel, &SerialChannel::dataAvailable, this,
+                    &Serial::forwardData, Qt::DirectConnection);
+            connect(m_channel, &SerialChannel::errorOccurred, this,
+                    &Serial::handleError);
+            connect(m_channel, &SerialChannel::writeCompleted, this,
+                    &Serial::onWriteCompleted);
+
+            m_portName = portNameFromLocation(systemLocation);
+            m_openMode = mode;
+            m_reconnector.connected(systemLocation);
+            Q_EMIT portChanged();
             return true;
         }
+
+        closeDevice();
+        return false;
+    }
+
+    // Create new serial port handler
+    m_port = new QSerialPort();
+    port()->setPortName(systemLocation);
+
+    // Configure serial port
+    port()->setParity(parity());
+    port()->setBaudRate(baudRate());
+    port()->setDataBits(dataBits());
+    port()->setStopBits(stopBits());
+    port()->setFlowControl(flowControl());
+
+    // Connect signals/slots
+    connect(port(), SIGNAL(errorOccurred(QSerialPort::SerialPortError)), this,
+            SLOT(handleError(QSerialPort::SerialPortError)));
+
+    // Open device
+    Misc::Instrumentation::instance().openPort(m_counters, systemLocation);
+    if (port()->open(mode))
+    {
+        connect(port(), &QIODevice::readyRead, this,
+                &Serial::onReadyRead);
+        m_writeQueue.setHighWaterMark(WriteQueue::highWaterMarkFor(baudRate()));
+        m_writeQueue.setPort(port());
+        m_openMode = mode;
+        m_reconnector.connected(systemLocation);
+        return true;
     }
 
     // Disconnect serial port
-    disconnectDevice();
+    closeDevice();
     return false;
 }
 
@@ -185,6 +379,9 @@ QString Serial::portName() const
     if (port())
         return port()->portName();
 
+    if (m_channel && m_channel->isOpen())
+        return m_portName;
+
     return tr("No Device");
 }
 
@@ -204,6 +401,61 @@ bool Serial::autoReconnect() const
     return m_autoReconnect;
 }
 
+/**
+ * Returns @c true if the serial port is operated from a dedicated I/O thread
+ */
+bool Serial::ioThreadEnabled() const
+{
+    return m_ioThreadEnabled;
+}
+
+/**
+ * Returns the number of received bytes that were discarded because the
+ * receive buffer was full.
+ */
+quint64 Serial::droppedBytes() const
+{
+    return receiveBuffer().overflowBytes();
+}
+
+/**
+ * Returns the requested capacity (in bytes) of the receive ring buffer
+ */
+quint32 Serial::receiveBufferSize() const
+{
+    return m_receiveBufferSize;
+}
+
+/**
+ * Returns the receive ring buffer, which can be used to query the high-water
+ * mark & overflow counters of the current connection.
+ */
+const RingBuffer &Serial::receiveBuffer() const
+{
+    if (m_channel)
+        return m_channel->receiveBuffer();
+
+    return m_rxBuffer;
+}
+
+/**
+ * Returns the capture file writer that records the traffic of the current
+ * port, or @c Q_NULLPTR if nothing is being recorded
+ */
+CaptureWriter *Serial::captureWriter() const
+{
+    return m_captureWriter;
+}
+
+/**
+ * Returns the auto-reconnect state machine of the current device, which
+ * reports the state & the duration of the outages
+ */
+const Reconnector &Serial::reconnector() const
+{
+    return m_reconnector;
+}
+
 /**
  * Returns the index of the current serial device selected by the program.
  */
@@ -221,6 +473,15 @@ quint8 Serial::parityIndex() const
     return m_parityIndex;
 }
 
+/**
+ * Returns the index of the display mode used for received data, in relation
+ * to the @c StringList returned by the @c displayModeList() function.
+ */
+quint8 Serial::displayMode() const
+{
+    return m_displayMode;
+}
+
 /**
  * Returns the correspoding index of the data bits configuration in relation
  * to the @c StringList returned by the @c dataBitsList() function.
@@ -317,6 +578,15 @@ QStringList Serial::flowControlList() const
     return list;
 }
 
+/**
+ * Returns a list with the available display modes (ASCII, hex & hex+ASCII).
+ * This function can be used with a combo-box to build UIs.
+ */
+QStringList Serial::displayModeList() const
+{
+    return Misc::HexDump::modeList();
+}
+
 /**
  * Returns the current parity configuration used by the serial port
  * handler object.
@@ -366,20 +636,48 @@ bool Serial::connectDevice()
 {
     if(port() == Q_NULLPTR)
     {
-        if(!open(QIODevice::ReadOnly))
+        if(!open(QIODevice::ReadWrite))
         {
             qDebug()<<"open serial error!"<<endl;
             return false;
         }
         return true;
     }
+
+    return isOpen();
+}
+
+/**
+ * Opens the device at @a systemLocation as soon as possible, e.g. after a
+ * failed @c open() because the device has not been enumerated yet. The
+ * reconnector retries with a bounded backoff & immediately once the device
+ * is listed, @c reconnected() is emitted when it succeeds.
+ */
+void Serial::waitForDevice(const QString &systemLocation, const QIODevice::OpenMode mode)
+{
+    closeDevice();
+    m_openMode = mode;
+    m_reconnector.waitFor(systemLocation);
 }
 
 /**
- * Disconnects from the current serial device and clears temp. data
+ * Disconnects from the current serial device, the device is not reconnected
+ * automatically anymore
  */
 void Serial::disconnectDevice()
 {
+    m_reconnector.stop();
+    closeDevice();
+}
+
+/**
+ * Closes the current serial device and clears temp. data
+ */
+void Serial::closeDevice()
+{
+    // Fail the messages that were not written yet
+    m_writeQueue.setPort(Q_NULLPTR);
+
     // Check if serial port pointer is valid
     if (port() != Q_NULLPTR)
     {
@@ -390,8 +688,22 @@ void Serial::disconnectDevice()
         // Close & delete serial port handler
         port()->close();
         port()->deleteLater();
+        Misc::Instrumentation::instance().closePort(m_counters);
+    }
+
+    // Close the serial port owned by the I/O thread
+    if (m_channel != Q_NULLPTR)
+    {
+        m_channel->disconnect(this);
+        PortManager::instance().close(m_channel);
+        m_channel = Q_NULLPTR;
     }
 
+    // The completions of the I/O thread are no longer delivered
+    const QList<quint64> pendingWrites = m_writeCallbacks.keys();
+    Q_FOREACH (const quint64 id, pendingWrites)
+        onWriteCompleted(id, WriteQueue::Failed);
+
     // Reset pointer
     m_port = Q_NULLPTR;
     Q_EMIT portChanged();
@@ -411,7 +723,12 @@ void Serial::setBaudRate(const qint32 rate)
 
     // Update serial port config
     if (port())
+    {
         port()->setBaudRate(baudRate());
+        m_writeQueue.setHighWaterMark(WriteQueue::highWaterMarkFor(baudRate()));
+    }
+    else
+        updateChannelConfiguration();
 
     // Update user interface
     Q_EMIT baudRateChanged();
@@ -467,6 +784,8 @@ void Serial::setParity(const quint8 parityIndex)
     // Update serial port config.
     if (port())
         port()->setParity(parity());
+    else
+        updateChannelConfiguration();
 
     // Notify user interface
     Q_EMIT parityChanged();
@@ -482,9 +801,11 @@ void Serial::appendBaudRate(const QString &baudRate)
         m_baudRateList.append(baudRate);
         writeSettings();
         Q_EMIT baudRateListChanged();
+#ifndef QSERIALTOOL_HEADLESS
         Misc::Utilities::showMessageBox(
             tr("Baud rate registered successfully"),
             tr("Rate \"%1\" has been added to baud rate list").arg(baudRate));
+#endif
     }
 }
 
@@ -522,6 +843,8 @@ void Serial::setDataBits(const quint8 dataBitsIndex)
     // Update serial port configuration
     if (port())
         port()->setDataBits(dataBits());
+    else
+        updateChannelConfiguration();
 
     // Update user interface
     Q_EMIT dataBitsChanged();
@@ -558,6 +881,8 @@ void Serial::setStopBits(const quint8 stopBitsIndex)
     // Update serial port configuration
     if (port())
         port()->setStopBits(stopBits());
+    else
+        updateChannelConfiguration();
 
     // Update user interface
     Q_EMIT stopBitsChanged();
@@ -568,10 +893,40 @@ void Serial::setStopBits(const quint8 stopBitsIndex)
  */
 void Serial::setAutoReconnect(const bool autoreconnect)
 {
+    // Give up on the device that is currently being reconnected
+    if (!autoreconnect && m_reconnector.state() != Reconnector::Connected)
+        m_reconnector.stop();
+
     m_autoReconnect = autoreconnect;
     Q_EMIT autoReconnectChanged();
 }
 
+/**
+ * Changes the capacity of the receive ring buffer, the value is rounded up to
+ * the next power of two & applied the next time that a serial port is opened.
+ */
+void Serial::setReceiveBufferSize(const quint32 bytes)
+{
+    if (m_receiveBufferSize != bytes)
+    {
+        m_receiveBufferSize = bytes;
+        Q_EMIT receiveBufferSizeChanged();
+    }
+}
+
+/**
+ * Enables or disables the dedicated I/O thread, the change is applied the
+ * next time that a serial port is opened.
+ */
+void Serial::setIoThreadEnabled(const bool enabled)
+{
+    if (m_ioThreadEnabled != enabled)
+    {
+        m_ioThreadEnabled = enabled;
+        Q_EMIT ioThreadEnabledChanged();
+    }
+}
+
 /**
  * Changes the flow control option of the serial port.
  *
@@ -603,24 +958,129 @@ void Serial::setFlowControl(const quint8 flowControlIndex)
     // Update serial port configuration
     if (port())
         port()->setFlowControl(flowControl());
+    else
+        updateChannelConfiguration();
 
     // Update user interface
     Q_EMIT flowControlChanged();
 }
 
+/**
+ * Changes the way in which received data is displayed, the views re-render
+ * the data they retain without reading it again.
+ */
+void Serial::setDisplayMode(const quint8 displayMode)
+{
+    // Argument verification
+    Q_ASSERT(displayMode < displayModeList().count());
+
+    if (m_displayMode != displayMode)
+    {
+        m_displayMode = displayMode;
+        Q_EMIT displayModeChanged();
+    }
+}
+
+/**
+ * Records the traffic of the current port (and of the ports opened later)
+ * with @a writer, or stops recording if @a writer is @c Q_NULLPTR
+ */
+void Serial::setCaptureWriter(CaptureWriter *writer)
+{
+    m_captureWriter = writer;
+    m_writeQueue.setCaptureWriter(writer, 0);
+    if (m_channel)
+        m_channel->setCaptureWriter(writer);
+}
+
 /**
  * Scans for new serial ports available & generates a StringList with current
- * serial ports.
+ * serial ports. Blocks the calling thread during the enumeration, only used
+ * if a port is opened before the port watcher has listed the devices.
  */
 void Serial::refreshSerialDevices()
 {
+    updatePortList(PortScanner::enumerate());
+    m_reconnector.updatePorts(m_validPorts);
+}
+
+/**
+ * Called by the port watcher (on the GUI thread) after a device was plugged
+ * or unplugged, @a ports is the complete list of serial ports.
+ */
+void Serial::onPortsChanged(const QVector<QSerialPortInfo> &ports,
+                            const QVector<QSerialPortInfo> &added,
+                            const QVector<QSerialPortInfo> &removed)
+{
+    Q_UNUSED(added);
+
+    updatePortList(ports);
+    m_reconnector.updatePorts(ports);
+
+    // The device was unplugged, the I/O error may not have been reported yet
+    if (!removed.isEmpty() && m_reconnector.state() == Reconnector::Connected
+        && !m_reconnector.devicePresent(ports))
+        onConnectionLost();
+}
+
+/**
+ * Closes the port after its device stopped responding or was unplugged &
+ * starts reconnecting if auto-reconnect is enabled
+ */
+void Serial::onConnectionLost()
+{
+    const QString name = portName();
+    closeDevice();
+
+    if (autoReconnect())
+        m_reconnector.connectionLost();
+    else
+        m_reconnector.stop();
+
+    Q_EMIT connectionError(name);
+}
+
+/**
+ * Reopens the replugged device at @a systemLocation with the previous
+ * configuration
+ */
+void Serial::onReopenRequested(const QString &systemLocation)
+{
+    if (!open(systemLocation, m_openMode))
+    {
+        m_reconnector.reopenFailed();
+        return;
+    }
+
+    // The device may have been assigned a different port name
+    for (int i = 0; i < m_validPorts.count(); ++i)
+    {
+        if (m_validPorts.at(i).systemLocation() == systemLocation)
+        {
+            m_portIndex = quint8(i + 1);
+            Q_EMIT portIndexChanged();
+            break;
+        }
+    }
+}
+
+/**
+ * Replaces the list of serial ports with @a validPortList & updates the UI
+ * if ports were added or removed
+ */
+void Serial::updatePortList(const QVector<QSerialPortInfo> &validPortList)
+{
+    // Select the first device once the initial list is available
+    const bool initialList = !m_portListReady;
+    m_portListReady = true;
+
     // Create device list, starting with dummy header
     // (for a more friendly UI when no devices are attached)
     //QStringList ports;
     QMap<QString, QSerialPortInfo>ports;
 
     // Search for available ports and add them to the lsit
-    auto validPortList = validPorts();
+    m_validPorts = validPortList;
     Q_FOREACH (QSerialPortInfo info, validPortList)
     {
         if (!info.isNull())
@@ -634,9 +1094,9 @@ void Serial::refreshSerialDevices()
         m_portList = ports;
         qDebug()<<m_portList.keys();
         // Update current port index
-        if (port())
+        if (isOpen())
         {
-            auto name = port()->portName();
+            auto name = portName();
             for (int i = 0; i < validPortList.count(); ++i)
             {
                 auto info = validPortList.at(i);
@@ -648,22 +1108,17 @@ void Serial::refreshSerialDevices()
             }
         }
 
-//        // Auto reconnect
-//        if (Manager::instance().selectedDriver() == Manager::SelectedDriver::Serial)
-//        {
-//            if (autoReconnect() && m_lastSerialDeviceIndex > 0)
-//            {
-//                if (m_lastSerialDeviceIndex < portList().count())
-//                {
-//                    setPortIndex(m_lastSerialDeviceIndex);
-//                    Manager::instance().connectDevice();
-//                }
-//            }
-//        }
-
         // Update UI
         Q_EMIT availablePortsChanged();
     }
+    else
+    {
+        // Same devices, the USB identity of a new device may have changed
+        m_portList = ports;
+    }
+
+    if (initialList && !isOpen() && portList().count() > 1)
+        setPortIndex(1);
 }
 
 /**
@@ -674,17 +1129,54 @@ void Serial::handleError(QSerialPort::SerialPortError error)
 {
     if (error != QSerialPort::NoError)
     {
+        Misc::Instrumentation::Port *counters = m_channel ? m_channel->counters() : m_counters;
+        counters->errors.fetch_add(1, std::memory_order_relaxed);
+
+        // The device was unplugged or stopped responding
+        if (error == QSerialPort::ResourceError
+            && m_reconnector.state() == Reconnector::Connected)
+            onConnectionLost();
     }
      //   Manager::instance().disconnectDriver();
 }
 
 /**
- * Reads all the data from the serial port & sends it to the @c IO::Manager class
+ * Calls the completion callback of the message @a id (if any) & notifies the
+ * other observers. Messages that were already completed (e.g. failed when
+ * the device was closed) are ignored.
+ */
+void Serial::onWriteCompleted(const quint64 id, const WriteQueue::Status status)
+{
+    const auto it = m_writeCallbacks.find(id);
+    if (it == m_writeCallbacks.end())
+        return;
+
+    const WriteCallback callback = it.value();
+    m_writeCallbacks.erase(it);
+    if (callback)
+        callback(status);
+
+    Q_EMIT writeCompleted(id, status);
+}
+
+/**
+ * Reads all the data from the serial port into the receive buffer & notifies
+ * the consumers
  */
 void Serial::onReadyRead()
 {
     if (isOpen())
-        Q_EMIT dataReceived(port()->readAll());
+    {
+        const bool instrumented = Misc::Instrumentation::enabled();
+        if (instrumented)
+            m_counters->markRead(Misc::Instrumentation::timestampNs());
+
+        const qint64 bytes = SerialWorker::readAvailable(port(), &m_rxBuffer, m_discardBuffer);
+        if (instrumented)
+            m_counters->recordChunk(quint64(bytes));
+
+        drainReceiveBuffer();
+    }
 }
 
 /**
@@ -721,6 +1213,16 @@ void Serial::readSettings()
     }
 #endif
 
+    // Get I/O thread & receive buffer settings
+    m_ioThreadEnabled = m_settings.value("IO_DataSource_Serial__IoThread", true).toBool();
+    m_autoReconnect = m_settings.value("IO_DataSource_Serial__AutoReconnect", false).toBool();
+    m_receiveBufferSize = m_settings.value("IO_DataSource_Serial__RxBufferSize",
+                                           DEFAULT_RX_BUFFER_SIZE).toUInt();
+    m_displayMode = quint8(m_settings.value("IO_DataSource_Serial__DisplayMode",
+                                            Misc::HexDump::Ascii).toUInt());
+    if (m_displayMode >= displayModeList().count())
+        m_displayMode = Misc::HexDump::Ascii;
+
     // Notify UI
     Q_EMIT baudRateListChanged();
 }
@@ -754,32 +1256,94 @@ void Serial::writeSettings()
 
     // Save list to memory
     m_settings.setValue("IO_DataSource_Serial__BaudRates", list);
+    m_settings.setValue("IO_DataSource_Serial__IoThread", m_ioThreadEnabled);
+    m_settings.setValue("IO_DataSource_Serial__AutoReconnect", m_autoReconnect);
+    m_settings.setValue("IO_DataSource_Serial__RxBufferSize", m_receiveBufferSize);
+    m_settings.setValue("IO_DataSource_Serial__DisplayMode", m_displayMode);
 }
 
 /**
- * Returns a list with all the valid serial port objects
+ * Hands the bytes received by the GUI thread's serial port to the consumers
  */
-QVector<QSerialPortInfo> Serial::validPorts() const
+void Serial::drainReceiveBuffer()
+{
+    RingBuffer::Span first, second;
+    const size_t bytes = m_rxBuffer.readSpans(first, second);
+    if (bytes == 0)
+        return;
+
+    qint64 readNs = 0;
+    if (Misc::Instrumentation::enabled())
+        readNs = m_counters->recordDispatch(bytes, m_rxBuffer.overflowBytes());
+
+    Misc::Instrumentation::DispatchScope scope(readNs);
+
+    if (m_captureWriter)
+        m_captureWriter->append(0, Capture::Received, first.data, int(first.size),
+                                second.data, int(second.size));
+
+    forwardData(first, second);
+    m_rxBuffer.consume(bytes);
+}
+
+/**
+ * Hands the received bytes to the consumers without copying them.
+ *
+ * Slots connected to @c dataAvailable() parse the data in place and must be
+ * invoked directly, since the spans are only valid during the emission. The
+ * bytes are copied into a single @c QByteArray for @c dataReceived() only if
+ * a slot is connected to that signal.
+ */
+void Serial::forwardData(const RingBuffer::Span &first, const RingBuffer::Span &second)
 {
-    // Search for available ports and add them to the list
-    QVector<QSerialPortInfo> ports;
-    Q_FOREACH (QSerialPortInfo info, QSerialPortInfo::availablePorts())
+    Q_EMIT dataAvailable(first, second);
+
+    static const QMetaMethod signal = QMetaMethod::fromSignal(&Serial::dataReceived);
+    if (isSignalConnected(signal))
     {
-        if (!info.isNull())
-        {
-            // Only accept *.cu devices on macOS (remove *.tty)
-            // https://stackoverflow.com/a/37688347
-#ifdef Q_OS_MACOS
-            if (info.portName().toLower().startsWith("tty."))
-                continue;
-#endif
-            // Append port to list
-            ports.append(info);
-        }
+        QByteArray data(int(first.size + second.size), Qt::Uninitialized);
+        memcpy(data.data(), first.data, first.size);
+        memcpy(data.data() + first.size, second.data, second.size);
+        Q_EMIT dataReceived(data);
     }
+}
+
+/**
+ * Sends the current serial configuration to the port owned by the I/O thread
+ */
+void Serial::updateChannelConfiguration()
+{
+    if (m_channel == Q_NULLPTR)
+        return;
+
+    m_channel->configure(configuration(m_channel->configuration().systemLocation,
+                                       m_channel->configuration().openMode));
+}
+
+/**
+ * Returns the current serial configuration for the device at @a systemLocation
+ */
+SerialWorker::Configuration Serial::configuration(const QString &systemLocation,
+                                                  QIODevice::OpenMode mode) const
+{
+    SerialWorker::Configuration config;
+    config.systemLocation = systemLocation;
+    config.baudRate = baudRate();
+    config.parity = parity();
+    config.dataBits = dataBits();
+    config.stopBits = stopBits();
+    config.flowControl = flowControl();
+    config.openMode = mode;
+    return config;
+}
 
-    // Return list
-    return ports;
+/**
+ * Returns a list with all the valid serial port objects, as of the last
+ * device change reported by the port watcher
+ */
+QVector<QSerialPortInfo> Serial::validPorts() const
+{
+    return m_validPorts;
 }
 
 #ifdef SERIAL_STUDIO_INCLUDE_MOC
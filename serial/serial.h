@@ -7,6 +7,13 @@
 #include <QTimer>
 #include <QSettings>
 #include <QMap>
+#include <QHash>
+#include "portmanager.h"
+#include "portwatcher.h"
+#include "reconnector.h"
+#include "ringbuffer.h"
+#include "writequeue.h"
+#include <functional>
 
 class Serial : public QObject
 {
@@ -32,22 +39,44 @@ Q_SIGNALS:
     void baudRateIndexChanged();
     void availablePortsChanged();
     void connectionError(const QString &name);
+    void reconnected(const qint64 outageMs);
+    void reconnectStateChanged();
+    void ioThreadEnabledChanged();
     void dataReceived(const QByteArray &data);
+    void dataAvailable(const RingBuffer::Span &first, const RingBuffer::Span &second);
+    void receiveBufferSizeChanged();
+    void displayModeChanged();
+    void writeCompleted(const quint64 id, const WriteQueue::Status status);
 
 public:
+    typedef std::function<void(WriteQueue::Status status)> WriteCallback;
+
     static Serial &instance();
     void close();
     bool isOpen() const;
     bool isWritable()const;
     bool isReadable() const;
     bool configurationOk() const;
-    quint64 write(const QByteArray &data) ;
+    qint64 write(const QByteArray &data);
+    quint64 send(const QByteArray &data,
+                 const WriteQueue::Priority priority = WriteQueue::Normal,
+                 const quint32 coalesceKey = 0,
+                 const WriteCallback &callback = WriteCallback());
+    void replayData(const char *data, const int size);
     bool open(const QIODevice::OpenMode mode) ;
+    bool open(const QString &systemLocation, const QIODevice::OpenMode mode);
+    void waitForDevice(const QString &systemLocation, const QIODevice::OpenMode mode);
     void disconnectDevice();
     bool connectDevice();
     QString portName() const;
     QSerialPort *port() const;
     bool autoReconnect() const;
+    bool ioThreadEnabled() const;
+    quint64 droppedBytes() const;
+    quint32 receiveBufferSize() const;
+    const RingBuffer &receiveBuffer() const;
+    CaptureWriter *captureWriter() const;
+    const Reconnector &reconnector() const;
 
     quint8 portIndex() const;
     quint8 parityIndex() const;
@@ -61,6 +90,7 @@ public:
     QStringList dataBitsList() const;
     QStringList stopBitsList() const;
     QStringList flowControlList() const;
+    QStringList displayModeList() const;
 
     qint32 baudRate() const;
     QSerialPort::Parity parity() const;
@@ -77,19 +107,49 @@ public Q_SLOTS:
     void setDataBits(const quint8 dataBitsIndex);
     void setStopBits(const quint8 stopBitsIndex);
     void setAutoReconnect(const bool autoreconnect);
+    void setIoThreadEnabled(const bool enabled);
+    void setReceiveBufferSize(const quint32 bytes);
     void setFlowControl(const quint8 flowControlIndex);
+    void setDisplayMode(const quint8 displayMode);
+    void setCaptureWriter(CaptureWriter *writer);
 private Q_SLOTS:
     void onReadyRead();
+    void forwardData(const RingBuffer::Span &first, const RingBuffer::Span &second);
     void readSettings();
     void writeSettings();
     void refreshSerialDevices();
+    void onPortsChanged(const QVector<QSerialPortInfo> &ports,
+                        const QVector<QSerialPortInfo> &added,
+                        const QVector<QSerialPortInfo> &removed);
+    void onConnectionLost();
+    void onReopenRequested(const QString &systemLocation);
     void handleError(QSerialPort::SerialPortError error);
+    void onWriteCompleted(const quint64 id, const WriteQueue::Status status);
+private:
+    void closeDevice();
+    void drainReceiveBuffer();
+    void updateChannelConfiguration();
+    SerialWorker::Configuration configuration(const QString &systemLocation,
+                                              QIODevice::OpenMode mode) const;
+
 private:
     QSerialPort *m_port;
-    QTimer m_timerFreshPorts;
+    PortWatcher m_portWatcher;
     bool m_autoReconnect;
+    QIODevice::OpenMode m_openMode;
+    Reconnector m_reconnector;
     int m_lastSerialDeviceIndex;
     QSettings m_settings;
+    bool m_ioThreadEnabled;
+    SerialChannel *m_channel;
+    CaptureWriter *m_captureWriter;
+    Misc::Instrumentation::Port *m_counters;
+    WriteQueue m_writeQueue;
+    QHash<quint64, WriteCallback> m_writeCallbacks;
+    QString m_portName;
+    quint32 m_receiveBufferSize;
+    QByteArray m_discardBuffer;
+    RingBuffer m_rxBuffer;
     qint32 m_baudRate;
     QSerialPort::Parity m_parity;
     QSerialPort::DataBits m_dataBits;
@@ -101,11 +161,15 @@ private:
     quint8 m_dataBitsIndex;
     quint8 m_stopBitsIndex;
     quint8 m_flowControlIndex;
+    quint8 m_displayMode;
+    bool m_portListReady;
 
     QMap<QString , QSerialPortInfo> m_portList;
    // QStringList m_portList;
     QStringList m_baudRateList;
+    QVector<QSerialPortInfo> m_validPorts;
     QVector<QSerialPortInfo> validPorts() const;
+    void updatePortList(const QVector<QSerialPortInfo> &validPortList);
 signals:
 
 };
@@ -0,0 +1,336 @@
+#include "serialchannel.h"
+
+/**
+ * Number of messages that can be in transit to the I/O thread
+ */
+static const int TX_QUEUE_SIZE = 256;
+
+/**
+ * Interval of the inter-character timeout check of @c Deframer::Timeout
+ */
+static const int FRAME_TIMEOUT_CHECK_MS = 10;
+
+//----------------------------------------------------------------------------------------
+// Constructor/destructor
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function, creates the receive buffer with (at least)
+ * @a rxBufferSize bytes & starts the I/O thread of the channel.
+ */
+SerialChannel::SerialChannel(const int id, const quint32 rxBufferSize, QObject *parent)
+    : QObject(parent)
+    , m_id(id)
+    , m_rxBuffer(rxBufferSize)
+    , m_txQueue(TX_QUEUE_SIZE)
+    , m_worker(Q_NULLPTR)
+    , m_counters(Misc::Instrumentation::instance().port(id))
+    , m_bytesReceived(0)
+    , m_captureWriter(Q_NULLPTR)
+    , m_framingEnabled(false)
+    , m_frameTimer(new QTimer(this))
+    , m_framesReceived(0)
+{
+    m_configuration.baudRate = 0;
+    m_configuration.parity = QSerialPort::NoParity;
+    m_configuration.dataBits = QSerialPort::Data8;
+    m_configuration.stopBits = QSerialPort::OneStop;
+    m_configuration.flowControl = QSerialPort::NoFlowControl;
+    m_configuration.openMode = QIODevice::NotOpen;
+
+    m_worker = new SerialWorker(&m_rxBuffer, &m_txQueue, m_counters);
+    m_worker->moveToThread(&m_ioThread);
+
+    connect(m_worker, &SerialWorker::dataReady, this, &SerialChannel::onDataReady,
+            Qt::QueuedConnection);
+    connect(m_worker, &SerialWorker::errorOccurred, this, &SerialChannel::errorOccurred,
+            Qt::QueuedConnection);
+    connect(m_worker, &SerialWorker::writeCompleted, this, &SerialChannel::writeCompleted,
+            Qt::QueuedConnection);
+
+    // The timer is a child of the channel, so that it follows it to its thread
+    m_frameClock.start();
+    m_frameTimer->setInterval(FRAME_TIMEOUT_CHECK_MS);
+    connect(m_frameTimer, &QTimer::timeout, this, &SerialChannel::checkFrameTimeout);
+    m_deframer.setFrameHandler([=](const char *frame, int size) {
+        m_framesReceived.fetch_add(1, std::memory_order_relaxed);
+        Q_EMIT frameReceived(m_id, QByteArray(frame, size));
+    });
+
+    m_ioThread.setObjectName(QString("SerialIO-%1").arg(id));
+    m_ioThread.start(QThread::TimeCriticalPriority);
+}
+
+/**
+ * Destructor function, closes the port & stops the I/O thread
+ */
+SerialChannel::~SerialChannel()
+{
+    close();
+
+    m_ioThread.quit();
+    m_ioThread.wait();
+
+    delete m_worker;
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns the ID assigned to the channel by @c PortManager
+ */
+int SerialChannel::id() const
+{
+    return m_id;
+}
+
+/**
+ * Returns the configuration that the port was opened/configured with
+ */
+SerialWorker::Configuration SerialChannel::configuration() const
+{
+    return m_configuration;
+}
+
+/**
+ * Returns @c true if the serial port is currently open
+ */
+bool SerialChannel::isOpen() const
+{
+    return m_worker->isOpen();
+}
+
+/**
+ * Returns @c true if the serial port was opened with read access
+ */
+bool SerialChannel::isReadable() const
+{
+    return m_worker->isReadable();
+}
+
+/**
+ * Returns @c true if the serial port was opened with write access
+ */
+bool SerialChannel::isWritable() const
+{
+    return m_worker->isWritable();
+}
+
+/**
+ * Returns the number of bytes handed to the consumers since the port was
+ * opened
+ */
+quint64 SerialChannel::bytesReceived() const
+{
+    return m_bytesReceived.load(std::memory_order_relaxed);
+}
+
+/**
+ * Returns the number of bytes discarded because the receive buffer was full
+ */
+quint64 SerialChannel::droppedBytes() const
+{
+    return m_rxBuffer.overflowBytes();
+}
+
+/**
+ * Returns the receive ring buffer, which can be used to query the high-water
+ * mark & overflow counters of the channel.
+ */
+const RingBuffer &SerialChannel::receiveBuffer() const
+{
+    return m_rxBuffer;
+}
+
+/**
+ * Queues @a data for transmission with the given @a priority, returns the ID
+ * of the message or 0 if the port is not writable or the transmit queue is
+ * full. The outcome of an accepted message is reported by
+ * @c writeCompleted(). Queued messages with the same non-zero
+ * @a coalesceKey supersede each other.
+ *
+ * @note The transmit queue has a single producer, only one thread at a time
+ *       may write to a given channel.
+ */
+quint64 SerialChannel::write(const QByteArray &data, const WriteQueue::Priority priority,
+                             const quint32 coalesceKey)
+{
+    if (!isWritable())
+        return 0;
+
+    const quint64 id = WriteQueue::nextId();
+    WriteQueue::Request request;
+    request.id = id;
+    request.data = data;
+    request.priority = priority;
+    request.coalesceKey = coalesceKey;
+    if (!m_txQueue.push(std::move(request)))
+    {
+        if (Misc::Instrumentation::enabled())
+            m_counters->recordDroppedWrite(quint64(data.size()));
+
+        return 0;
+    }
+
+    if (Misc::Instrumentation::enabled())
+        m_counters->recordWrite(quint64(data.size()), quint64(m_txQueue.size()));
+
+    QMetaObject::invokeMethod(m_worker, "flushWrites", Qt::QueuedConnection);
+    return id;
+}
+
+/**
+ * Records the traffic of the channel with @a writer, or stops recording if
+ * @a writer is @c Q_NULLPTR
+ */
+void SerialChannel::setCaptureWriter(CaptureWriter *writer)
+{
+    m_captureWriter.store(writer, std::memory_order_release);
+    m_worker->setCaptureWriter(writer, quint16(m_id));
+}
+
+/**
+ * Splits the received data into frames according to @a config on the thread
+ * of the channel & emits them with @c frameReceived(), or stops doing so if
+ * @a enabled is @c false. Can be called from any thread.
+ */
+void SerialChannel::setFraming(const Deframer::Configuration &config, const bool enabled)
+{
+    QMetaObject::invokeMethod(this, [=]() {
+        m_deframer.setConfiguration(config);
+        m_framingEnabled = enabled;
+
+        if (enabled && config.mode == Deframer::Timeout)
+            m_frameTimer->start();
+        else
+            m_frameTimer->stop();
+    });
+}
+
+/**
+ * Returns the number of frames found by the deframer of the channel
+ */
+quint64 SerialChannel::framesReceived() const
+{
+    return m_framesReceived.load(std::memory_order_relaxed);
+}
+
+/**
+ * Returns the instrumentation counters of the channel
+ */
+Misc::Instrumentation::Port *SerialChannel::counters() const
+{
+    return m_counters;
+}
+
+//----------------------------------------------------------------------------------------
+// Port control
+//----------------------------------------------------------------------------------------
+
+/**
+ * Opens the serial port described by @a config on the I/O thread, returns
+ * @c true on success.
+ *
+ * @note Must be called before the channel starts receiving data, since the
+ *       receive buffer is cleared.
+ */
+bool SerialChannel::open(const SerialWorker::Configuration &config)
+{
+    close();
+
+    m_rxBuffer.reset(m_rxBuffer.capacity());
+    m_bytesReceived.store(0);
+    m_configuration = config;
+    Misc::Instrumentation::instance().openPort(m_counters, config.systemLocation);
+
+    bool opened = false;
+    QMetaObject::invokeMethod(
+        m_worker, [&]() { opened = m_worker->open(config); },
+        Qt::BlockingQueuedConnection);
+
+    if (!opened)
+        Misc::Instrumentation::instance().closePort(m_counters);
+
+    return opened;
+}
+
+/**
+ * Closes the serial port, blocks until the I/O thread has released it
+ */
+void SerialChannel::close()
+{
+    if (!m_worker->isOpen())
+        return;
+
+    QMetaObject::invokeMethod(
+        m_worker, [=]() { m_worker->close(); }, Qt::BlockingQueuedConnection);
+
+    Misc::Instrumentation::instance().closePort(m_counters);
+}
+
+/**
+ * Applies the serial parameters of @a config to the open port
+ */
+void SerialChannel::configure(const SerialWorker::Configuration &config)
+{
+    m_configuration.baudRate = config.baudRate;
+    m_configuration.parity = config.parity;
+    m_configuration.dataBits = config.dataBits;
+    m_configuration.stopBits = config.stopBits;
+    m_configuration.flowControl = config.flowControl;
+
+    if (!isOpen())
+        return;
+
+    QMetaObject::invokeMethod(
+        m_worker, [=]() { m_worker->configure(config); }, Qt::QueuedConnection);
+}
+
+/**
+ * Hands the bytes stored by the I/O thread to the consumers without copying
+ * them, the spans are only valid during the emission of @c dataAvailable().
+ */
+void SerialChannel::onDataReady()
+{
+    m_worker->acknowledgeData();
+
+    RingBuffer::Span first, second;
+    const size_t bytes = m_rxBuffer.readSpans(first, second);
+    if (bytes == 0)
+        return;
+
+    qint64 readNs = 0;
+    if (Misc::Instrumentation::enabled())
+        readNs = m_counters->recordDispatch(bytes, m_rxBuffer.overflowBytes());
+
+    Misc::Instrumentation::DispatchScope scope(readNs);
+
+    CaptureWriter *writer = m_captureWriter.load(std::memory_order_acquire);
+    if (writer)
+        writer->append(quint16(m_id), Capture::Received, first.data, int(first.size),
+                       second.data, int(second.size));
+
+    Q_EMIT dataAvailable(first, second);
+
+    if (m_framingEnabled)
+    {
+        const qint64 now = m_frameClock.nsecsElapsed() / 1000;
+        m_deframer.process(first.data, int(first.size), now);
+        if (second.size > 0)
+            m_deframer.process(second.data, int(second.size), now);
+    }
+
+    m_bytesReceived.fetch_add(bytes, std::memory_order_relaxed);
+    m_rxBuffer.consume(bytes);
+}
+
+/**
+ * Completes the frame in progress after the inter-character timeout
+ */
+void SerialChannel::checkFrameTimeout()
+{
+    if (m_framingEnabled)
+        m_deframer.checkTimeout(m_frameClock.nsecsElapsed() / 1000);
+}
@@ -0,0 +1,91 @@
+#ifndef SERIALCHANNEL_H
+#define SERIALCHANNEL_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <atomic>
+#include "serialworker.h"
+#include "ringbuffer.h"
+#include "spscqueue.h"
+#include "capturewriter.h"
+#include "deframer.h"
+#include "Instrumentation.h"
+
+/**
+ * One open serial port with its own configuration, receive/transmit buffers
+ * and I/O thread.
+ *
+ * The I/O thread fills the receive ring buffer, the bytes are drained on the
+ * thread that the channel object lives in (the GUI thread or one of the
+ * decode threads of @c PortManager). Slots connected to @c dataAvailable()
+ * with @c Qt::DirectConnection parse the data in place on that thread.
+ *
+ * With @c setFraming() the channel also splits the data into frames on that
+ * thread (including the checksum verification of the @c Deframer) and emits
+ * each one with @c frameReceived(), so that the decoding of channels on the
+ * decode pool runs in parallel and only whole frames cross threads.
+ */
+class SerialChannel : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SerialChannel(const int id, const quint32 rxBufferSize,
+                           QObject *parent = nullptr);
+    ~SerialChannel();
+
+    int id() const;
+    SerialWorker::Configuration configuration() const;
+
+    // Thread-safe accessors
+    bool isOpen() const;
+    bool isReadable() const;
+    bool isWritable() const;
+    quint64 bytesReceived() const;
+    quint64 droppedBytes() const;
+    quint64 framesReceived() const;
+    const RingBuffer &receiveBuffer() const;
+    Misc::Instrumentation::Port *counters() const;
+
+    quint64 write(const QByteArray &data,
+                  const WriteQueue::Priority priority = WriteQueue::Normal,
+                  const quint32 coalesceKey = 0);
+    void setCaptureWriter(CaptureWriter *writer);
+    void setFraming(const Deframer::Configuration &config, const bool enabled = true);
+
+Q_SIGNALS:
+    void dataAvailable(const RingBuffer::Span &first, const RingBuffer::Span &second);
+    void errorOccurred(QSerialPort::SerialPortError error);
+    void writeCompleted(const quint64 id, const WriteQueue::Status status);
+    void frameReceived(const int channelId, const QByteArray &frame);
+
+public Q_SLOTS:
+    bool open(const SerialWorker::Configuration &config);
+    void close();
+    void configure(const SerialWorker::Configuration &config);
+
+private Q_SLOTS:
+    void onDataReady();
+    void checkFrameTimeout();
+
+private:
+    int m_id;
+    SerialWorker::Configuration m_configuration;
+    RingBuffer m_rxBuffer;
+    SpscQueue<WriteQueue::Request> m_txQueue;
+    QThread m_ioThread;
+    SerialWorker *m_worker;
+    Misc::Instrumentation::Port *m_counters;
+    std::atomic<quint64> m_bytesReceived;
+    std::atomic<CaptureWriter *> m_captureWriter;
+
+    // Only used on the thread of the channel
+    bool m_framingEnabled;
+    Deframer m_deframer;
+    QTimer *m_frameTimer;
+    QElapsedTimer m_frameClock;
+    std::atomic<quint64> m_framesReceived;
+};
+
+#endif // SERIALCHANNEL_H
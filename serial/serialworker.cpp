@@ -0,0 +1,255 @@
+#include "serialworker.h"
+
+/**
+ * Size of the scratch buffer used to drain the driver while the receive ring
+ * buffer is full.
+ */
+static const int DISCARD_BUFFER_SIZE = 4 * 1024;
+
+//----------------------------------------------------------------------------------------
+// Constructor/destructor
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function, @a rxBuffer is filled by this object (producer) and
+ * @a txQueue is drained by this object (consumer) into the priority queue of
+ * the port. The received chunks are accounted in @a counters.
+ */
+SerialWorker::SerialWorker(RingBuffer *rxBuffer,
+                           SpscQueue<WriteQueue::Request> *txQueue,
+                           Misc::Instrumentation::Port *counters, QObject *parent)
+    : QObject(parent)
+    , m_port(Q_NULLPTR)
+    , m_discardBuffer(DISCARD_BUFFER_SIZE, Qt::Uninitialized)
+    , m_rxBuffer(rxBuffer)
+    , m_txQueue(txQueue)
+    , m_counters(counters)
+    , m_writeQueue(counters, this)
+    , m_open(false)
+    , m_openMode(QIODevice::NotOpen)
+    , m_notifyPending(false)
+{
+    connect(&m_writeQueue, &WriteQueue::completed, this, &SerialWorker::writeCompleted);
+}
+
+/**
+ * Destructor function, closes the serial port (if any)
+ */
+SerialWorker::~SerialWorker()
+{
+    close();
+}
+
+//----------------------------------------------------------------------------------------
+// Thread-safe accessors
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns @c true if the serial port is currently open
+ */
+bool SerialWorker::isOpen() const
+{
+    return m_open.load();
+}
+
+/**
+ * Returns @c true if the serial port was opened with read access
+ */
+bool SerialWorker::isReadable() const
+{
+    return isOpen() && (m_openMode.load() & QIODevice::ReadOnly);
+}
+
+/**
+ * Returns @c true if the serial port was opened with write access
+ */
+bool SerialWorker::isWritable() const
+{
+    return isOpen() && (m_openMode.load() & QIODevice::WriteOnly);
+}
+
+/**
+ * Must be called by the consumer before it drains the receive buffer, so that
+ * the next bytes stored by the I/O thread emit @c dataReady() again.
+ */
+void SerialWorker::acknowledgeData()
+{
+    m_notifyPending.store(false);
+}
+
+/**
+ * Records the messages written by the I/O thread with @a writer as
+ * transmitted by @a portId, or stops recording if @a writer is
+ * @c Q_NULLPTR
+ */
+void SerialWorker::setCaptureWriter(CaptureWriter *writer, const quint16 portId)
+{
+    m_writeQueue.setCaptureWriter(writer, portId);
+}
+
+//----------------------------------------------------------------------------------------
+// I/O thread slots
+//----------------------------------------------------------------------------------------
+
+/**
+ * Creates & opens the serial port with the given @a config, returns @c true
+ * on success.
+ */
+bool SerialWorker::open(const SerialWorker::Configuration &config)
+{
+    close();
+
+    // Create & configure serial port handler
+    m_port = new QSerialPort(this);
+    m_port->setPortName(config.systemLocation);
+    m_port->setParity(config.parity);
+    m_port->setBaudRate(config.baudRate);
+    m_port->setDataBits(config.dataBits);
+    m_port->setStopBits(config.stopBits);
+    m_port->setFlowControl(config.flowControl);
+
+    // Connect signals/slots
+    connect(m_port, &QSerialPort::errorOccurred, this,
+            &SerialWorker::onErrorOccurred);
+
+    // Open device
+    if (!m_port->open(config.openMode))
+    {
+        close();
+        return false;
+    }
+
+    connect(m_port, &QIODevice::readyRead, this, &SerialWorker::onReadyRead);
+    m_writeQueue.setHighWaterMark(WriteQueue::highWaterMarkFor(config.baudRate));
+    m_writeQueue.setPort(m_port);
+    m_openMode.store(static_cast<int>(config.openMode));
+    m_open.store(true);
+    return true;
+}
+
+/**
+ * Closes & deletes the serial port handler, the messages that were not
+ * written yet are completed as failed
+ */
+void SerialWorker::close()
+{
+    m_open.store(false);
+    m_openMode.store(QIODevice::NotOpen);
+    m_writeQueue.setPort(Q_NULLPTR);
+
+    if (m_port != Q_NULLPTR)
+    {
+        m_port->disconnect(this);
+        m_port->close();
+        delete m_port;
+        m_port = Q_NULLPTR;
+    }
+}
+
+/**
+ * Applies the serial parameters of @a config to the open port
+ */
+void SerialWorker::configure(const SerialWorker::Configuration &config)
+{
+    if (m_port == Q_NULLPTR)
+        return;
+
+    m_port->setParity(config.parity);
+    m_port->setBaudRate(config.baudRate);
+    m_port->setDataBits(config.dataBits);
+    m_port->setStopBits(config.stopBits);
+    m_port->setFlowControl(config.flowControl);
+    m_writeQueue.setHighWaterMark(WriteQueue::highWaterMarkFor(config.baudRate));
+}
+
+/**
+ * Moves the messages of the transmit queue into the priority queue, which
+ * hands them to the serial port as its buffer drains
+ */
+void SerialWorker::flushWrites()
+{
+    WriteQueue::Request request;
+    while (m_txQueue->pop(request))
+    {
+        if (isWritable())
+            m_writeQueue.enqueue(request);
+        else
+            Q_EMIT writeCompleted(request.id, WriteQueue::Failed);
+    }
+}
+
+/**
+ * Drains the serial port into the receive ring buffer
+ */
+void SerialWorker::onReadyRead()
+{
+    if (m_port == Q_NULLPTR)
+        return;
+
+    const bool instrumented = Misc::Instrumentation::enabled();
+    if (instrumented)
+        m_counters->markRead(Misc::Instrumentation::timestampNs());
+
+    const qint64 bytes = readAvailable(m_port, m_rxBuffer, m_discardBuffer);
+    if (instrumented)
+        m_counters->recordChunk(quint64(bytes));
+
+    notifyDataReady();
+}
+
+/**
+ * Forwards serial port errors to the GUI thread
+ */
+void SerialWorker::onErrorOccurred(QSerialPort::SerialPortError error)
+{
+    if (error != QSerialPort::NoError)
+        Q_EMIT errorOccurred(error);
+}
+
+/**
+ * Reads the data available in @a port directly into the free region of
+ * @a buffer. When the ring buffer is full the data is drained into
+ * @a discardBuffer & accounted as overflow, so that memory use stays bounded.
+ * Returns the number of bytes read, including the discarded ones.
+ */
+qint64 SerialWorker::readAvailable(QSerialPort *port, RingBuffer *buffer,
+                                   QByteArray &discardBuffer)
+{
+    qint64 total = 0;
+    while (port->bytesAvailable() > 0)
+    {
+        RingBuffer::MutableSpan span = buffer->writeSpan();
+        if (span.size == 0)
+        {
+            const qint64 bytes = port->read(discardBuffer.data(), discardBuffer.size());
+            if (bytes <= 0)
+                break;
+
+            buffer->recordOverflow(size_t(bytes));
+            total += bytes;
+            continue;
+        }
+
+        const qint64 bytes = port->read(span.data, qint64(span.size));
+        if (bytes <= 0)
+            break;
+
+        buffer->commit(size_t(bytes));
+        total += bytes;
+    }
+
+    return total;
+}
+
+/**
+ * Emits @c dataReady() only once until the consumer acknowledges it, so that
+ * a burst of small reads results in a single queued event on the GUI thread.
+ */
+void SerialWorker::notifyDataReady()
+{
+    if (m_rxBuffer->isEmpty())
+        return;
+
+    if (!m_notifyPending.exchange(true))
+        Q_EMIT dataReady();
+}
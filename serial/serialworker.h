@@ -0,0 +1,80 @@
+#ifndef SERIALWORKER_H
+#define SERIALWORKER_H
+
+#include <QObject>
+#include <QSerialPort>
+#include <QByteArray>
+#include <atomic>
+#include "ringbuffer.h"
+#include "spscqueue.h"
+#include "writequeue.h"
+#include "Instrumentation.h"
+
+/**
+ * Owns a @c QSerialPort on a dedicated I/O thread. Received bytes are read
+ * straight into a preallocated ring buffer that the GUI thread drains, so
+ * that slow repaints can no longer delay draining the driver's receive FIFO.
+ */
+class SerialWorker : public QObject
+{
+    Q_OBJECT
+public:
+    struct Configuration
+    {
+        QString systemLocation;
+        qint32 baudRate;
+        QSerialPort::Parity parity;
+        QSerialPort::DataBits dataBits;
+        QSerialPort::StopBits stopBits;
+        QSerialPort::FlowControl flowControl;
+        QIODevice::OpenMode openMode;
+    };
+
+    explicit SerialWorker(RingBuffer *rxBuffer,
+                          SpscQueue<WriteQueue::Request> *txQueue,
+                          Misc::Instrumentation::Port *counters,
+                          QObject *parent = nullptr);
+    ~SerialWorker();
+
+    // Thread-safe accessors
+    bool isOpen() const;
+    bool isReadable() const;
+    bool isWritable() const;
+    void acknowledgeData();
+    void setCaptureWriter(CaptureWriter *writer, const quint16 portId);
+
+    static qint64 readAvailable(QSerialPort *port, RingBuffer *buffer,
+                              QByteArray &discardBuffer);
+
+Q_SIGNALS:
+    void dataReady();
+    void errorOccurred(QSerialPort::SerialPortError error);
+    void writeCompleted(const quint64 id, const WriteQueue::Status status);
+
+public Q_SLOTS:
+    bool open(const SerialWorker::Configuration &config);
+    void close();
+    void configure(const SerialWorker::Configuration &config);
+    void flushWrites();
+
+private Q_SLOTS:
+    void onReadyRead();
+    void onErrorOccurred(QSerialPort::SerialPortError error);
+
+private:
+    void notifyDataReady();
+
+private:
+    QSerialPort *m_port;
+    QByteArray m_discardBuffer;
+    RingBuffer *m_rxBuffer;
+    SpscQueue<WriteQueue::Request> *m_txQueue;
+    Misc::Instrumentation::Port *m_counters;
+    WriteQueue m_writeQueue;
+
+    std::atomic<bool> m_open;
+    std::atomic<int> m_openMode;
+    std::atomic<bool> m_notifyPending;
+};
+
+#endif // SERIALWORKER_H
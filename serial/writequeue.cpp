@@ -0,0 +1,313 @@
+#include "writequeue.h"
+#include "capturewriter.h"
+
+/**
+ * Maximum number of bytes waiting in the queue, further messages are dropped
+ */
+static const qint64 DEFAULT_CAPACITY = 1024 * 1024;
+
+/**
+ * Bounds of the amount of data handed to the port at a time
+ */
+static const qint64 MIN_HIGH_WATER_MARK = 64;
+static const qint64 DEFAULT_HIGH_WATER_MARK = 256;
+
+/**
+ * Line time covered by the data handed to the port, which is the longest
+ * that an emergency message waits behind data that was already handed over
+ */
+static const qint64 HIGH_WATER_MARK_MS = 10;
+
+//----------------------------------------------------------------------------------------
+// Constructor function
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function, dropped messages are accounted in @a counters (if
+ * any)
+ */
+WriteQueue::WriteQueue(Misc::Instrumentation::Port *counters, QObject *parent)
+    : QObject(parent)
+    , m_port(Q_NULLPTR)
+    , m_counters(counters)
+    , m_capacity(DEFAULT_CAPACITY)
+    , m_highWaterMark(DEFAULT_HIGH_WATER_MARK)
+    , m_pendingBytes(0)
+    , m_handedBytes(0)
+    , m_writtenBytes(0)
+    , m_captureWriter(Q_NULLPTR)
+    , m_capturePort(0)
+{
+    // Completions are reported across threads by SerialWorker
+    qRegisterMetaType<WriteQueue::Status>("WriteQueue::Status");
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns the port that the messages are written to
+ */
+QSerialPort *WriteQueue::port() const
+{
+    return m_port;
+}
+
+/**
+ * Writes the next messages to @a port. The messages of the previous port
+ * are aborted, @a port may be @c Q_NULLPTR when the port is closed.
+ */
+void WriteQueue::setPort(QSerialPort *port)
+{
+    if (m_port)
+        disconnect(m_port, &QSerialPort::bytesWritten, this, &WriteQueue::onBytesWritten);
+
+    abort(Failed);
+
+    m_port = port;
+    m_handedBytes = 0;
+    m_writtenBytes = 0;
+
+    if (m_port)
+        connect(m_port, &QSerialPort::bytesWritten, this, &WriteQueue::onBytesWritten);
+}
+
+/**
+ * Returns the maximum number of bytes that may wait in the queue
+ */
+qint64 WriteQueue::capacity() const
+{
+    return m_capacity;
+}
+
+/**
+ * Returns the maximum number of bytes that are handed to the port before it
+ * reports that they were written
+ */
+qint64 WriteQueue::highWaterMark() const
+{
+    return m_highWaterMark;
+}
+
+/**
+ * Returns the number of bytes waiting in the queue
+ */
+qint64 WriteQueue::pendingBytes() const
+{
+    return m_pendingBytes;
+}
+
+/**
+ * Returns the number of messages waiting in the queue
+ */
+int WriteQueue::pendingRequests() const
+{
+    return m_requests.count();
+}
+
+/**
+ * Returns the number of messages handed to the port that were not fully
+ * written yet
+ */
+int WriteQueue::inFlightRequests() const
+{
+    return m_inFlight.count();
+}
+
+/**
+ * Records the written messages with @a writer as transmitted by @a portId,
+ * or stops recording if @a writer is @c Q_NULLPTR. Thread-safe.
+ */
+void WriteQueue::setCaptureWriter(CaptureWriter *writer, const quint16 portId)
+{
+    m_capturePort.store(portId, std::memory_order_relaxed);
+    m_captureWriter.store(writer, std::memory_order_release);
+}
+
+/**
+ * Returns a new message ID, unique across all the ports of the process.
+ * Thread-safe, IDs start at 1 so that 0 can mean "not queued".
+ */
+quint64 WriteQueue::nextId()
+{
+    static std::atomic<quint64> counter(0);
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+/**
+ * Returns a high-water mark that covers ~10 ms of line time at @a baudRate
+ */
+qint64 WriteQueue::highWaterMarkFor(const qint32 baudRate)
+{
+    // 10 bits per character (start, 8 data bits & stop)
+    const qint64 bytesPerSecond = qMax(baudRate, 0) / 10;
+    return qMax(MIN_HIGH_WATER_MARK, bytesPerSecond * HIGH_WATER_MARK_MS / 1000);
+}
+
+/**
+ * Changes the maximum number of bytes that may wait in the queue
+ */
+void WriteQueue::setCapacity(const qint64 bytes)
+{
+    m_capacity = qMax<qint64>(bytes, 0);
+}
+
+/**
+ * Changes the maximum number of bytes handed to the port at a time
+ */
+void WriteQueue::setHighWaterMark(const qint64 bytes)
+{
+    m_highWaterMark = qMax(bytes, MIN_HIGH_WATER_MARK);
+    pump();
+}
+
+//----------------------------------------------------------------------------------------
+// Scheduling
+//----------------------------------------------------------------------------------------
+
+/**
+ * Queues @a request & writes it right away if the port has room for it.
+ *
+ * A queued message with the same coalescing key is completed as
+ * superseded (& its room reused). Returns @c false (after completing the
+ * message as dropped, the queued one is kept) if the queue is full.
+ */
+bool WriteQueue::enqueue(const WriteQueue::Request &request)
+{
+    // The superseded message frees its room before the capacity check
+    quint64 previous = 0;
+    qint64 freedBytes = 0;
+    if (request.coalesceKey != 0)
+    {
+        previous = m_coalesced.value(request.coalesceKey);
+        if (previous != 0 && m_requests.contains(previous))
+            freedBytes = m_requests.value(previous).data.size();
+        else
+            previous = 0;
+    }
+
+    if (m_pendingBytes - freedBytes + request.data.size() > m_capacity)
+    {
+        if (m_counters && Misc::Instrumentation::enabled())
+            m_counters->recordDroppedWrite(quint64(request.data.size()));
+
+        Q_EMIT completed(request.id, Dropped);
+        return false;
+    }
+
+    if (previous != 0)
+    {
+        const Request superseded = m_requests.take(previous);
+        const int previousPriority
+            = qBound(0, int(superseded.priority), int(PriorityCount) - 1);
+        m_queues[previousPriority].removeOne(previous);
+        m_pendingBytes -= superseded.data.size();
+        Q_EMIT completed(previous, Superseded);
+    }
+
+    if (request.coalesceKey != 0)
+        m_coalesced.insert(request.coalesceKey, request.id);
+
+    const int priority = qBound(0, int(request.priority), int(PriorityCount) - 1);
+    m_requests.insert(request.id, request);
+    m_queues[priority].enqueue(request.id);
+    m_pendingBytes += request.data.size();
+
+    pump();
+    return true;
+}
+
+/**
+ * Completes all the queued & in-flight messages with @a status
+ */
+void WriteQueue::abort(const WriteQueue::Status status)
+{
+    while (!m_inFlight.isEmpty())
+        Q_EMIT completed(m_inFlight.dequeue().id, status);
+
+    Request request;
+    while (takeNext(request))
+        Q_EMIT completed(request.id, status);
+
+    m_pendingBytes = 0;
+    m_coalesced.clear();
+}
+
+/**
+ * Hands the most urgent messages to the port until its buffer reaches the
+ * high-water mark
+ */
+void WriteQueue::pump()
+{
+    if (!m_port || !m_port->isOpen())
+        return;
+
+    Request request;
+    while (m_port->bytesToWrite() < m_highWaterMark && takeNext(request))
+    {
+        if (request.data.isEmpty())
+        {
+            Q_EMIT completed(request.id, Written);
+            continue;
+        }
+
+        if (m_port->write(request.data) != request.data.size())
+        {
+            Q_EMIT completed(request.id, Failed);
+            continue;
+        }
+
+        m_handedBytes += request.data.size();
+        m_inFlight.enqueue({ request.id, m_handedBytes, request.data });
+    }
+}
+
+/**
+ * Completes the messages whose last byte was written to the driver & hands
+ * the next ones to the port
+ */
+void WriteQueue::onBytesWritten(const qint64 bytes)
+{
+    m_writtenBytes += bytes;
+    CaptureWriter *writer = m_captureWriter.load(std::memory_order_acquire);
+    while (!m_inFlight.isEmpty() && m_inFlight.head().end <= m_writtenBytes)
+    {
+        const InFlight message = m_inFlight.dequeue();
+        if (writer)
+            writer->append(m_capturePort.load(std::memory_order_relaxed),
+                           Capture::Transmitted, message.data.constData(),
+                           message.data.size());
+
+        Q_EMIT completed(message.id, Written);
+    }
+
+    pump();
+}
+
+/**
+ * Removes the next message in priority order from the queue, returns
+ * @c false if the queue is empty
+ */
+bool WriteQueue::takeNext(Request &request)
+{
+    for (int priority = 0; priority < PriorityCount; ++priority)
+    {
+        QQueue<quint64> &queue = m_queues[priority];
+        while (!queue.isEmpty())
+        {
+            const quint64 id = queue.dequeue();
+            if (!m_requests.contains(id))
+                continue;
+
+            request = m_requests.take(id);
+            m_pendingBytes -= request.data.size();
+            if (request.coalesceKey != 0 && m_coalesced.value(request.coalesceKey) == id)
+                m_coalesced.remove(request.coalesceKey);
+
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,125 @@
+#ifndef WRITEQUEUE_H
+#define WRITEQUEUE_H
+
+#include <QObject>
+#include <QQueue>
+#include <QHash>
+#include <QByteArray>
+#include <QSerialPort>
+#include <atomic>
+#include "Instrumentation.h"
+
+class CaptureWriter;
+
+/**
+ * Outgoing messages of one serial port, scheduled by priority.
+ *
+ * Only a small amount of data (@c highWaterMark()) is handed to the port at
+ * a time, the rest waits here until the port reports with @c bytesWritten()
+ * that its buffer has drained. This bounds the memory used while hardware
+ * flow control holds the line, and lets an urgent message overtake queued
+ * routine traffic instead of waiting behind it in the port's buffer.
+ *
+ * Queued messages with the same non-zero coalescing key supersede each
+ * other (e.g. consecutive setpoints of the same output), only the last one
+ * is sent. Every accepted message is reported exactly once by
+ * @c completed(), once its last byte was written to the driver or when it
+ * was superseded, dropped or aborted.
+ *
+ * Transmitted messages are recorded by the capture writer (if any) when
+ * their last byte was written, not when they were queued.
+ *
+ * The queue lives on the thread of the port & never blocks.
+ */
+class WriteQueue : public QObject
+{
+    Q_OBJECT
+public:
+    enum Priority
+    {
+        Emergency,
+        High,
+        Normal,
+        Low,
+        PriorityCount
+    };
+    Q_ENUM(Priority)
+
+    enum Status
+    {
+        Written,
+        Superseded,
+        Dropped,
+        Failed,
+    };
+    Q_ENUM(Status)
+
+    struct Request
+    {
+        quint64 id;
+        QByteArray data;
+        Priority priority;
+        quint32 coalesceKey;
+    };
+
+    explicit WriteQueue(Misc::Instrumentation::Port *counters = Q_NULLPTR,
+                        QObject *parent = nullptr);
+
+    QSerialPort *port() const;
+    void setPort(QSerialPort *port);
+
+    qint64 capacity() const;
+    qint64 highWaterMark() const;
+    qint64 pendingBytes() const;
+    int pendingRequests() const;
+    int inFlightRequests() const;
+
+    void setCaptureWriter(CaptureWriter *writer, const quint16 portId);
+
+    static quint64 nextId();
+    static qint64 highWaterMarkFor(const qint32 baudRate);
+
+Q_SIGNALS:
+    void completed(const quint64 id, const WriteQueue::Status status);
+
+public Q_SLOTS:
+    bool enqueue(const WriteQueue::Request &request);
+    void setCapacity(const qint64 bytes);
+    void setHighWaterMark(const qint64 bytes);
+    void abort(const WriteQueue::Status status = Failed);
+    void pump();
+
+private Q_SLOTS:
+    void onBytesWritten(const qint64 bytes);
+
+private:
+    struct InFlight
+    {
+        quint64 id;
+        qint64 end;
+        QByteArray data;
+    };
+
+    bool takeNext(Request &request);
+
+private:
+    QSerialPort *m_port;
+    Misc::Instrumentation::Port *m_counters;
+
+    qint64 m_capacity;
+    qint64 m_highWaterMark;
+    qint64 m_pendingBytes;
+
+    QQueue<quint64> m_queues[PriorityCount];
+    QHash<quint64, Request> m_requests;
+    QHash<quint32, quint64> m_coalesced;
+
+    qint64 m_handedBytes;
+    qint64 m_writtenBytes;
+    QQueue<InFlight> m_inFlight;
+
+    std::atomic<CaptureWriter *> m_captureWriter;
+    std::atomic<quint16> m_capturePort;
+};
+
+#endif // WRITEQUEUE_H
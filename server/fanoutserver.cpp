@@ -0,0 +1,540 @@
+#include "fanoutserver.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QVarLengthArray>
+#include <QtEndian>
+#include <cstring>
+
+/**
+ * Default number of simultaneous clients
+ */
+static const int DEFAULT_MAX_CLIENTS = 32;
+
+/**
+ * Default size of the queue of a client, several seconds of data at the
+ * highest baud rates before a slow consumer is skipped forward/dropped
+ */
+static const qint64 DEFAULT_MAX_QUEUE_BYTES = 4 * 1024 * 1024;
+
+/**
+ * Amount of data handed to the socket of a client at once, the socket copies
+ * what it is given into its own write buffer, the rest stays shared in the
+ * queue
+ */
+static const qint64 SOCKET_HIGH_WATER_MARK = 64 * 1024;
+
+/**
+ * Interval of the inter-character timeout check of the frame stream
+ */
+static const int FRAME_TIMEOUT_CHECK_MS = 10;
+
+//----------------------------------------------------------------------------------------
+// Constructor/destructor
+//----------------------------------------------------------------------------------------
+
+/**
+ * Constructor function, nothing is served until @c listen() or
+ * @c listenLocal() is called
+ */
+FanoutServer::FanoutServer(QObject *parent)
+    : QObject(parent)
+    , m_maxClients(DEFAULT_MAX_CLIENTS)
+    , m_maxQueueBytes(DEFAULT_MAX_QUEUE_BYTES)
+    , m_overflowPolicy(DropOldest)
+{
+    m_streamClients[RawStream] = 0;
+    m_streamClients[FrameStream] = 0;
+    std::memset(&m_statistics, 0, sizeof(m_statistics));
+
+    m_clock.start();
+    m_deframer.setFrameHandler([=](const char *frame, int size) {
+        publishFrame(frame, size);
+    });
+
+    m_timeoutTimer.setInterval(FRAME_TIMEOUT_CHECK_MS);
+    connect(&m_timeoutTimer, &QTimer::timeout, this, &FanoutServer::checkFrameTimeout);
+}
+
+/**
+ * Destructor function, disconnects all the clients
+ */
+FanoutServer::~FanoutServer()
+{
+    setSource(Q_NULLPTR);
+    close();
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns @c true if at least one listener is active
+ */
+bool FanoutServer::isListening() const
+{
+    return !m_tcpServers.isEmpty() || !m_localServers.isEmpty();
+}
+
+/**
+ * Returns the TCP port serving @a stream (useful after listening on port 0),
+ * or 0 if that stream is not served over TCP
+ */
+quint16 FanoutServer::tcpPort(const Stream stream) const
+{
+    Q_FOREACH (QTcpServer *server, m_tcpServers)
+    {
+        if (m_listenerStreams.value(server) == stream)
+            return server->serverPort();
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the reason of the last failed @c listen() / @c listenLocal()
+ */
+QString FanoutServer::errorString() const
+{
+    return m_errorString;
+}
+
+/**
+ * Returns the number of connected clients, of both streams
+ */
+int FanoutServer::clientCount() const
+{
+    return m_clients.count();
+}
+
+/**
+ * Returns the maximum number of simultaneous clients, further connections
+ * are refused
+ */
+int FanoutServer::maxClients() const
+{
+    return m_maxClients;
+}
+
+/**
+ * Returns the maximum amount of data queued for one client
+ */
+qint64 FanoutServer::maxQueueBytes() const
+{
+    return m_maxQueueBytes;
+}
+
+/**
+ * Returns what happens to a client whose queue is full
+ */
+FanoutServer::OverflowPolicy FanoutServer::overflowPolicy() const
+{
+    return m_overflowPolicy;
+}
+
+/**
+ * Returns the counters of the server
+ */
+const FanoutServer::Statistics &FanoutServer::statistics() const
+{
+    return m_statistics;
+}
+
+//----------------------------------------------------------------------------------------
+// Listeners
+//----------------------------------------------------------------------------------------
+
+/**
+ * Serves @a stream on the TCP @a port of @a address, use
+ * @c QHostAddress::LocalHost to only accept local clients & port 0 to let
+ * the system choose a free port (see @c tcpPort())
+ */
+bool FanoutServer::listen(const QHostAddress &address, const quint16 port,
+                          const Stream stream)
+{
+    QTcpServer *server = new QTcpServer(this);
+    if (!server->listen(address, port))
+    {
+        m_errorString = server->errorString();
+        delete server;
+        return false;
+    }
+
+    m_tcpServers.append(server);
+    m_listenerStreams.insert(server, stream);
+    connect(server, &QTcpServer::newConnection, this, &FanoutServer::onTcpConnection);
+    return true;
+}
+
+/**
+ * Serves @a stream on the local socket @a name (a Unix domain socket, or a
+ * named pipe on Windows), only accessible by the current user
+ */
+bool FanoutServer::listenLocal(const QString &name, const Stream stream)
+{
+    // Remove the socket file left behind by a previous instance that crashed
+    QLocalServer::removeServer(name);
+
+    QLocalServer *server = new QLocalServer(this);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!server->listen(name))
+    {
+        m_errorString = server->errorString();
+        delete server;
+        return false;
+    }
+
+    m_localServers.append(server);
+    m_listenerStreams.insert(server, stream);
+    connect(server, &QLocalServer::newConnection, this, &FanoutServer::onLocalConnection);
+    return true;
+}
+
+/**
+ * Stops listening & disconnects all the clients
+ */
+void FanoutServer::close()
+{
+    // The sockets are children of their server, remove them first
+    const auto clients = m_clients.values();
+    Q_FOREACH (Client *client, clients)
+        removeClient(client, false);
+
+    qDeleteAll(m_tcpServers);
+    qDeleteAll(m_localServers);
+    m_tcpServers.clear();
+    m_localServers.clear();
+    m_listenerStreams.clear();
+}
+
+//----------------------------------------------------------------------------------------
+// Configuration
+//----------------------------------------------------------------------------------------
+
+/**
+ * Republishes the data received by @a serial, @c Q_NULLPTR detaches the
+ * server from its current source
+ */
+void FanoutServer::setSource(Serial *serial)
+{
+    disconnect(m_sourceConnection);
+    m_deframer.reset();
+
+    if (serial)
+        m_sourceConnection = connect(serial, &Serial::dataAvailable, this,
+                                     &FanoutServer::onData, Qt::DirectConnection);
+}
+
+/**
+ * Changes how the received data is split into the frames of the frame
+ * stream, by default frames are lines
+ */
+void FanoutServer::setFraming(const Deframer::Configuration &config)
+{
+    m_deframer.setConfiguration(config);
+    checkFrameTimeout();
+}
+
+/**
+ * Changes the maximum number of connected clients (at least 1), further
+ * connections are refused. Clients that are already connected are kept even
+ * if there are more of them than the new limit.
+ */
+void FanoutServer::setMaxClients(const int clients)
+{
+    m_maxClients = qMax(clients, 1);
+}
+
+/**
+ * Changes the maximum number of bytes queued for a single client (at least
+ * 64 KB). Clients that are already connected get the new limit when the next
+ * chunk/frame is queued for them, the overflow policy is applied then.
+ */
+void FanoutServer::setMaxQueueBytes(const qint64 bytes)
+{
+    m_maxQueueBytes = qMax<qint64>(bytes, SOCKET_HIGH_WATER_MARK);
+}
+
+/**
+ * Changes what happens to a client whose queue exceeds the limit: its oldest
+ * chunks/frames are dropped or it is disconnected. Applies to the clients
+ * that are already connected from their next queued chunk/frame on.
+ */
+void FanoutServer::setOverflowPolicy(const OverflowPolicy policy)
+{
+    m_overflowPolicy = policy;
+}
+
+//----------------------------------------------------------------------------------------
+// Publishing
+//----------------------------------------------------------------------------------------
+
+/**
+ * Sends @a size bytes to the clients of the raw stream & feeds them to the
+ * deframer of the frame stream
+ */
+void FanoutServer::publish(const char *data, const int size)
+{
+    const RingBuffer::Span first = { data, size_t(qMax(size, 0)) };
+    const RingBuffer::Span second = { Q_NULLPTR, 0 };
+    onData(first, second);
+}
+
+/**
+ * Sends @a frame to the clients of the frame stream, preceded by its size
+ */
+void FanoutServer::publishFrame(const char *frame, const int size)
+{
+    ++m_statistics.publishedFrames;
+    if (m_streamClients[FrameStream] == 0 || size < 0)
+        return;
+
+    QByteArray message(int(sizeof(quint32)) + size, Qt::Uninitialized);
+    qToBigEndian<quint32>(quint32(size), reinterpret_cast<uchar *>(message.data()));
+    std::memcpy(message.data() + sizeof(quint32), frame, size_t(size));
+    enqueue(FrameStream, message);
+}
+
+/**
+ * Handles the data received by the source, copies it once for all the raw
+ * clients
+ */
+void FanoutServer::onData(const RingBuffer::Span &first, const RingBuffer::Span &second)
+{
+    const int size = int(first.size + second.size);
+    if (size <= 0)
+        return;
+
+    ++m_statistics.publishedChunks;
+    m_statistics.publishedBytes += quint64(size);
+
+    if (m_streamClients[RawStream] > 0)
+    {
+        QByteArray chunk(size, Qt::Uninitialized);
+        std::memcpy(chunk.data(), first.data, first.size);
+        if (second.size > 0)
+            std::memcpy(chunk.data() + first.size, second.data, second.size);
+
+        enqueue(RawStream, chunk);
+    }
+
+    if (m_streamClients[FrameStream] > 0)
+    {
+        const qint64 now = m_clock.nsecsElapsed() / 1000;
+        m_deframer.process(first.data, int(first.size), now);
+        if (second.size > 0)
+            m_deframer.process(second.data, int(second.size), now);
+    }
+}
+
+/**
+ * Appends @a chunk to the queue of every client of @a stream, sharing the
+ * same buffer, and applies the overflow policy
+ */
+void FanoutServer::enqueue(const Stream stream, const QByteArray &chunk)
+{
+    QVarLengthArray<Client *, 8> slowClients;
+
+    for (auto it = m_clients.constBegin(); it != m_clients.constEnd(); ++it)
+    {
+        Client *client = it.value();
+        if (client->stream != stream)
+            continue;
+
+        client->queue.enqueue(chunk);
+        client->queuedBytes += chunk.size();
+        pump(client);
+
+        if (client->queuedBytes <= m_maxQueueBytes)
+            continue;
+
+        if (m_overflowPolicy == Disconnect)
+        {
+            slowClients.append(client);
+            continue;
+        }
+
+        // Skip the client forward, whole chunks/frames at a time
+        while (client->queuedBytes > m_maxQueueBytes && client->queue.count() > 1)
+        {
+            const int dropped = client->queue.dequeue().size();
+            client->queuedBytes -= dropped;
+            ++m_statistics.droppedChunks;
+            m_statistics.droppedBytes += quint64(dropped);
+        }
+    }
+
+    for (int i = 0; i < slowClients.count(); ++i)
+    {
+        ++m_statistics.slowDisconnects;
+        m_statistics.droppedChunks += quint64(slowClients.at(i)->queue.count());
+        m_statistics.droppedBytes += quint64(slowClients.at(i)->queuedBytes);
+        removeClient(slowClients.at(i), true);
+    }
+}
+
+/**
+ * Moves queued chunks to the socket of @a client while its write buffer is
+ * below the high-water mark
+ */
+void FanoutServer::pump(Client *client)
+{
+    while (!client->queue.isEmpty()
+           && client->device->bytesToWrite() < SOCKET_HIGH_WATER_MARK)
+    {
+        const QByteArray chunk = client->queue.dequeue();
+        client->queuedBytes -= chunk.size();
+        if (client->device->write(chunk) != chunk.size())
+            break;
+    }
+}
+
+/**
+ * Runs the inter-character timeout of the frame stream while it has
+ * clients, only needed by the @c Deframer::Timeout mode
+ */
+void FanoutServer::checkFrameTimeout()
+{
+    const bool needed = m_deframer.configuration().mode == Deframer::Timeout
+                        && m_streamClients[FrameStream] > 0;
+
+    if (!needed)
+    {
+        m_timeoutTimer.stop();
+        return;
+    }
+
+    if (!m_timeoutTimer.isActive())
+        m_timeoutTimer.start();
+
+    m_deframer.checkTimeout(m_clock.nsecsElapsed() / 1000);
+}
+
+//----------------------------------------------------------------------------------------
+// Clients
+//----------------------------------------------------------------------------------------
+
+/**
+ * Accepts the pending TCP connections
+ */
+void FanoutServer::onTcpConnection()
+{
+    QTcpServer *server = qobject_cast<QTcpServer *>(sender());
+    if (!server)
+        return;
+
+    const Stream stream = m_listenerStreams.value(server);
+    while (server->hasPendingConnections())
+    {
+        QTcpSocket *socket = server->nextPendingConnection();
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(socket, &QTcpSocket::disconnected, this, &FanoutServer::onClientDisconnected);
+        addClient(socket, stream);
+    }
+}
+
+/**
+ * Accepts the pending local socket connections
+ */
+void FanoutServer::onLocalConnection()
+{
+    QLocalServer *server = qobject_cast<QLocalServer *>(sender());
+    if (!server)
+        return;
+
+    const Stream stream = m_listenerStreams.value(server);
+    while (server->hasPendingConnections())
+    {
+        QLocalSocket *socket = server->nextPendingConnection();
+        connect(socket, &QLocalSocket::disconnected, this,
+                &FanoutServer::onClientDisconnected);
+        addClient(socket, stream);
+    }
+}
+
+/**
+ * Registers a new client of @a stream, refuses it if the server is full
+ */
+void FanoutServer::addClient(QIODevice *device, const Stream stream)
+{
+    if (m_clients.count() >= m_maxClients)
+    {
+        device->disconnect(this);
+        device->close();
+        device->deleteLater();
+        return;
+    }
+
+    Client *client = new Client;
+    client->device = device;
+    client->stream = stream;
+    client->queuedBytes = 0;
+
+    m_clients.insert(device, client);
+    ++m_streamClients[stream];
+    ++m_statistics.connections;
+
+    connect(device, &QIODevice::readyRead, this, &FanoutServer::onClientReadyRead);
+    connect(device, &QIODevice::bytesWritten, this, &FanoutServer::onBytesWritten);
+
+    if (stream == FrameStream)
+        checkFrameTimeout();
+
+    Q_EMIT clientCountChanged(m_clients.count());
+}
+
+/**
+ * Forgets @a client & closes its socket, @a abort discards the data that
+ * the socket did not send yet
+ */
+void FanoutServer::removeClient(Client *client, const bool abort)
+{
+    QIODevice *device = client->device;
+    m_clients.remove(device);
+    --m_streamClients[client->stream];
+    delete client;
+
+    device->disconnect(this);
+    if (abort)
+    {
+        if (QTcpSocket *socket = qobject_cast<QTcpSocket *>(device))
+            socket->abort();
+        else if (QLocalSocket *socket = qobject_cast<QLocalSocket *>(device))
+            socket->abort();
+    }
+
+    device->close();
+    device->deleteLater();
+
+    checkFrameTimeout();
+    Q_EMIT clientCountChanged(m_clients.count());
+}
+
+void FanoutServer::onClientDisconnected()
+{
+    Client *client = m_clients.value(qobject_cast<QIODevice *>(sender()));
+    if (client)
+        removeClient(client, false);
+}
+
+/**
+ * Clients are read-only, discards what they send
+ */
+void FanoutServer::onClientReadyRead()
+{
+    QIODevice *device = qobject_cast<QIODevice *>(sender());
+    if (device)
+        device->readAll();
+}
+
+/**
+ * The socket of a client made room in its write buffer, refills it
+ */
+void FanoutServer::onBytesWritten()
+{
+    Client *client = m_clients.value(qobject_cast<QIODevice *>(sender()));
+    if (client)
+        pump(client);
+}
@@ -0,0 +1,144 @@
+#ifndef FANOUTSERVER_H
+#define FANOUTSERVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QQueue>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include "serial.h"
+#include "deframer.h"
+
+class QTcpServer;
+class QLocalServer;
+
+/**
+ * Republishes the data received by @c Serial to any number of local
+ * TCP/Unix-socket clients, so that several tools can watch the bus owned by
+ * this process.
+ *
+ * Each listener serves one of two streams:
+ * - @c RawStream: the received bytes, exactly as read from the port
+ * - @c FrameStream: the frames found by a @c Deframer (or published with
+ *   @c publishFrame()), each one preceded by its size as a 32-bit
+ *   big-endian integer
+ *
+ * Every chunk or frame is copied once into a @c QByteArray that is shared
+ * (implicitly, reference counted) by the queues of all the clients, so that
+ * N clients cost N references instead of N copies. The socket of a client
+ * is only fed up to a small high-water mark, the rest waits in its queue.
+ * When a queue exceeds @c maxQueueBytes() the client is either skipped
+ * forward (the oldest chunks are dropped, @c DropOldest) or disconnected
+ * (@c Disconnect); a slow consumer never blocks the port or the other
+ * clients.
+ *
+ * Clients are read-only, anything they send is discarded. The server runs
+ * on the thread of the @c Serial instance it is attached to.
+ */
+class FanoutServer : public QObject
+{
+    Q_OBJECT
+public:
+    enum Stream
+    {
+        RawStream,
+        FrameStream,
+    };
+    Q_ENUM(Stream)
+
+    enum OverflowPolicy
+    {
+        DropOldest,
+        Disconnect,
+    };
+    Q_ENUM(OverflowPolicy)
+
+    struct Statistics
+    {
+        quint64 connections;
+        quint64 slowDisconnects;
+        quint64 publishedChunks;
+        quint64 publishedBytes;
+        quint64 publishedFrames;
+        quint64 droppedChunks;
+        quint64 droppedBytes;
+    };
+
+    explicit FanoutServer(QObject *parent = nullptr);
+    ~FanoutServer();
+
+    bool isListening() const;
+    quint16 tcpPort(const Stream stream = RawStream) const;
+    QString errorString() const;
+
+    int clientCount() const;
+    int maxClients() const;
+    qint64 maxQueueBytes() const;
+    OverflowPolicy overflowPolicy() const;
+    const Statistics &statistics() const;
+
+    bool listen(const QHostAddress &address, const quint16 port,
+                const Stream stream = RawStream);
+    bool listenLocal(const QString &name, const Stream stream = RawStream);
+
+    void setSource(Serial *serial);
+    void setFraming(const Deframer::Configuration &config);
+
+Q_SIGNALS:
+    void clientCountChanged(const int count);
+
+public Q_SLOTS:
+    void close();
+    void setMaxClients(const int clients);
+    void setMaxQueueBytes(const qint64 bytes);
+    void setOverflowPolicy(const OverflowPolicy policy);
+
+    void publish(const char *data, const int size);
+    void publishFrame(const char *frame, const int size);
+
+private Q_SLOTS:
+    void onTcpConnection();
+    void onLocalConnection();
+    void onClientDisconnected();
+    void onClientReadyRead();
+    void onBytesWritten();
+    void checkFrameTimeout();
+
+private:
+    struct Client
+    {
+        QIODevice *device;
+        Stream stream;
+        QQueue<QByteArray> queue;
+        qint64 queuedBytes;
+    };
+
+    void addClient(QIODevice *device, const Stream stream);
+    void removeClient(Client *client, const bool abort);
+    void enqueue(const Stream stream, const QByteArray &chunk);
+    void pump(Client *client);
+    void onData(const RingBuffer::Span &first, const RingBuffer::Span &second);
+
+private:
+    QList<QTcpServer *> m_tcpServers;
+    QList<QLocalServer *> m_localServers;
+    QHash<QObject *, Stream> m_listenerStreams;
+    QHash<QIODevice *, Client *> m_clients;
+    int m_streamClients[2];
+    QString m_errorString;
+
+    int m_maxClients;
+    qint64 m_maxQueueBytes;
+    OverflowPolicy m_overflowPolicy;
+
+    QMetaObject::Connection m_sourceConnection;
+    Deframer m_deframer;
+    QElapsedTimer m_clock;
+    QTimer m_timeoutTimer;
+
+    Statistics m_statistics;
+};
+
+#endif // FANOUTSERVER_H
@@ -1,15 +1,42 @@
 #include "ccr.h"
 #include "ui_ccr.h"
 #include <QPainter>
+#include <QResizeEvent>
 #include <QDebug>
 #include <QBrush>
+#include <QSettings>
+#include <QDateTime>
+#include <QFileDialog>
+#include "Instrumentation.h"
+#include "Utilities.h"
+#include "Theme.h"
+
+/**
+ * 遥测历史保留的原始采样点数, 1 kHz 时约 17 分钟, 更早的数据只保留汇总值.
+ * 存储在收到第一组遥测值时才分配内存 (约 40 MB), 没有数据时不占用内存.
+ */
+static const int TELEMETRY_CAPACITY = 1 << 20;
+
+/**
+ * 数值标签的刷新间隔, 数据以线速率写入, 标签只需按人眼可读的频率更新
+ */
+static const int TELEMETRY_LABEL_INTERVAL_MS = 100;
+
+/**
+ * 数据转发服务的默认端口, 原始字节流使用该端口, 帧流使用下一个端口
+ */
+static const int FANOUT_DEFAULT_TCP_PORT = 5020;
 
 
 CCR::CCR(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::CCR),
-    m_serialSettings(new SettingsDialog(this)),
-    m_dataRcvWidget(new DataReveiveWidget)
+    m_serialSettings(Q_NULLPTR),
+    m_dataRcvWidget(Q_NULLPTR),
+    m_telemetryPlot(Q_NULLPTR),
+    m_fanoutServer(Q_NULLPTR),
+    m_telemetry(TelemetryChannelCount, TELEMETRY_CAPACITY),
+    m_displayedSamples(0)
 {
     ui->setupUi(this);
     resize(900, 600);
@@ -36,9 +63,15 @@ CCR &CCR::instance()
 void CCR::initActionsConnections()
 {
     connect(ui->actionexit, &QAction::triggered, this, &QMainWindow::close);
-    connect(ui->actionSerialConfig, &QAction::triggered, m_serialSettings, &SettingsDialog::show);
+    connect(ui->actionSerialConfig, &QAction::triggered, [=]()
+    {
+        settingsDialog()->show();
+    });
     connect(ui->actionconnect, &QAction::triggered, [=]()
     {
+        //对话框创建时会应用其中的串口参数, 接收窗口需要记录连接后的全部数据
+        settingsDialog();
+        dataReceiveWidget();
         if(Serial::instance().connectDevice())
         {
 
@@ -64,10 +97,237 @@ void CCR::initActionsConnections()
         m_labSerialStatus.setText(tr("disconnected"));
     });
     connect(ui->actionhomepage, &QAction::triggered, this, &CCR::backToHomepage);
+
+    //设备断开后的状态: 开启自动重连时等待设备重新插入, 否则恢复为未连接
+    connect(&Serial::instance(), &Serial::connectionError, this, [=](const QString &name)
+    {
+        if(Serial::instance().autoReconnect())
+        {
+            m_labSerialStatus.setText(tr("%1 连接中断, 等待设备重新连接...").arg(name));
+            return;
+        }
+
+        ui->actionconnect->setEnabled(true);
+        ui->actiondisconnect->setEnabled(false);
+        ui->actionSerialConfig->setEnabled(true);
+        m_labSerialStatus.setText(tr("%1 连接中断").arg(name));
+    });
+    connect(&Serial::instance(), &Serial::reconnected, this, [=](qint64 outageMs)
+    {
+        m_labSerialStatus.setText(tr("%1 已重新连接, 中断 %2 ms").arg(Serial::instance().portName())
+                                  .arg(outageMs));
+    });
+
+    //性能统计: 开启后每秒在状态栏刷新一次摘要, 关闭时各计数点只多一次判断
+    connect(ui->actionInstrumentation, &QAction::toggled, [=](bool checked)
+    {
+        Misc::Instrumentation::instance().setEnabled(checked);
+        QSettings().setValue("UI_Instrumentation__Enabled", checked);
+        if(checked)
+        {
+            Misc::Instrumentation::instance().reset();
+            m_timerInstrumentation.start(1000);
+            m_labInstrumentation.show();
+        }
+        else
+        {
+            m_timerInstrumentation.stop();
+            m_labInstrumentation.hide();
+        }
+    });
+    connect(&m_timerInstrumentation, &QTimer::timeout, [=]()
+    {
+        Misc::Instrumentation::instance().sample();
+        m_labInstrumentation.setText(Misc::Instrumentation::instance().summary());
+    });
+    connect(ui->actionDumpInstrumentation, &QAction::triggered, [=]()
+    {
+        const QString defaultName = QString("instrumentation-%1.txt")
+                .arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"));
+        const QString fileName = QFileDialog::getSaveFileName(this, tr("导出性能统计"), defaultName,
+                                                              tr("文本文件 (*.txt)"));
+        if(fileName.isEmpty())
+        {
+            return;
+        }
+
+        Misc::Instrumentation::instance().sample();
+        if(!Misc::Instrumentation::instance().dump(fileName))
+        {
+            Misc::Utilities::showMessageBox(tr("无法导出性能统计"), fileName);
+        }
+    });
+    //数据转发服务: 把接收到的数据转发给本机的其他程序, 只监听本机地址
+    connect(ui->actionFanoutServer, &QAction::triggered, [=](bool checked)
+    {
+        if(!setFanoutServerEnabled(checked))
+        {
+            ui->actionFanoutServer->setChecked(false);
+            Misc::Utilities::showMessageBox(tr("无法启动数据转发服务"),
+                                            m_fanoutServer->errorString());
+        }
+
+        QSettings().setValue("IO_Server__Enabled", ui->actionFanoutServer->isChecked());
+    });
     connect(ui->actiondataDisplay, &QAction::triggered, [=](bool checked)
     {
-        checked?m_dataRcvWidget->show():m_dataRcvWidget->hide();
+        checked?dataReceiveWidget()->show():dataReceiveWidget()->hide();
+    });
+    connect(ui->actionVisualization, &QAction::triggered, [=](bool checked)
+    {
+        checked?telemetryPlot()->show():telemetryPlot()->hide();
     });
+    connect(&m_timerTelemetry, &QTimer::timeout, this, &CCR::updateTelemetryLabels);
+}
+
+/**
+ * @brief CCR::telemetry
+ * 返回输出电流, 电压, 亮度级别和回路电阻的历史数据
+ */
+const TimeSeriesStore &CCR::telemetry() const
+{
+    return m_telemetry;
+}
+
+/**
+ * @brief CCR::appendTelemetry
+ * 记录一组解码后的遥测值, 由协议解析在 GUI 线程调用, 时间戳单位为微秒.
+ * 只写入历史数据, 数值标签由定时器统一刷新
+ */
+void CCR::appendTelemetry(qint64 timestampUs, float current, float voltage,
+                          float brightnessStep, float loopResistance)
+{
+    float values[TelemetryChannelCount];
+    values[OutputCurrent] = current;
+    values[OutputVoltage] = voltage;
+    values[BrightnessStep] = brightnessStep;
+    values[LoopResistance] = loopResistance;
+    m_telemetry.append(timestampUs, values);
+
+    if(!m_timerTelemetry.isActive())
+    {
+        m_timerTelemetry.start(TELEMETRY_LABEL_INTERVAL_MS);
+    }
+}
+
+/**
+ * @brief CCR::updateTelemetryLabels
+ * 用最新的遥测值刷新数值标签, 没有新数据时停止定时器
+ */
+void CCR::updateTelemetryLabels()
+{
+    if(m_telemetry.sampleCount() == m_displayedSamples)
+    {
+        m_timerTelemetry.stop();
+        return;
+    }
+
+    m_displayedSamples = m_telemetry.sampleCount();
+    ui->labCurrent->setNum(m_telemetry.lastValue(OutputCurrent));
+    ui->labVoltage->setNum(m_telemetry.lastValue(OutputVoltage));
+    ui->labIdensity->setNum(m_telemetry.lastValue(BrightnessStep));
+    ui->labRL->setNum(m_telemetry.lastValue(LoopResistance));
+}
+
+/**
+ * @brief CCR::settingsDialog
+ * 串口参数对话框在第一次使用时才创建
+ */
+SettingsDialog *CCR::settingsDialog()
+{
+    if(m_serialSettings == Q_NULLPTR)
+    {
+        m_serialSettings = new SettingsDialog(this);
+    }
+
+    return m_serialSettings;
+}
+
+/**
+ * @brief CCR::dataReceiveWidget
+ * 数据报文窗口在第一次显示或第一次连接串口时才创建
+ */
+DataReveiveWidget *CCR::dataReceiveWidget()
+{
+    if(m_dataRcvWidget == Q_NULLPTR)
+    {
+        m_dataRcvWidget = new DataReveiveWidget;
+    }
+
+    return m_dataRcvWidget;
+}
+
+/**
+ * @brief CCR::telemetryPlot
+ * 电流/电压曲线窗口在第一次显示时才创建, 隐藏时停止刷新
+ */
+TelemetryPlot *CCR::telemetryPlot()
+{
+    if(m_telemetryPlot == Q_NULLPTR)
+    {
+        m_telemetryPlot = new TelemetryPlot(&m_telemetry, this);
+        m_telemetryPlot->setWindowFlags(Qt::Window);
+        m_telemetryPlot->setWindowTitle(tr("数据可视化"));
+        m_telemetryPlot->resize(900, 360);
+        m_telemetryPlot->addChannel(OutputCurrent, QColor(255, 160, 40));
+        m_telemetryPlot->addChannel(OutputVoltage, QColor(60, 190, 255));
+        m_telemetryPlot->setWindowSpan(QSettings().value("UI_Visualization__WindowSpan",
+                                                         m_telemetryPlot->windowSpan()).toLongLong());
+        connect(m_telemetryPlot, &TelemetryPlot::windowSpanChanged, [=](qint64 us)
+        {
+            QSettings().setValue("UI_Visualization__WindowSpan", us);
+        });
+    }
+
+    return m_telemetryPlot;
+}
+
+/**
+ * @brief CCR::setFanoutServerEnabled
+ * 启动或停止数据转发服务. 原始字节流和解析后的帧分别在两个本机 TCP 端口
+ * 和两个本地套接字上提供, 慢速客户端跳过旧数据, 不会阻塞串口.
+ */
+bool CCR::setFanoutServerEnabled(bool enabled)
+{
+    if(m_fanoutServer == Q_NULLPTR)
+    {
+        m_fanoutServer = new FanoutServer(this);
+        connect(m_fanoutServer, &FanoutServer::clientCountChanged, this, [=](int count)
+        {
+            m_labFanoutServer.setText(tr("转发端口 %1, 客户端 %2")
+                                      .arg(m_fanoutServer->tcpPort()).arg(count));
+        });
+    }
+
+    m_fanoutServer->close();
+    m_fanoutServer->setSource(Q_NULLPTR);
+    m_labFanoutServer.hide();
+    if(!enabled)
+    {
+        return true;
+    }
+
+    QSettings settings;
+    // 帧流使用下一个端口, 配置的端口必须在 1..65534 之间
+    bool valid = false;
+    const uint configuredPort = settings.value("IO_Server__TcpPort", FANOUT_DEFAULT_TCP_PORT).toUInt(&valid);
+    const quint16 port = valid && configuredPort >= 1 && configuredPort < 65535
+            ? quint16(configuredPort) : quint16(FANOUT_DEFAULT_TCP_PORT);
+    const QString name = settings.value("IO_Server__LocalName", "serialtool").toString();
+    const bool ok = m_fanoutServer->listen(QHostAddress::LocalHost, port, FanoutServer::RawStream)
+            && m_fanoutServer->listen(QHostAddress::LocalHost, port + 1, FanoutServer::FrameStream)
+            && m_fanoutServer->listenLocal(name, FanoutServer::RawStream)
+            && m_fanoutServer->listenLocal(name + "-frames", FanoutServer::FrameStream);
+    if(!ok)
+    {
+        m_fanoutServer->close();
+        return false;
+    }
+
+    m_fanoutServer->setSource(&Serial::instance());
+    m_labFanoutServer.setText(tr("转发端口 %1, 客户端 %2").arg(port).arg(0));
+    m_labFanoutServer.show();
+    return true;
 }
 
 void CCR::initUi()
@@ -86,6 +346,22 @@ void CCR::initUi()
     ui->actionconnect->setEnabled(true);
     ui->actiondisconnect->setEnabled(false);
 
+    m_labInstrumentation.hide();
+    ui->statusbar->addPermanentWidget(&m_labInstrumentation);
+    ui->actionInstrumentation->setChecked(QSettings().value("UI_Instrumentation__Enabled", false).toBool());
+
+    m_labFanoutServer.hide();
+    ui->statusbar->addPermanentWidget(&m_labFanoutServer);
+    if(QSettings().value("IO_Server__Enabled", false).toBool())
+    {
+        ui->actionFanoutServer->setChecked(setFanoutServerEnabled(true));
+    }
+
+    m_telemetry.setChannelName(OutputCurrent, tr("输出电流"));
+    m_telemetry.setChannelName(OutputVoltage, tr("输出电压"));
+    m_telemetry.setChannelName(BrightnessStep, tr("亮度级别"));
+    m_telemetry.setChannelName(LoopResistance, tr("回路电阻"));
+
     this->setWindowTitle(tr("恒流控制器"));
     this->setWindowIcon(QIcon(":/images/tbtn1.png"));
 
@@ -93,11 +369,20 @@ void CCR::initUi()
 
 /**
  * @brief CCR::paintEvent
- * 绘制背景图片
+ * 绘制背景图片, 图片只解码一次并按窗口大小缓存
  */
 void CCR::paintEvent(QPaintEvent *)
 {
     QPainter painter(this);
-    QPixmap pixmap(":/images/background.png");
-    painter.drawPixmap(rect(), pixmap, QRect());
+    Misc::Theme::drawBackground(&painter, this);
+}
+
+/**
+ * @brief CCR::resizeEvent
+ * 窗口大小改变后释放旧尺寸的背景缓存
+ */
+void CCR::resizeEvent(QResizeEvent *event)
+{
+    Misc::Theme::releaseBackground(this, event->oldSize());
+    QMainWindow::resizeEvent(event);
 }
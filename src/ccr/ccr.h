@@ -4,7 +4,11 @@
 #include <QMainWindow>
 #include "settingsdialog.h"
 #include <QLabel>
+#include <QTimer>
 #include "datareveivewidget.h"
+#include "timeseriesstore.h"
+#include "telemetryplot.h"
+#include "fanoutserver.h"
 namespace Ui {
 class CCR;
 }
@@ -18,6 +22,25 @@ public:
     ~CCR();
     static  CCR &instance(void);
     QMainWindow * m_homepage;
+
+    /**
+     * 遥测通道, 即 @c TimeSeriesStore 中各列的顺序
+     */
+    enum TelemetryChannel
+    {
+        OutputCurrent,
+        OutputVoltage,
+        BrightnessStep,
+        LoopResistance,
+        TelemetryChannelCount
+    };
+
+    const TimeSeriesStore &telemetry(void) const;
+
+public Q_SLOTS:
+    void appendTelemetry(qint64 timestampUs, float current, float voltage,
+                         float brightnessStep, float loopResistance);
+
 Q_SIGNALS:
     void backToHomepage(void);
 
@@ -25,10 +48,24 @@ private:
     Ui::CCR *ui;
     SettingsDialog *m_serialSettings;
     DataReveiveWidget *m_dataRcvWidget;
+    TelemetryPlot *m_telemetryPlot;
     QLabel m_labSerialStatus;
+    QLabel m_labInstrumentation;
+    QTimer m_timerInstrumentation;
+    QLabel m_labFanoutServer;
+    FanoutServer *m_fanoutServer;
+    TimeSeriesStore m_telemetry;
+    QTimer m_timerTelemetry;
+    quint64 m_displayedSamples;
+    SettingsDialog *settingsDialog(void);
+    DataReveiveWidget *dataReceiveWidget(void);
+    TelemetryPlot *telemetryPlot(void);
+    bool setFanoutServerEnabled(bool enabled);
     void initActionsConnections(void);
     void initUi(void);
+    void updateTelemetryLabels(void);
      void paintEvent(QPaintEvent *)Q_DECL_OVERRIDE;
+     void resizeEvent(QResizeEvent *event)Q_DECL_OVERRIDE;
 };
 
 #endif // CCR_H
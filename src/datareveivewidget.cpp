@@ -1,12 +1,26 @@
 #include "datareveivewidget.h"
 #include "ui_datareveivewidget.h"
+#include "Utilities.h"
 #include <QDateTime>
+#include <QScrollBar>
+#include <QFileDialog>
+
+//接收区默认保留的数据量
+static const quint64 DEFAULT_LOG_MAX_BYTES = 64 * 1024 * 1024;
+static const quint64 DEFAULT_LOG_MAX_LINES = 1000000;
+
+//浏览捕获文件时每页显示的数据量, 以及进度条的刻度数
+static const qint64 CAPTURE_PAGE_BYTES = 256 * 1024;
+static const int CAPTURE_SLIDER_STEPS = 10000;
 
 DataReveiveWidget::DataReveiveWidget(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::DataReveiveWidget),
     m_receivedBytes(0),
-    m_dataAreaDispalyTime(false)
+    m_dataAreaDispalyTime(false),
+    m_captureReplay(&Serial::instance()),
+    m_pageOffset(0),
+    m_nextPageOffset(0)
 {
     ui->setupUi(this);
     initUi();
@@ -17,6 +31,8 @@ DataReveiveWidget::DataReveiveWidget(QWidget *parent) :
 
 DataReveiveWidget::~DataReveiveWidget()
 {
+    Serial::instance().setCaptureWriter(Q_NULLPTR);
+    m_captureWriter.close();
     delete ui;
 }
 
@@ -24,32 +40,91 @@ void DataReveiveWidget::initUi()
 {
     this->setWindowTitle(tr("数据报文"));
     this->setWindowIcon(QIcon(":/images/dataReceive.png"));
+
+    //接收区只保留有限的数据, 超出后丢弃最早的数据块
+    m_logModel.setMaxBytes(m_settings.value("UI_DataReceive__MaxBytes", DEFAULT_LOG_MAX_BYTES).toULongLong());
+    m_logModel.setMaxLines(m_settings.value("UI_DataReceive__MaxLines", DEFAULT_LOG_MAX_LINES).toULongLong());
+    ui->listViewLog->setModel(&m_logModel);
+
+    //显示模式(ASCII/HEX/HEX+ASCII), 切换时由已保存的原始数据重新生成
+    ui->comboBoxDisplayMode->addItems(Serial::instance().displayModeList());
+    ui->comboBoxDisplayMode->setCurrentIndex(Serial::instance().displayMode());
+    m_logModel.setDisplayMode(Misc::HexDump::Mode(Serial::instance().displayMode()));
 }
 
 void DataReveiveWidget::initActions()
 {
-    connect(&Serial::instance(), &Serial::dataReceived, [=](QByteArray data)
+    //批量刷新显示, 刷新频率与数据块速率无关
+    m_renderScheduler.setMaxRate(m_settings.value("UI_DataReceive__RefreshRate", 30).toInt());
+    connect(&m_renderScheduler, &RenderScheduler::flushed,
+            this, &DataReveiveWidget::onDataFlushed);
+
+    connect(ui->comboBoxDisplayMode, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            [=](int index)
     {
-        if(m_dataAreaDispalyTime)
+        if(index >= 0)
         {
-            QString time = QTime::currentTime().toString("hh:mm:ss");
-            ui->textEdit->append(time);
+            Serial::instance().setDisplayMode(quint8(index));
         }
-        ui->textEdit->append(data);
-        m_receivedBytes +=data.size();
-        ui->lineEditRcvCounts->setText(QString::number(m_receivedBytes));
+    });
+    connect(&Serial::instance(), &Serial::displayModeChanged, this, [=]()
+    {
+        ui->comboBoxDisplayMode->setCurrentIndex(Serial::instance().displayMode());
+        m_logModel.setDisplayMode(Misc::HexDump::Mode(Serial::instance().displayMode()));
+    });
+
+    //拖动进度条或输入时间, 跳转到捕获文件的对应位置
+    ui->sliderCapture->setRange(0, CAPTURE_SLIDER_STEPS);
+    connect(ui->sliderCapture, &QSlider::valueChanged,
+            this, &DataReveiveWidget::onCaptureSliderChanged);
+    connect(ui->dateTimeEditCapture, &QDateTimeEdit::editingFinished,
+            this, &DataReveiveWidget::onCaptureDateTimeEdited);
+    connect(&m_captureReplay, &CaptureReplay::finished,
+            this, &DataReveiveWidget::onReplayFinished);
+
+    connect(&Serial::instance(), &Serial::dataAvailable, this,
+            [=](const RingBuffer::Span &first, const RingBuffer::Span &second)
+    {
+        m_renderScheduler.append(first.data, int(first.size));
+        m_renderScheduler.append(second.data, int(second.size));
     });
 
 }
 
+/**
+ * @brief DataReveiveWidget::onDataFlushed
+ * 将一批接收数据显示到界面, 并更新接收计数
+ */
+void DataReveiveWidget::onDataFlushed(const QByteArray &data)
+{
+    m_receivedBytes +=data.size();
+    ui->lineEditRcvCounts->setText(QString::number(m_receivedBytes));
+
+    //浏览捕获文件时只计数, 不刷新显示
+    if(m_captureReader.isOpen())
+    {
+        return;
+    }
+
+    //视图在底部时自动滚动
+    QScrollBar *scrollBar = ui->listViewLog->verticalScrollBar();
+    const bool atBottom = scrollBar->value() == scrollBar->maximum();
+    m_logModel.append(data);
+    if(atBottom)
+    {
+        ui->listViewLog->scrollToBottom();
+    }
+}
+
 void DataReveiveWidget::on_checkBoxShowTime_clicked(bool checked)
 {
      m_dataAreaDispalyTime = checked?true:false;
+     m_logModel.setShowTimestamps(m_dataAreaDispalyTime);
 }
 
 void DataReveiveWidget::on_btnClearArea_clicked()
 {
-    ui->textEdit->clear();
+    m_logModel.clear();
 }
 
 void DataReveiveWidget::on_btnRcvClear_clicked()
@@ -57,3 +132,234 @@ void DataReveiveWidget::on_btnRcvClear_clicked()
     m_receivedBytes =0;
     ui->lineEditRcvCounts->setText(QString::number(m_receivedBytes));
 }
+
+/**
+ * @brief DataReveiveWidget::on_checkBoxCapture_clicked
+ * 开始/停止将收发数据录制到二进制捕获文件, 写盘在后台线程进行
+ */
+void DataReveiveWidget::on_checkBoxCapture_clicked(bool checked)
+{
+    if(!checked)
+    {
+        Serial::instance().setCaptureWriter(Q_NULLPTR);
+        m_captureWriter.close();
+        return;
+    }
+
+    const QString defaultName = QString("capture-%1.qcap")
+            .arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"));
+    const QString fileName = QFileDialog::getSaveFileName(this, tr("保存捕获文件"), defaultName,
+                                                          tr("捕获文件 (*.qcap)"));
+    if(fileName.isEmpty())
+    {
+        ui->checkBoxCapture->setChecked(false);
+        return;
+    }
+
+    m_captureWriter.setSyncPolicy(CaptureWriter::SyncPolicy(
+            m_settings.value("UI_DataReceive__CaptureSync", CaptureWriter::SyncPeriodic).toInt()));
+    if(!m_captureWriter.open(fileName))
+    {
+        ui->checkBoxCapture->setChecked(false);
+        Misc::Utilities::showMessageBox(tr("无法创建捕获文件"), m_captureWriter.errorString());
+        return;
+    }
+
+    Serial::instance().setCaptureWriter(&m_captureWriter);
+}
+
+/**
+ * @brief DataReveiveWidget::on_btnOpenCapture_clicked
+ * 以内存映射方式打开捕获文件, 只读取文件头和索引, 与文件大小无关
+ */
+void DataReveiveWidget::on_btnOpenCapture_clicked()
+{
+    const QString fileName = QFileDialog::getOpenFileName(this, tr("打开捕获文件"), QString(),
+                                                          tr("捕获文件 (*.qcap)"));
+    if(fileName.isEmpty())
+    {
+        return;
+    }
+
+    if(!m_captureReader.open(fileName))
+    {
+        Misc::Utilities::showMessageBox(tr("无法打开捕获文件"), m_captureReader.errorString());
+        return;
+    }
+
+    const qint64 endTimeMs = m_captureReader.startTimeMs()
+            + qint64(m_captureReader.durationNs() / 1000000);
+    ui->dateTimeEditCapture->setDateTimeRange(
+            QDateTime::fromMSecsSinceEpoch(m_captureReader.startTimeMs()),
+            QDateTime::fromMSecsSinceEpoch(endTimeMs));
+
+    ui->sliderCapture->setEnabled(true);
+    ui->dateTimeEditCapture->setEnabled(true);
+    ui->btnLiveView->setEnabled(true);
+    ui->btnReplay->setEnabled(true);
+    loadCapturePage(m_captureReader.firstOffset());
+}
+
+void DataReveiveWidget::on_btnPrevPage_clicked()
+{
+    loadCapturePage(m_captureReader.rewind(m_pageOffset, CAPTURE_PAGE_BYTES));
+}
+
+void DataReveiveWidget::on_btnNextPage_clicked()
+{
+    loadCapturePage(m_nextPageOffset);
+}
+
+/**
+ * @brief DataReveiveWidget::on_btnLiveView_clicked
+ * 关闭捕获文件, 恢复显示实时数据
+ */
+void DataReveiveWidget::on_btnLiveView_clicked()
+{
+    m_captureReader.close();
+    m_logModel.clear();
+
+    ui->btnPrevPage->setEnabled(false);
+    ui->btnNextPage->setEnabled(false);
+    ui->sliderCapture->setEnabled(false);
+    ui->dateTimeEditCapture->setEnabled(false);
+    ui->btnLiveView->setEnabled(false);
+    ui->btnReplay->setEnabled(m_captureReplay.isRunning());
+}
+
+void DataReveiveWidget::onCaptureSliderChanged(int value)
+{
+    if(!m_captureReader.isOpen())
+    {
+        return;
+    }
+
+    const quint64 timestamp = m_captureReader.durationNs() / CAPTURE_SLIDER_STEPS * quint64(value);
+    loadCapturePage(m_captureReader.seek(timestamp));
+}
+
+void DataReveiveWidget::onCaptureDateTimeEdited()
+{
+    if(!m_captureReader.isOpen())
+    {
+        return;
+    }
+
+    const qint64 ms = ui->dateTimeEditCapture->dateTime().toMSecsSinceEpoch()
+            - m_captureReader.startTimeMs();
+    loadCapturePage(m_captureReader.seek(quint64(qMax(ms, qint64(0))) * 1000000));
+}
+
+/**
+ * @brief DataReveiveWidget::loadCapturePage
+ * 显示捕获文件中从 offset 开始的一页接收数据, 数据直接从映射的文件中读取
+ */
+void DataReveiveWidget::loadCapturePage(qint64 offset)
+{
+    m_logModel.clear();
+
+    CaptureReader::Record record;
+    qint64 position = offset;
+    qint64 bytes = 0;
+    while(bytes < CAPTURE_PAGE_BYTES && m_captureReader.read(position, record))
+    {
+        if(record.direction == Capture::Received)
+        {
+            m_logModel.append(record.data, int(record.size),
+                              m_captureReader.startTimeMs() + qint64(record.timestampNs / 1000000));
+            bytes += record.size;
+        }
+        position += sizeof(Capture::RecordHeader) + record.size;
+    }
+
+    m_pageOffset = offset;
+    m_nextPageOffset = position;
+    ui->listViewLog->scrollToTop();
+    ui->btnPrevPage->setEnabled(offset > m_captureReader.firstOffset());
+    ui->btnNextPage->setEnabled(position < m_captureReader.endOffset());
+
+    //同步进度条和时间, 不触发跳转
+    if(m_captureReader.read(offset, record))
+    {
+        const QSignalBlocker sliderBlocker(ui->sliderCapture);
+        const QSignalBlocker dateTimeBlocker(ui->dateTimeEditCapture);
+        const quint64 duration = qMax(m_captureReader.durationNs(), quint64(1));
+        ui->sliderCapture->setValue(int(record.timestampNs * double(CAPTURE_SLIDER_STEPS) / duration));
+        ui->dateTimeEditCapture->setDateTime(QDateTime::fromMSecsSinceEpoch(
+                m_captureReader.startTimeMs() + qint64(record.timestampNs / 1000000)));
+    }
+}
+
+/**
+ * @brief DataReveiveWidget::on_btnReplay_clicked
+ * 从当前页开始回放捕获文件, 数据经 Serial 送入与实时数据相同的处理流程
+ */
+void DataReveiveWidget::on_btnReplay_clicked(bool checked)
+{
+    if(!checked)
+    {
+        m_captureReplay.stop();
+        return;
+    }
+
+    if(!m_captureReplay.open(m_captureReader.fileName()))
+    {
+        ui->btnReplay->setChecked(false);
+        Misc::Utilities::showMessageBox(tr("无法打开捕获文件"), m_captureReplay.errorString());
+        return;
+    }
+
+    switch(ui->comboBoxReplaySpeed->currentIndex())
+    {
+    case 1:
+        m_captureReplay.setMode(CaptureReplay::ScaledSpeed);
+        m_captureReplay.setSpeed(2);
+        break;
+    case 2:
+        m_captureReplay.setMode(CaptureReplay::ScaledSpeed);
+        m_captureReplay.setSpeed(10);
+        break;
+    case 3:
+        m_captureReplay.setMode(CaptureReplay::AsFastAsPossible);
+        break;
+    default:
+        m_captureReplay.setMode(CaptureReplay::OriginalSpeed);
+        break;
+    }
+
+    //切换回实时显示, 回放的数据与实时数据走同一路径
+    const qint64 offset = m_pageOffset;
+    on_btnLiveView_clicked();
+    ui->btnReplay->setText(tr("停止回放"));
+    ui->labelReplayStatus->setText(tr("正在回放..."));
+    m_captureReplay.start(offset);
+
+    //实时显示处理会按回放状态设置按钮, 回放开始后才能停止
+    ui->btnReplay->setEnabled(m_captureReplay.isRunning());
+}
+
+/**
+ * @brief DataReveiveWidget::onReplayFinished
+ * 显示回放的吞吐量和时间精度
+ */
+void DataReveiveWidget::onReplayFinished()
+{
+    const CaptureReplay::Statistics stats = m_captureReplay.statistics();
+    QString text = tr("回放 %1 字节, 用时 %2 ms, %3 MB/s")
+            .arg(stats.bytes)
+            .arg(stats.elapsedUs / 1000)
+            .arg(stats.throughput / 1e6, 0, 'f', 2);
+    if(m_captureReplay.mode() != CaptureReplay::AsFastAsPossible)
+    {
+        text += tr(", 时间偏差 平均 %1 us / P99 %2 us / 最大 %3 us")
+                .arg(stats.meanLatenessUs)
+                .arg(stats.p99LatenessUs)
+                .arg(stats.maxLatenessUs);
+    }
+
+    ui->labelReplayStatus->setText(text);
+    ui->btnReplay->setChecked(false);
+    ui->btnReplay->setText(tr("回放"));
+    ui->btnReplay->setEnabled(m_captureReader.isOpen());
+    m_captureReplay.close();
+}
@@ -2,7 +2,13 @@
 #define DATAREVEIVEWIDGET_H
 
 #include <QWidget>
+#include <QSettings>
 #include "serial.h"
+#include "renderscheduler.h"
+#include "receivelogmodel.h"
+#include "capturewriter.h"
+#include "capturereader.h"
+#include "capturereplay.h"
 namespace Ui {
 class DataReveiveWidget;
 }
@@ -21,13 +27,42 @@ private slots:
 
     void on_btnRcvClear_clicked();
 
+    void on_checkBoxCapture_clicked(bool checked);
+
+    void on_btnOpenCapture_clicked();
+
+    void on_btnPrevPage_clicked();
+
+    void on_btnNextPage_clicked();
+
+    void on_btnLiveView_clicked();
+
+    void onCaptureSliderChanged(int value);
+
+    void onCaptureDateTimeEdited();
+
+    void on_btnReplay_clicked(bool checked);
+
+    void onReplayFinished();
+
+    void onDataFlushed(const QByteArray &data);
+
 private:
     void initUi(void);
     void initActions(void);
+    void loadCapturePage(qint64 offset);
 private:
     Ui::DataReveiveWidget *ui;
     quint64 m_receivedBytes;
     bool m_dataAreaDispalyTime;
+    QSettings m_settings;
+    RenderScheduler m_renderScheduler;
+    ReceiveLogModel m_logModel;
+    CaptureWriter m_captureWriter;
+    CaptureReader m_captureReader;
+    CaptureReplay m_captureReplay;
+    qint64 m_pageOffset;
+    qint64 m_nextPageOffset;
 };
 
 #endif // DATAREVEIVEWIDGET_H
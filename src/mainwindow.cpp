@@ -2,11 +2,16 @@
 #include "ui_mainwindow.h"
 #include <QFile>
 #include <QPainter>
+#include <QResizeEvent>
 #include <QDebug>
+#include <QTimer>
+#include "StartupTrace.h"
+#include "Theme.h"
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
-    , m_ccr(new CCR(this))
+    , m_ccr(Q_NULLPTR)
+    , m_firstPaint(true)
 {
     ui->setupUi(this);
     setWindowTitle(tr("助航灯调试上位机V1.0"));
@@ -15,12 +20,7 @@ MainWindow::MainWindow(QWidget *parent)
     initToolButton();
     connect(ui->tBtnCCR, &QToolButton::clicked, [=](){
         this->hide();
-        m_ccr->show();
-    });
-
-    connect(m_ccr, &CCR::backToHomepage, [=](){
-        m_ccr->hide();
-        this->show();
+        ccr()->show();
     });
 }
 
@@ -30,6 +30,34 @@ MainWindow::~MainWindow()
     qDebug()<<"mainwindow destroyed1";
 }
 
+/**
+ * @brief MainWindow::resizeEvent
+ * 窗口大小改变后释放旧尺寸的背景缓存
+ */
+void MainWindow::resizeEvent(QResizeEvent *event)
+{
+    Misc::Theme::releaseBackground(this, event->oldSize());
+    QMainWindow::resizeEvent(event);
+}
+
+/**
+ * @brief MainWindow::ccr
+ * 调光器页面在第一次使用时才创建, 不占用启动时间
+ */
+CCR *MainWindow::ccr()
+{
+    if(m_ccr == Q_NULLPTR)
+    {
+        m_ccr = new CCR(this);
+        connect(m_ccr, &CCR::backToHomepage, [=](){
+            m_ccr->hide();
+            this->show();
+        });
+    }
+
+    return m_ccr;
+}
+
 /**
  * @brief MainWindow::initToolButton
  * 初始化主界面工具按钮控件
@@ -62,11 +90,26 @@ void MainWindow::initToolButton()
     }
 }
 
+/**
+ * @brief MainWindow::paintEvent
+ * 绘制背景和标题图片, 图片只解码一次并按窗口大小缓存
+ */
 void MainWindow::paintEvent(QPaintEvent *)
 {
     QPainter painter(this);
-    QPixmap pixmap(":/images/background.png");
-    painter.drawPixmap(rect(), pixmap, QRect());
-    QPixmap pixmapTitle(":/images/title.png");
-    painter.drawPixmap(QRect(QPoint(0, 0), QPoint(900, 100)), pixmapTitle, QRect());
+    Misc::Theme::drawBackground(&painter, this);
+    const QRect titleRect(QPoint(0, 0), QPoint(900, 100));
+    painter.drawPixmap(titleRect.topLeft(),
+                       Misc::Theme::pixmap(":/images/title.png", titleRect.size(), devicePixelRatioF()));
+
+    //第一帧绘制完成后输出启动各阶段耗时, 然后在后台开始枚举串口
+    if(m_firstPaint)
+    {
+        m_firstPaint = false;
+        Misc::StartupTrace::mark("first paint");
+        QTimer::singleShot(0, [](){
+            Misc::StartupTrace::finish();
+            Serial::instance();
+        });
+    }
 }
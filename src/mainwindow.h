@@ -19,7 +19,10 @@ public:
 private:
     Ui::MainWindow *ui;
     CCR * m_ccr;
+    bool m_firstPaint;
+    CCR *ccr(void);
     void initToolButton(void);
     void paintEvent(QPaintEvent *)Q_DECL_OVERRIDE;
+    void resizeEvent(QResizeEvent *event)Q_DECL_OVERRIDE;
 };
 #endif // MAINWINDOW_H
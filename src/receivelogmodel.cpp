@@ -0,0 +1,273 @@
+#include "receivelogmodel.h"
+#include <QDateTime>
+
+/**
+ * Constructor function
+ */
+ReceiveLogModel::ReceiveLogModel(QObject *parent) : QAbstractListModel(parent)
+    , m_showTimestamps(false)
+    , m_displayMode(Misc::HexDump::Ascii)
+    , m_firstRow(0)
+    , m_rowCount(0)
+{
+}
+
+/**
+ * Returns the number of lines published to the views
+ */
+int ReceiveLogModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return m_rowCount;
+}
+
+/**
+ * Renders the line/hex row at @a index
+ */
+QVariant ReceiveLogModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rowCount)
+        return QVariant();
+
+    if (role != Qt::DisplayRole && role != TimestampRole)
+        return QVariant();
+
+    const quint64 row = m_firstRow + quint64(index.row());
+
+    QString text;
+    qint64 timestamp = 0;
+    if (m_displayMode == Misc::HexDump::Ascii)
+    {
+        timestamp = m_store.lineTimestamp(row);
+        if (role == Qt::DisplayRole)
+            text = QString::fromUtf8(m_store.line(row));
+    }
+    else
+    {
+        // Hex rows are aligned to absolute offsets, the oldest one may be partial
+        const quint64 offset = qMax(row * Misc::HexDump::BytesPerRow, m_store.firstOffset());
+        timestamp = m_store.timestampAt(offset);
+        if (role == Qt::DisplayRole)
+        {
+            char bytes[Misc::HexDump::BytesPerRow];
+            const int count = int((row + 1) * Misc::HexDump::BytesPerRow - offset);
+            const int size = m_store.read(offset, bytes, count);
+            text = QString::fromLatin1(Misc::HexDump::formatRow(offset, bytes, size, m_displayMode));
+        }
+    }
+
+    if (role == TimestampRole)
+        return QDateTime::fromMSecsSinceEpoch(timestamp);
+
+    if (!m_showTimestamps)
+        return text;
+
+    const QDateTime time = QDateTime::fromMSecsSinceEpoch(timestamp);
+    return QString("%1  %2").arg(time.toString("hh:mm:ss.zzz"), text);
+}
+
+/**
+ * Returns the number of bytes retained by the log
+ */
+quint64 ReceiveLogModel::byteCount() const
+{
+    return m_store.byteCount();
+}
+
+/**
+ * Returns @c true if every line is prefixed with its reception time
+ */
+bool ReceiveLogModel::showTimestamps() const
+{
+    return m_showTimestamps;
+}
+
+/**
+ * Returns the maximum number of retained bytes, 0 means unlimited
+ */
+quint64 ReceiveLogModel::maxBytes() const
+{
+    return m_store.maxBytes();
+}
+
+/**
+ * Returns the maximum number of retained lines, 0 means unlimited
+ */
+quint64 ReceiveLogModel::maxLines() const
+{
+    return m_store.maxLines();
+}
+
+/**
+ * Returns the way in which the received bytes are rendered
+ */
+Misc::HexDump::Mode ReceiveLogModel::displayMode() const
+{
+    return m_displayMode;
+}
+
+/**
+ * Appends the received @a data to the log & evicts the oldest data if the
+ * retention limits are exceeded.
+ */
+void ReceiveLogModel::append(const QByteArray &data)
+{
+    append(data.constData(), data.size(), QDateTime::currentMSecsSinceEpoch());
+}
+
+/**
+ * Appends @a size bytes of @a data received at @a timestamp (ms since epoch),
+ * used to show recorded data with its original reception time.
+ */
+void ReceiveLogModel::append(const char *data, const int size, const qint64 timestamp)
+{
+    if (size <= 0)
+        return;
+
+    // The last published line may grow if it was not terminated, remember
+    // its absolute index since trimming shifts the rows
+    const bool hadRows = m_rowCount > 0;
+    const quint64 lastRow = m_firstRow + quint64(m_rowCount) - 1;
+
+    m_store.append(data, size, timestamp);
+    trim();
+
+    if (hadRows && lastRow >= m_firstRow && lastRow < m_firstRow + quint64(m_rowCount))
+    {
+        const int row = int(lastRow - m_firstRow);
+        Q_EMIT dataChanged(index(row), index(row));
+    }
+
+    publish();
+}
+
+/**
+ * Removes all the lines, the cost does not depend on the amount of data
+ */
+void ReceiveLogModel::clear()
+{
+    beginResetModel();
+    m_store.clear();
+    m_firstRow = storeFirstRow();
+    m_rowCount = 0;
+    endResetModel();
+}
+
+/**
+ * Prefixes every line with its reception time if @a enabled is @c true
+ */
+void ReceiveLogModel::setShowTimestamps(const bool enabled)
+{
+    if (m_showTimestamps == enabled)
+        return;
+
+    m_showTimestamps = enabled;
+    if (m_rowCount > 0)
+        Q_EMIT dataChanged(index(0), index(m_rowCount - 1));
+}
+
+/**
+ * Limits the log to @a bytes of retained data, 0 means unlimited
+ */
+void ReceiveLogModel::setMaxBytes(const quint64 bytes)
+{
+    m_store.setMaxBytes(bytes);
+    trim();
+}
+
+/**
+ * Limits the log to @a lines retained lines, 0 means unlimited
+ */
+void ReceiveLogModel::setMaxLines(const quint64 lines)
+{
+    m_store.setMaxLines(lines);
+    trim();
+}
+
+/**
+ * Changes the way in which the retained bytes are rendered, the rows are
+ * regenerated lazily from the stored data.
+ */
+void ReceiveLogModel::setDisplayMode(const Misc::HexDump::Mode mode)
+{
+    if (m_displayMode == mode)
+        return;
+
+    beginResetModel();
+    m_displayMode = mode;
+    m_firstRow = storeFirstRow();
+    m_rowCount = int(storeEndRow() - m_firstRow);
+    endResetModel();
+}
+
+/**
+ * Evicts the oldest blocks of the store & removes the matching rows
+ */
+void ReceiveLogModel::trim()
+{
+    if (m_store.trim() == 0)
+        return;
+
+    const quint64 first = storeFirstRow();
+    const quint64 evicted = first - m_firstRow;
+    if (evicted >= quint64(m_rowCount))
+    {
+        // Every published row is gone
+        beginResetModel();
+        m_firstRow = first;
+        m_rowCount = 0;
+        endResetModel();
+        return;
+    }
+
+    if (evicted > 0)
+    {
+        beginRemoveRows(QModelIndex(), 0, int(evicted) - 1);
+        m_firstRow = first;
+        m_rowCount -= int(evicted);
+        endRemoveRows();
+    }
+
+    // The oldest hex row may have lost some of its bytes
+    if (m_displayMode != Misc::HexDump::Ascii && m_rowCount > 0)
+        Q_EMIT dataChanged(index(0), index(0));
+}
+
+/**
+ * Notifies the views about the lines that were added to the store
+ */
+void ReceiveLogModel::publish()
+{
+    const int count = int(storeEndRow() - m_firstRow);
+    if (count <= m_rowCount)
+        return;
+
+    beginInsertRows(QModelIndex(), m_rowCount, count - 1);
+    m_rowCount = count;
+    endInsertRows();
+}
+
+/**
+ * Returns the absolute index of the oldest row in the current display mode
+ */
+quint64 ReceiveLogModel::storeFirstRow() const
+{
+    if (m_displayMode == Misc::HexDump::Ascii)
+        return m_store.firstLine();
+
+    return m_store.firstOffset() / Misc::HexDump::BytesPerRow;
+}
+
+/**
+ * Returns the absolute index past the newest row in the current display mode
+ */
+quint64 ReceiveLogModel::storeEndRow() const
+{
+    if (m_displayMode == Misc::HexDump::Ascii)
+        return m_store.endLine();
+
+    const quint64 rowSize = Misc::HexDump::BytesPerRow;
+    return (m_store.endOffset() + rowSize - 1) / rowSize;
+}
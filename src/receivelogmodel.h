@@ -0,0 +1,59 @@
+#ifndef RECEIVELOGMODEL_H
+#define RECEIVELOGMODEL_H
+
+#include <QAbstractListModel>
+#include "receivelogstore.h"
+#include "HexDump.h"
+
+/**
+ * List model that exposes the contents of a @c ReceiveLogStore, either as
+ * text lines or as hex dump rows of @c Misc::HexDump::BytesPerRow bytes.
+ * Rows are only rendered when a view asks for them, so the cost of displaying
+ * the log (or switching the display mode) depends on the number of visible
+ * rows and not on the amount of data.
+ */
+class ReceiveLogModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum Roles
+    {
+        TimestampRole = Qt::UserRole + 1,
+    };
+
+    explicit ReceiveLogModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+    quint64 byteCount() const;
+    bool showTimestamps() const;
+    quint64 maxBytes() const;
+    quint64 maxLines() const;
+    Misc::HexDump::Mode displayMode() const;
+
+public Q_SLOTS:
+    void append(const QByteArray &data);
+    void append(const char *data, const int size, const qint64 timestamp);
+    void clear();
+    void setShowTimestamps(const bool enabled);
+    void setMaxBytes(const quint64 bytes);
+    void setMaxLines(const quint64 lines);
+    void setDisplayMode(const Misc::HexDump::Mode mode);
+
+private:
+    void trim();
+    void publish();
+    quint64 storeFirstRow() const;
+    quint64 storeEndRow() const;
+
+private:
+    ReceiveLogStore m_store;
+    bool m_showTimestamps;
+    Misc::HexDump::Mode m_displayMode;
+
+    quint64 m_firstRow;
+    int m_rowCount;
+};
+
+#endif // RECEIVELOGMODEL_H
@@ -0,0 +1,333 @@
+#include "receivelogstore.h"
+#include <algorithm>
+#include <cstring>
+
+/**
+ * Size of a storage block, the unit of allocation & eviction
+ */
+static const int BLOCK_SIZE = 64 * 1024;
+
+/**
+ * Lines longer than this are wrapped, which guarantees that a line always
+ * fits inside a single block.
+ */
+static const int MAX_LINE_LENGTH = 4 * 1024;
+
+/**
+ * Constructor function
+ */
+ReceiveLogStore::ReceiveLogStore()
+    : m_maxBytes(0)
+    , m_maxLines(0)
+    , m_byteCount(0)
+    , m_lineOpen(false)
+    , m_lineLength(0)
+{
+}
+
+/**
+ * Returns the maximum number of retained bytes, 0 means unlimited
+ */
+quint64 ReceiveLogStore::maxBytes() const
+{
+    return m_maxBytes;
+}
+
+/**
+ * Returns the maximum number of retained lines, 0 means unlimited
+ */
+quint64 ReceiveLogStore::maxLines() const
+{
+    return m_maxLines;
+}
+
+/**
+ * Changes the maximum number of retained bytes, the limit is enforced by the
+ * next call to @c trim().
+ */
+void ReceiveLogStore::setMaxBytes(const quint64 bytes)
+{
+    m_maxBytes = bytes;
+}
+
+/**
+ * Changes the maximum number of retained lines, the limit is enforced by the
+ * next call to @c trim().
+ */
+void ReceiveLogStore::setMaxLines(const quint64 lines)
+{
+    m_maxLines = lines;
+}
+
+/**
+ * Returns the absolute index of the oldest retained line
+ */
+quint64 ReceiveLogStore::firstLine() const
+{
+    if (m_blocks.empty())
+        return 0;
+
+    return m_blocks.front().firstLine;
+}
+
+/**
+ * Returns the absolute index that the next new line will have
+ */
+quint64 ReceiveLogStore::endLine() const
+{
+    if (m_blocks.empty())
+        return 0;
+
+    const Block &block = m_blocks.back();
+    return block.firstLine + quint64(block.lineStarts.count());
+}
+
+/**
+ * Returns the number of retained lines, including the last unterminated one
+ */
+quint64 ReceiveLogStore::lineCount() const
+{
+    return endLine() - firstLine();
+}
+
+/**
+ * Returns the number of retained bytes
+ */
+quint64 ReceiveLogStore::byteCount() const
+{
+    return m_byteCount;
+}
+
+/**
+ * Returns the absolute offset of the oldest retained byte
+ */
+quint64 ReceiveLogStore::firstOffset() const
+{
+    if (m_blocks.empty())
+        return 0;
+
+    return m_blocks.front().firstOffset;
+}
+
+/**
+ * Returns the absolute offset that the next received byte will have
+ */
+quint64 ReceiveLogStore::endOffset() const
+{
+    if (m_blocks.empty())
+        return 0;
+
+    const Block &block = m_blocks.back();
+    return block.firstOffset + quint64(block.data.size());
+}
+
+/**
+ * Returns the contents of the line with the absolute @a index, without the
+ * line terminator.
+ */
+QByteArray ReceiveLogStore::line(const quint64 index) const
+{
+    const Block *block = findBlock(index);
+    if (block == Q_NULLPTR)
+        return QByteArray();
+
+    const int i = int(index - block->firstLine);
+    const int start = block->lineStarts.at(i);
+    int end = (i + 1 < block->lineStarts.count()) ? block->lineStarts.at(i + 1)
+                                                  : block->data.size();
+
+    // Strip line terminator
+    while (end > start && (block->data.at(end - 1) == '\n' || block->data.at(end - 1) == '\r'))
+        --end;
+
+    return block->data.mid(start, end - start);
+}
+
+/**
+ * Returns the time (in ms since epoch) at which the first byte of the line
+ * with the absolute @a index was received.
+ */
+qint64 ReceiveLogStore::lineTimestamp(const quint64 index) const
+{
+    const Block *block = findBlock(index);
+    if (block == Q_NULLPTR)
+        return 0;
+
+    return block->timestamps.at(int(index - block->firstLine));
+}
+
+/**
+ * Returns the reception time (in ms since epoch) of the line that contains
+ * the byte at the absolute @a offset.
+ */
+qint64 ReceiveLogStore::timestampAt(const quint64 offset) const
+{
+    const Block *block = findBlockByOffset(offset);
+    if (block == Q_NULLPTR || block->lineStarts.isEmpty())
+        return 0;
+
+    const int position = int(offset - block->firstOffset);
+    auto it = std::upper_bound(block->lineStarts.constBegin(), block->lineStarts.constEnd(),
+                               position);
+    const int i = qMax(0, int(it - block->lineStarts.constBegin()) - 1);
+    return block->timestamps.at(i);
+}
+
+/**
+ * Copies up to @a size retained bytes starting at the absolute @a offset into
+ * @a dst, returns the number of bytes copied.
+ */
+int ReceiveLogStore::read(const quint64 offset, char *dst, const int size) const
+{
+    int copied = 0;
+    quint64 position = offset;
+    while (copied < size)
+    {
+        const Block *block = findBlockByOffset(position);
+        if (block == Q_NULLPTR)
+            break;
+
+        const int start = int(position - block->firstOffset);
+        const int bytes = qMin(size - copied, block->data.size() - start);
+        std::memcpy(dst + copied, block->data.constData() + start, size_t(bytes));
+        copied += bytes;
+        position += quint64(bytes);
+    }
+
+    return copied;
+}
+
+/**
+ * Appends @a size bytes of @a data received at @a timestamp, splitting it in
+ * lines on every '\n'.
+ */
+void ReceiveLogStore::append(const char *data, const int size, const qint64 timestamp)
+{
+    int pos = 0;
+    while (pos < size)
+    {
+        if (m_blocks.empty())
+            newBlock();
+
+        // Start a new line
+        if (!m_lineOpen)
+        {
+            if (m_blocks.back().data.size() >= BLOCK_SIZE)
+                newBlock();
+
+            Block &block = m_blocks.back();
+            block.lineStarts.append(block.data.size());
+            block.timestamps.append(timestamp);
+            m_lineOpen = true;
+            m_lineLength = 0;
+        }
+
+        // Find the end of the current line
+        const char *nl = static_cast<const char *>(std::memchr(data + pos, '\n', size_t(size - pos)));
+        int bytes = nl ? int(nl - data) + 1 - pos : size - pos;
+        bool lineComplete = (nl != Q_NULLPTR);
+        if (m_lineLength + bytes >= MAX_LINE_LENGTH)
+        {
+            bytes = MAX_LINE_LENGTH - m_lineLength;
+            lineComplete = true;
+        }
+
+        // Move the partial line to a new block if it does not fit
+        if (m_blocks.back().data.size() + bytes > BLOCK_SIZE)
+        {
+            Block &full = m_blocks.back();
+            const int start = full.lineStarts.takeLast();
+            const qint64 lineTimestamp = full.timestamps.takeLast();
+            const QByteArray partial = full.data.mid(start);
+            full.data.truncate(start);
+
+            Block &block = newBlock();
+            block.data.append(partial);
+            block.lineStarts.append(0);
+            block.timestamps.append(lineTimestamp);
+        }
+
+        m_blocks.back().data.append(data + pos, bytes);
+        m_byteCount += quint64(bytes);
+        m_lineLength += bytes;
+        m_lineOpen = !lineComplete;
+        pos += bytes;
+    }
+}
+
+/**
+ * Evicts the oldest blocks until the retention limits are satisfied, returns
+ * the number of lines that were removed.
+ */
+quint64 ReceiveLogStore::trim()
+{
+    quint64 removed = 0;
+    while (m_blocks.size() > 1)
+    {
+        const bool tooManyBytes = m_maxBytes > 0 && m_byteCount > m_maxBytes;
+        const bool tooManyLines = m_maxLines > 0 && lineCount() > m_maxLines;
+        if (!tooManyBytes && !tooManyLines)
+            break;
+
+        const Block &block = m_blocks.front();
+        removed += quint64(block.lineStarts.count());
+        m_byteCount -= quint64(block.data.size());
+        m_blocks.pop_front();
+    }
+
+    return removed;
+}
+
+/**
+ * Removes all the data, the blocks are released without touching their
+ * contents.
+ */
+void ReceiveLogStore::clear()
+{
+    std::deque<Block>().swap(m_blocks);
+    m_byteCount = 0;
+    m_lineOpen = false;
+    m_lineLength = 0;
+}
+
+/**
+ * Appends an empty block to the store & returns it
+ */
+ReceiveLogStore::Block &ReceiveLogStore::newBlock()
+{
+    Block block;
+    block.firstLine = endLine();
+    block.firstOffset = endOffset();
+    block.data.reserve(BLOCK_SIZE);
+
+    m_blocks.push_back(block);
+    return m_blocks.back();
+}
+
+/**
+ * Returns the block that contains the line with the absolute @a index
+ */
+const ReceiveLogStore::Block *ReceiveLogStore::findBlock(const quint64 index) const
+{
+    if (index < firstLine() || index >= endLine())
+        return Q_NULLPTR;
+
+    auto it = std::upper_bound(m_blocks.begin(), m_blocks.end(), index,
+                               [](const quint64 value, const Block &block)
+                               { return value < block.firstLine; });
+    return &*(it - 1);
+}
+
+/**
+ * Returns the block that contains the byte at the absolute @a offset
+ */
+const ReceiveLogStore::Block *ReceiveLogStore::findBlockByOffset(const quint64 offset) const
+{
+    if (offset < firstOffset() || offset >= endOffset())
+        return Q_NULLPTR;
+
+    auto it = std::upper_bound(m_blocks.begin(), m_blocks.end(), offset,
+                               [](const quint64 value, const Block &block)
+                               { return value < block.firstOffset; });
+    return &*(it - 1);
+}
@@ -0,0 +1,69 @@
+#ifndef RECEIVELOGSTORE_H
+#define RECEIVELOGSTORE_H
+
+#include <QByteArray>
+#include <QVector>
+#include <deque>
+
+/**
+ * Append-only store for the received data. The bytes are kept in fixed-size
+ * blocks together with the offsets of the lines that start in each block, so
+ * that any line can be located without scanning the data and the oldest data
+ * can be evicted by dropping whole blocks.
+ *
+ * Lines & bytes are addressed with absolute indices/offsets that keep growing
+ * when old data is evicted, @c firstLine() and @c firstOffset() return the
+ * position of the oldest retained data.
+ */
+class ReceiveLogStore
+{
+public:
+    ReceiveLogStore();
+
+    quint64 maxBytes() const;
+    quint64 maxLines() const;
+    void setMaxBytes(const quint64 bytes);
+    void setMaxLines(const quint64 lines);
+
+    quint64 firstLine() const;
+    quint64 endLine() const;
+    quint64 lineCount() const;
+    quint64 byteCount() const;
+    quint64 firstOffset() const;
+    quint64 endOffset() const;
+
+    QByteArray line(const quint64 index) const;
+    qint64 lineTimestamp(const quint64 index) const;
+    qint64 timestampAt(const quint64 offset) const;
+    int read(const quint64 offset, char *dst, const int size) const;
+
+    void append(const char *data, const int size, const qint64 timestamp);
+    quint64 trim();
+    void clear();
+
+private:
+    struct Block
+    {
+        quint64 firstLine;
+        quint64 firstOffset;
+        QByteArray data;
+        QVector<int> lineStarts;
+        QVector<qint64> timestamps;
+    };
+
+    Block &newBlock();
+    const Block *findBlock(const quint64 index) const;
+    const Block *findBlockByOffset(const quint64 offset) const;
+
+private:
+    quint64 m_maxBytes;
+    quint64 m_maxLines;
+    quint64 m_byteCount;
+
+    bool m_lineOpen;
+    int m_lineLength;
+
+    std::deque<Block> m_blocks;
+};
+
+#endif // RECEIVELOGSTORE_H
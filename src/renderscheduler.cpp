@@ -0,0 +1,142 @@
+#include "renderscheduler.h"
+#include "Instrumentation.h"
+
+/**
+ * Default number of view updates per second
+ */
+static const int DEFAULT_MAX_RATE = 30;
+
+/**
+ * Capacity reserved for the pending data, so that appending chunks between
+ * two flushes does not reallocate in the common case.
+ */
+static const int PENDING_RESERVE = 64 * 1024;
+
+/**
+ * Constructor function
+ */
+RenderScheduler::RenderScheduler(QObject *parent) : QObject(parent)
+    , m_maxRate(0)
+    , m_interval(0)
+    , m_flushCount(0)
+    , m_pendingReadNs(0)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &RenderScheduler::flush);
+
+    m_pending.reserve(PENDING_RESERVE);
+    m_lastFlush.start();
+    setMaxRate(DEFAULT_MAX_RATE);
+}
+
+/**
+ * Returns the maximum number of @c flushed() emissions per second
+ */
+int RenderScheduler::maxRate() const
+{
+    return m_maxRate;
+}
+
+/**
+ * Returns the number of bytes waiting for the next flush
+ */
+int RenderScheduler::pendingBytes() const
+{
+    return m_pending.size();
+}
+
+/**
+ * Returns the number of times that the view has been updated
+ */
+quint64 RenderScheduler::flushCount() const
+{
+    return m_flushCount;
+}
+
+/**
+ * Changes the maximum refresh rate of the view to @a hz updates per second,
+ * clamped to 1-1000 Hz since the value may come from the user's settings
+ */
+void RenderScheduler::setMaxRate(const int hz)
+{
+    const int rate = qBound(1, hz, 1000);
+    if (m_maxRate != rate)
+    {
+        m_maxRate = rate;
+        m_interval = 1000 / rate;
+        Q_EMIT maxRateChanged();
+    }
+}
+
+/**
+ * Queues @a size bytes from @a data for the next view update
+ */
+void RenderScheduler::append(const char *data, const int size)
+{
+    if (size <= 0)
+        return;
+
+    // Remember when the oldest pending byte was read from the serial port
+    if (m_pending.isEmpty() && Misc::Instrumentation::enabled())
+        m_pendingReadNs = Misc::Instrumentation::dispatchReadNs();
+
+    m_pending.append(data, size);
+    schedule();
+}
+
+/**
+ * Queues @a data for the next view update
+ */
+void RenderScheduler::append(const QByteArray &data)
+{
+    append(data.constData(), data.size());
+}
+
+/**
+ * Hands all the pending data to the view immediately
+ */
+void RenderScheduler::flush()
+{
+    m_timer.stop();
+    if (m_pending.isEmpty())
+        return;
+
+    ++m_flushCount;
+    m_lastFlush.restart();
+
+    const bool instrumented = Misc::Instrumentation::enabled();
+    const qint64 startNs = instrumented ? Misc::Instrumentation::timestampNs() : 0;
+    Q_EMIT flushed(m_pending);
+    if (instrumented)
+        Misc::Instrumentation::instance().recordFlush(quint64(m_pending.size()), startNs,
+                                                      m_pendingReadNs);
+
+    m_pendingReadNs = 0;
+
+    // Keep the reserved capacity for the next batch
+    m_pending.resize(0);
+}
+
+/**
+ * Discards all the pending data
+ */
+void RenderScheduler::clear()
+{
+    m_timer.stop();
+    m_pending.resize(0);
+    m_pendingReadNs = 0;
+}
+
+/**
+ * Arms the flush timer so that the next update happens one refresh interval
+ * after the previous one.
+ */
+void RenderScheduler::schedule()
+{
+    if (m_timer.isActive())
+        return;
+
+    const qint64 remaining = m_interval - m_lastFlush.elapsed();
+    m_timer.start(int(qMax<qint64>(0, remaining)));
+}
@@ -0,0 +1,48 @@
+#ifndef RENDERSCHEDULER_H
+#define RENDERSCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+/**
+ * Accumulates received data & hands it to the view at most @c maxRate()
+ * times per second, so that the cost of updating the user interface depends
+ * on the refresh rate and not on the rate at which chunks arrive.
+ */
+class RenderScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RenderScheduler(QObject *parent = nullptr);
+
+    int maxRate() const;
+    int pendingBytes() const;
+    quint64 flushCount() const;
+
+Q_SIGNALS:
+    void maxRateChanged();
+    void flushed(const QByteArray &data);
+
+public Q_SLOTS:
+    void setMaxRate(const int hz);
+    void append(const char *data, const int size);
+    void append(const QByteArray &data);
+    void flush();
+    void clear();
+
+private:
+    void schedule();
+
+private:
+    int m_maxRate;
+    int m_interval;
+    QTimer m_timer;
+    QByteArray m_pending;
+    quint64 m_flushCount;
+    QElapsedTimer m_lastFlush;
+    qint64 m_pendingReadNs;
+};
+
+#endif // RENDERSCHEDULER_H
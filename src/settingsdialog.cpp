@@ -3,6 +3,8 @@
 #include <QSerialPortInfo>
 #include <QDebug>
 #include <QPainter>
+#include <QResizeEvent>
+#include "Theme.h"
 
 
 static const char blankString[] = QT_TRANSLATE_NOOP("SettingsDialog", "N/A");
@@ -30,6 +32,7 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
 
     fillPortsInfo();
     fillPortsParameters();
+    ui->autoReconnectCheckBox->setChecked(Serial::instance().autoReconnect());
     //更新设置
     updateSettings();
 }
@@ -92,15 +95,29 @@ void SettingsDialog::updateSettings()
     Serial::instance().setStopBits(ui->stopBitsBox->currentIndex());
     Serial::instance().setParity(ui->parityBox->currentIndex());
     Serial::instance().setFlowControl(ui->flowControlBox->currentIndex());
+    Serial::instance().setAutoReconnect(ui->autoReconnectCheckBox->isChecked());
 
 //    qDebug()<<Serial::instance().baudRate()<<Serial::instance().portIndex()
 //           <<Serial::instance().dataBits()<<Serial::instance().stopBits()
 //           <<Serial::instance().parity()<<Serial::instance().flowControl();
 }
 
+/**
+ * @brief SettingsDialog::paintEvent
+ * 绘制背景图片, 图片只解码一次并按窗口大小缓存
+ */
 void SettingsDialog::paintEvent(QPaintEvent *)
 {
     QPainter painter(this);
-    QPixmap pixmap(":/images/background.png");
-    painter.drawPixmap(rect(), pixmap, QRect());
+    Misc::Theme::drawBackground(&painter, this);
+}
+
+/**
+ * @brief SettingsDialog::resizeEvent
+ * 窗口大小改变后释放旧尺寸的背景缓存
+ */
+void SettingsDialog::resizeEvent(QResizeEvent *event)
+{
+    Misc::Theme::releaseBackground(this, event->oldSize());
+    QDialog::resizeEvent(event);
 }
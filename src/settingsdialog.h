@@ -45,6 +45,7 @@ private:
     void fillPortsInfo();
     void updateSettings();
     void paintEvent(QPaintEvent *) Q_DECL_OVERRIDE;
+    void resizeEvent(QResizeEvent *event) Q_DECL_OVERRIDE;
 
 
 private:
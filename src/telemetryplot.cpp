@@ -0,0 +1,479 @@
+#include "telemetryplot.h"
+#include "timeseriesstore.h"
+
+#include <QMenu>
+#include <QPainter>
+#include <QContextMenuEvent>
+#include <limits>
+
+/**
+ * Default number of frames per second while the plot is visible
+ */
+static const int DEFAULT_FRAME_RATE = 60;
+
+/**
+ * Default duration of the visible window (1 minute)
+ */
+static const qint64 DEFAULT_WINDOW_SPAN = 60 * 1000000LL;
+
+/**
+ * Space around the plot area for the scale labels
+ */
+static const int MARGIN_LEFT = 56;
+static const int MARGIN_RIGHT = 56;
+static const int MARGIN_TOP = 8;
+static const int MARGIN_BOTTOM = 20;
+
+/**
+ * Fraction of the value range added above & below when the range grows, so
+ * that a slowly rising signal does not redraw the whole plot every column
+ */
+static const float RANGE_MARGIN = 0.1f;
+
+/**
+ * Number of horizontal grid intervals
+ */
+static const int GRID_ROWS = 4;
+
+static const QRgb BACKGROUND_COLOR = qRgb(24, 28, 34);
+static const QRgb GRID_COLOR = qRgb(52, 58, 66);
+static const QRgb TEXT_COLOR = qRgb(200, 200, 200);
+
+static const qint64 INVALID_COLUMN = std::numeric_limits<qint64>::min();
+
+/**
+ * Returns @a value / @a divisor rounded towards negative infinity
+ */
+static qint64 floorDiv(const qint64 value, const qint64 divisor)
+{
+    const qint64 quotient = value / divisor;
+    return (value % divisor != 0 && value < 0) ? quotient - 1 : quotient;
+}
+
+/**
+ * Returns a short description of a duration in microseconds
+ */
+static QString spanText(const qint64 us)
+{
+    const double seconds = us / 1e6;
+    if (seconds < 120)
+        return QObject::tr("%1 s").arg(seconds, 0, 'g', 3);
+    if (seconds < 7200)
+        return QObject::tr("%1 min").arg(seconds / 60, 0, 'g', 3);
+
+    return QObject::tr("%1 h").arg(seconds / 3600, 0, 'g', 3);
+}
+
+//----------------------------------------------------------------------------------------
+// Constructor function
+//----------------------------------------------------------------------------------------
+
+/**
+ * Creates a plot of the samples of @a store, the store must outlive the plot
+ */
+TelemetryPlot::TelemetryPlot(const TimeSeriesStore *store, QWidget *parent)
+    : QWidget(parent)
+    , m_store(store)
+    , m_windowSpan(DEFAULT_WINDOW_SPAN)
+    , m_frameRate(0)
+    , m_nextColumn(INVALID_COLUMN)
+    , m_renderedSamples(0)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMinimumSize(320, 160);
+
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &TelemetryPlot::advance);
+    setFrameRate(DEFAULT_FRAME_RATE);
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns the duration of the visible window in microseconds
+ */
+qint64 TelemetryPlot::windowSpan() const
+{
+    return m_windowSpan;
+}
+
+/**
+ * Returns the maximum number of frames per second
+ */
+int TelemetryPlot::frameRate() const
+{
+    return m_frameRate;
+}
+
+/**
+ * Plots the store column @a channel with @a color, the first channel is
+ * labelled on the left side & the second one on the right side
+ */
+void TelemetryPlot::addChannel(const int channel, const QColor &color)
+{
+    Channel plotChannel;
+    plotChannel.index = channel;
+    plotChannel.color = color.rgb();
+    plotChannel.min = std::numeric_limits<float>::max();
+    plotChannel.max = -std::numeric_limits<float>::max();
+    plotChannel.lastY = -1;
+    m_channels.append(plotChannel);
+
+    invalidate();
+}
+
+/**
+ * Changes the duration of the visible window to @a us microseconds
+ */
+void TelemetryPlot::setWindowSpan(const qint64 us)
+{
+    if (us <= 0 || us == m_windowSpan)
+        return;
+
+    m_windowSpan = us;
+    invalidate();
+    Q_EMIT windowSpanChanged(us);
+}
+
+/**
+ * Changes the maximum number of frames per second to @a fps
+ */
+void TelemetryPlot::setFrameRate(const int fps)
+{
+    m_frameRate = qBound(1, fps, 240);
+    m_timer.setInterval(1000 / m_frameRate);
+}
+
+/**
+ * Discards the rendered columns & the value ranges, the whole window is
+ * rendered again on the next frame
+ */
+void TelemetryPlot::invalidate()
+{
+    m_nextColumn = INVALID_COLUMN;
+    for (Channel &channel : m_channels)
+    {
+        channel.min = std::numeric_limits<float>::max();
+        channel.max = -std::numeric_limits<float>::max();
+    }
+
+    advance();
+}
+
+//----------------------------------------------------------------------------------------
+// Rendering
+//----------------------------------------------------------------------------------------
+
+/**
+ * Renders the columns that were completed since the last frame & schedules
+ * a repaint if new samples arrived.
+ *
+ * Only the new columns are queried & written into the ring, unless they
+ * exceed the current value range or cover the whole window, in which case
+ * all the columns are rendered again.
+ */
+void TelemetryPlot::advance()
+{
+    if (!m_store || m_image.isNull())
+        return;
+
+    if (m_nextColumn != INVALID_COLUMN && m_store->sampleCount() == m_renderedSamples)
+        return;
+
+    m_renderedSamples = m_store->sampleCount();
+
+    // The column of the last sample is still being filled
+    const qint64 width = m_image.width();
+    const qint64 current = floorDiv(m_store->lastTimestamp(), columnSpan());
+
+    bool full = m_nextColumn == INVALID_COLUMN || current - m_nextColumn >= width
+                || current < m_nextColumn;
+    if (!full && !renderColumns(m_nextColumn, current))
+        full = true;
+
+    if (full)
+    {
+        for (Channel &channel : m_channels)
+        {
+            channel.min = std::numeric_limits<float>::max();
+            channel.max = -std::numeric_limits<float>::max();
+            channel.lastY = -1;
+        }
+
+        renderColumns(current - width + 1, current);
+    }
+
+    m_nextColumn = current;
+    update();
+}
+
+/**
+ * Renders the complete columns [@a first, @a last) into the ring.
+ *
+ * Returns @c false without rendering if the columns do not fit into the
+ * current value range, unless the range is still empty.
+ */
+bool TelemetryPlot::renderColumns(const qint64 first, const qint64 last)
+{
+    const int count = int(last - first);
+    if (count <= 0)
+        return true;
+
+    const qint64 span = columnSpan();
+    QVector<QVector<TimeSeriesStore::Bucket>> results;
+    bool rescale = false;
+    for (Channel &channel : m_channels)
+    {
+        const bool empty = channel.min > channel.max;
+        results.append(m_store->query(channel.index, first * span, last * span, count));
+        Q_FOREACH (const TimeSeriesStore::Bucket &bucket, results.last())
+        {
+            if (bucket.count > 0 && expandRange(channel, bucket.min, bucket.max) && !empty)
+                rescale = true;
+        }
+    }
+
+    if (rescale)
+        return false;
+
+    const int width = m_image.width();
+    for (int i = 0; i < count; ++i)
+    {
+        const int x = int(((first + i) % width + width) % width);
+        clearColumn(x);
+        for (int c = 0; c < m_channels.count(); ++c)
+        {
+            const TimeSeriesStore::Bucket &bucket = results.at(c).at(i);
+            Channel &channel = m_channels[c];
+            if (bucket.count == 0)
+            {
+                channel.lastY = -1;
+                continue;
+            }
+
+            drawColumn(x, channel, bucket.min, bucket.max);
+            channel.lastY = toY(channel, bucket.mean);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Fills the pixel column @a x of the ring with the background & grid
+ */
+void TelemetryPlot::clearColumn(const int x)
+{
+    const int height = m_image.height();
+    const int gridStep = qMax(1, (height - 1) / GRID_ROWS);
+    uchar *bits = m_image.bits();
+    const int stride = m_image.bytesPerLine();
+    for (int y = 0; y < height; ++y)
+    {
+        QRgb *pixel = reinterpret_cast<QRgb *>(bits + y * stride) + x;
+        *pixel = (y % gridStep == 0) ? GRID_COLOR : BACKGROUND_COLOR;
+    }
+}
+
+/**
+ * Draws the envelope [@a min, @a max] of @a channel into the pixel column
+ * @a x, joined to the mean of the previous column so that the trace has no
+ * gaps when it moves by more than one pixel per column
+ */
+void TelemetryPlot::drawColumn(const int x, Channel &channel, const float min,
+                               const float max)
+{
+    int top = toY(channel, max);
+    int bottom = toY(channel, min);
+    if (channel.lastY >= 0)
+    {
+        top = qMin(top, channel.lastY);
+        bottom = qMax(bottom, channel.lastY);
+    }
+
+    uchar *bits = m_image.bits();
+    const int stride = m_image.bytesPerLine();
+    for (int y = top; y <= bottom; ++y)
+        reinterpret_cast<QRgb *>(bits + y * stride)[x] = channel.color;
+}
+
+/**
+ * Maps @a value to a row of the plot area
+ */
+int TelemetryPlot::toY(const Channel &channel, const float value) const
+{
+    const int height = m_image.height();
+    if (!(channel.max > channel.min))
+        return height / 2;
+
+    const float position = (channel.max - value) / (channel.max - channel.min);
+    return qBound(0, int(position * (height - 1) + 0.5f), height - 1);
+}
+
+/**
+ * Grows the value range of @a channel to include [@a min, @a max] with some
+ * headroom, returns @c true if the range changed
+ */
+bool TelemetryPlot::expandRange(Channel &channel, float min, float max)
+{
+    if (min >= channel.min && max <= channel.max)
+        return false;
+
+    min = qMin(min, channel.min);
+    max = qMax(max, channel.max);
+    float margin = (max - min) * RANGE_MARGIN;
+    if (margin <= 0)
+        margin = qMax(qAbs(max) * RANGE_MARGIN, 1.0f);
+
+    channel.min = min - margin;
+    channel.max = max + margin;
+    return true;
+}
+
+/**
+ * Returns the area in which the columns are drawn
+ */
+QRect TelemetryPlot::plotRect() const
+{
+    return rect().adjusted(MARGIN_LEFT, MARGIN_TOP, -MARGIN_RIGHT, -MARGIN_BOTTOM);
+}
+
+/**
+ * Returns the duration of one pixel column in microseconds
+ */
+qint64 TelemetryPlot::columnSpan() const
+{
+    const qint64 width = qMax(1, m_image.width());
+    return qMax<qint64>(1, (m_windowSpan + width - 1) / width);
+}
+
+//----------------------------------------------------------------------------------------
+// Widget events
+//----------------------------------------------------------------------------------------
+
+/**
+ * Copies the ring to the screen in two pieces, oldest column first, draws
+ * the column that is still being filled & the labels
+ */
+void TelemetryPlot::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(BACKGROUND_COLOR));
+    if (m_image.isNull() || m_nextColumn == INVALID_COLUMN)
+        return;
+
+    const QRect plot = plotRect();
+    const int width = m_image.width();
+    const int height = m_image.height();
+    const int start = int(((m_nextColumn + 1) % width + width) % width);
+    painter.drawImage(plot.topLeft(), m_image, QRect(start, 0, width - start, height));
+    if (start > 0)
+        painter.drawImage(plot.topLeft() + QPoint(width - start, 0), m_image,
+                          QRect(0, 0, start, height));
+
+    // Column of the latest samples, it replaces the oldest column of the ring
+    const int x = plot.left() + width - 1;
+    const qint64 span = columnSpan();
+    painter.fillRect(QRect(x, plot.top(), 1, height), QColor(BACKGROUND_COLOR));
+    for (const Channel &channel : m_channels)
+    {
+        const QVector<TimeSeriesStore::Bucket> buckets
+            = m_store->query(channel.index, m_nextColumn * span, (m_nextColumn + 1) * span, 1);
+        if (buckets.isEmpty() || buckets.first().count == 0)
+            continue;
+
+        int top = toY(channel, buckets.first().max);
+        int bottom = toY(channel, buckets.first().min);
+        if (channel.lastY >= 0)
+        {
+            top = qMin(top, channel.lastY);
+            bottom = qMax(bottom, channel.lastY);
+        }
+
+        painter.setPen(QColor(channel.color));
+        painter.drawLine(x, plot.top() + top, x, plot.top() + bottom);
+    }
+
+    // Value scales of the first two channels & time scale
+    const QFontMetrics metrics = painter.fontMetrics();
+    for (int c = 0; c < qMin(2, m_channels.count()); ++c)
+    {
+        const Channel &channel = m_channels.at(c);
+        if (channel.min > channel.max)
+            continue;
+
+        const QRect labelRect = c == 0 ? QRect(0, plot.top(), MARGIN_LEFT - 4, height)
+                                       : QRect(plot.right() + 4, plot.top(), MARGIN_RIGHT - 4, height);
+        const Qt::Alignment align = c == 0 ? Qt::AlignRight : Qt::AlignLeft;
+        painter.setPen(QColor(channel.color));
+        painter.drawText(labelRect, align | Qt::AlignTop, QString::number(channel.max, 'g', 4));
+        painter.drawText(labelRect, align | Qt::AlignBottom, QString::number(channel.min, 'g', 4));
+        painter.drawText(labelRect, align | Qt::AlignVCenter, m_store->channelName(channel.index));
+    }
+
+    const QRect timeRect(plot.left(), plot.bottom() + 2, width, metrics.height());
+    painter.setPen(QColor(TEXT_COLOR));
+    painter.drawText(timeRect, Qt::AlignLeft, QString("-%1").arg(spanText(m_windowSpan)));
+    painter.drawText(timeRect, Qt::AlignRight, "0");
+}
+
+/**
+ * Resizes the ring to the new plot area & renders the window again
+ */
+void TelemetryPlot::resizeEvent(QResizeEvent *event)
+{
+    const QRect plot = plotRect();
+    if (plot.width() > 0 && plot.height() > 0)
+    {
+        m_image = QImage(plot.size(), QImage::Format_RGB32);
+        m_image.fill(BACKGROUND_COLOR);
+    }
+    else
+        m_image = QImage();
+
+    invalidate();
+    QWidget::resizeEvent(event);
+}
+
+/**
+ * Starts the frame timer while the plot is visible
+ */
+void TelemetryPlot::showEvent(QShowEvent *event)
+{
+    invalidate();
+    m_timer.start();
+    QWidget::showEvent(event);
+}
+
+/**
+ * Stops the frame timer while the plot is hidden
+ */
+void TelemetryPlot::hideEvent(QHideEvent *event)
+{
+    m_timer.stop();
+    QWidget::hideEvent(event);
+}
+
+/**
+ * Lets the user choose the duration of the window
+ */
+void TelemetryPlot::contextMenuEvent(QContextMenuEvent *event)
+{
+    static const qint64 spans[] = { 60 * 1000000LL, 10 * 60 * 1000000LL,
+                                    3600 * 1000000LL, 24 * 3600 * 1000000LL };
+
+    QMenu menu(this);
+    for (const qint64 span : spans)
+    {
+        QAction *action = menu.addAction(spanText(span));
+        action->setCheckable(true);
+        action->setChecked(span == m_windowSpan);
+        action->setData(span);
+    }
+
+    QAction *action = menu.exec(event->globalPos());
+    if (action)
+        setWindowSpan(action->data().toLongLong());
+}
@@ -0,0 +1,83 @@
+#ifndef TELEMETRYPLOT_H
+#define TELEMETRYPLOT_H
+
+#include <QWidget>
+#include <QImage>
+#include <QTimer>
+#include <QVector>
+#include <QColor>
+
+class TimeSeriesStore;
+
+/**
+ * Draws the last @c windowSpan() microseconds of some channels of a
+ * @c TimeSeriesStore as min/max envelopes, one column per pixel.
+ *
+ * Pixel columns are aligned to multiples of the column duration, so that a
+ * column never changes once it is complete. Complete columns are rendered
+ * once into a ring of pixel columns, scrolling only moves the start of the
+ * ring; each frame merely draws the new columns & the one that is still
+ * being filled. The cost of a frame therefore depends on the width of the
+ * widget and not on the number of samples, without requiring OpenGL.
+ */
+class TelemetryPlot : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit TelemetryPlot(const TimeSeriesStore *store, QWidget *parent = nullptr);
+
+    qint64 windowSpan() const;
+    int frameRate() const;
+    void addChannel(const int channel, const QColor &color);
+
+Q_SIGNALS:
+    void windowSpanChanged(const qint64 us);
+
+public Q_SLOTS:
+    void setWindowSpan(const qint64 us);
+    void setFrameRate(const int fps);
+    void invalidate();
+
+protected:
+    void paintEvent(QPaintEvent *event) Q_DECL_OVERRIDE;
+    void resizeEvent(QResizeEvent *event) Q_DECL_OVERRIDE;
+    void showEvent(QShowEvent *event) Q_DECL_OVERRIDE;
+    void hideEvent(QHideEvent *event) Q_DECL_OVERRIDE;
+    void contextMenuEvent(QContextMenuEvent *event) Q_DECL_OVERRIDE;
+
+private Q_SLOTS:
+    void advance();
+
+private:
+    struct Channel
+    {
+        int index;
+        QRgb color;
+        float min;
+        float max;
+        int lastY;
+    };
+
+    QRect plotRect() const;
+    qint64 columnSpan() const;
+    bool renderColumns(const qint64 first, const qint64 last);
+    void clearColumn(const int x);
+    void drawColumn(const int x, Channel &channel, const float min,
+                    const float max);
+    int toY(const Channel &channel, const float value) const;
+    bool expandRange(Channel &channel, float min, float max);
+
+private:
+    const TimeSeriesStore *m_store;
+    QVector<Channel> m_channels;
+
+    qint64 m_windowSpan;
+    int m_frameRate;
+    QTimer m_timer;
+
+    QImage m_image;
+    qint64 m_nextColumn;
+    quint64 m_renderedSamples;
+};
+
+#endif // TELEMETRYPLOT_H
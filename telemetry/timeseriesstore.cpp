@@ -0,0 +1,451 @@
+#include "timeseriesstore.h"
+
+#include <algorithm>
+#include <limits>
+
+/**
+ * Number of buckets of a level that are merged into one bucket of the next
+ * (coarser) level
+ */
+static const quint64 ROLLUP_FACTOR = 16;
+
+/**
+ * Smallest ring of a rollup level, in buckets
+ */
+static const size_t MIN_LEVEL_CAPACITY = 1024;
+
+/**
+ * Returns the smallest power of two that is not smaller than @a value
+ */
+static size_t ceilPowerOfTwo(const size_t value)
+{
+    size_t result = 1;
+    while (result < value)
+        result <<= 1;
+
+    return result;
+}
+
+//----------------------------------------------------------------------------------------
+// Constructor function
+//----------------------------------------------------------------------------------------
+
+/**
+ * Creates a store for @a channelCount channels that keeps the last
+ * @a capacity raw samples (rounded up to a power of two).
+ *
+ * Each of the @a levelCount - 1 rollup levels keeps @a capacity / 16
+ * buckets, so that the history covered by a level is 16 times longer than
+ * the one of the previous level (e.g. with 2^20 samples at 1 kHz: 17 minutes
+ * of raw samples, 4.6 hours at 256 samples/bucket & 3 days at 4096
+ * samples/bucket) while using a fraction of its memory.
+ *
+ * The rings are only allocated when the first row is appended, so that a
+ * store that is never fed costs no memory.
+ */
+TimeSeriesStore::TimeSeriesStore(const int channelCount, const int capacity,
+                                 const int levelCount)
+    : m_channelCount(qMax(channelCount, 1))
+    , m_channelNames(m_channelCount)
+{
+    const size_t rawCapacity = ceilPowerOfTwo(size_t(qMax(capacity, 2)));
+    const size_t levelCapacity
+        = qMax(rawCapacity / ROLLUP_FACTOR, MIN_LEVEL_CAPACITY);
+
+    quint64 samplesPerBucket = 1;
+    m_levels.resize(size_t(qMax(levelCount, 1)));
+    for (size_t i = 0; i < m_levels.size(); ++i)
+    {
+        Level &level = m_levels[i];
+        const size_t size = i == 0 ? rawCapacity : levelCapacity;
+
+        level.samplesPerBucket = samplesPerBucket;
+        level.count = 0;
+        level.mask = size - 1;
+        samplesPerBucket *= ROLLUP_FACTOR;
+    }
+}
+
+//----------------------------------------------------------------------------------------
+// Member access functions
+//----------------------------------------------------------------------------------------
+
+/**
+ * Returns the number of values in each row
+ */
+int TimeSeriesStore::channelCount() const
+{
+    return m_channelCount;
+}
+
+/**
+ * Returns the maximum number of raw samples kept per channel
+ */
+int TimeSeriesStore::capacity() const
+{
+    return int(m_levels.front().mask + 1);
+}
+
+/**
+ * Returns the number of raw samples currently kept per channel
+ */
+int TimeSeriesStore::size() const
+{
+    const Level &raw = m_levels.front();
+    return int(raw.count - firstIndex(raw));
+}
+
+/**
+ * Returns the number of rows appended since the store was created or cleared
+ */
+quint64 TimeSeriesStore::sampleCount() const
+{
+    return m_levels.front().count;
+}
+
+/**
+ * Returns @c true if no rows were appended
+ */
+bool TimeSeriesStore::isEmpty() const
+{
+    return m_levels.front().count == 0;
+}
+
+/**
+ * Returns the display name of @a channel
+ */
+QString TimeSeriesStore::channelName(const int channel) const
+{
+    return m_channelNames.value(channel);
+}
+
+/**
+ * Changes the display name of @a channel
+ */
+void TimeSeriesStore::setChannelName(const int channel, const QString &name)
+{
+    if (channel >= 0 && channel < m_channelCount)
+        m_channelNames[channel] = name;
+}
+
+/**
+ * Returns the timestamp of the oldest sample that is still represented in
+ * the store, at any resolution
+ */
+qint64 TimeSeriesStore::firstTimestamp() const
+{
+    if (isEmpty())
+        return 0;
+
+    const Level &level = m_levels.back();
+    return level.timestamps[firstIndex(level) & level.mask];
+}
+
+/**
+ * Returns the timestamp of the last appended row
+ */
+qint64 TimeSeriesStore::lastTimestamp() const
+{
+    if (isEmpty())
+        return 0;
+
+    const Level &raw = m_levels.front();
+    return raw.timestamps[(raw.count - 1) & raw.mask];
+}
+
+/**
+ * Returns the last value of @a channel
+ */
+float TimeSeriesStore::lastValue(const int channel) const
+{
+    if (isEmpty())
+        return 0;
+
+    return value(channel, size() - 1);
+}
+
+/**
+ * Returns the timestamp of the raw sample at @a index (0 is the oldest
+ * sample that is still kept)
+ */
+qint64 TimeSeriesStore::timestamp(const int index) const
+{
+    const Level &raw = m_levels.front();
+    return raw.timestamps[(firstIndex(raw) + quint64(index)) & raw.mask];
+}
+
+/**
+ * Returns the value of @a channel of the raw sample at @a index
+ */
+float TimeSeriesStore::value(const int channel, const int index) const
+{
+    const Level &raw = m_levels.front();
+    return raw.min[size_t(channel)][(firstIndex(raw) + quint64(index)) & raw.mask];
+}
+
+//----------------------------------------------------------------------------------------
+// Appending
+//----------------------------------------------------------------------------------------
+
+/**
+ * Appends a row with one value per channel.
+ *
+ * The timestamps must not decrease, an older timestamp is replaced by the
+ * one of the previous row so that time queries remain valid. The rollups
+ * are updated in place, the cost is constant per row.
+ */
+void TimeSeriesStore::append(qint64 timestamp, const float *values)
+{
+    if (m_levels.front().timestamps.empty())
+        allocate();
+
+    if (!isEmpty())
+        timestamp = qMax(timestamp, lastTimestamp());
+
+    const quint64 sample = m_levels.front().count;
+    for (size_t i = 0; i < m_levels.size(); ++i)
+    {
+        Level &level = m_levels[i];
+
+        // First sample of a new bucket
+        if (sample % level.samplesPerBucket == 0)
+        {
+            const size_t slot = level.count & level.mask;
+            level.timestamps[slot] = timestamp;
+            for (int c = 0; c < m_channelCount; ++c)
+                level.min[size_t(c)][slot] = values[c];
+
+            if (i > 0)
+            {
+                level.counts[slot] = 1;
+                for (int c = 0; c < m_channelCount; ++c)
+                {
+                    level.max[size_t(c)][slot] = values[c];
+                    level.sum[size_t(c)][slot] = values[c];
+                }
+            }
+
+            ++level.count;
+        }
+
+        // Update the open bucket
+        else
+        {
+            const size_t slot = (level.count - 1) & level.mask;
+            ++level.counts[slot];
+            for (int c = 0; c < m_channelCount; ++c)
+            {
+                float &min = level.min[size_t(c)][slot];
+                float &max = level.max[size_t(c)][slot];
+                min = qMin(min, values[c]);
+                max = qMax(max, values[c]);
+                level.sum[size_t(c)][slot] += values[c];
+            }
+        }
+    }
+}
+
+/**
+ * Overload of @c append() for a vector with one value per channel
+ */
+void TimeSeriesStore::append(const qint64 timestamp, const QVector<float> &values)
+{
+    if (values.count() >= m_channelCount)
+        append(timestamp, values.constData());
+}
+
+/**
+ * Removes all the samples & rollups
+ */
+void TimeSeriesStore::clear()
+{
+    for (Level &level : m_levels)
+        level.count = 0;
+}
+
+//----------------------------------------------------------------------------------------
+// Queries
+//----------------------------------------------------------------------------------------
+
+/**
+ * Splits the time window [@a from, @a to) into @a buckets equal intervals &
+ * returns the min/max/mean of @a channel in each of them.
+ *
+ * The samples are read from the finest level whose buckets are not larger
+ * than one output bucket, so that at most ~16 stored buckets are merged into
+ * each output bucket regardless of the length of the window. Stored buckets
+ * are attributed to the output bucket that contains their first sample.
+ */
+QVector<TimeSeriesStore::Bucket> TimeSeriesStore::query(const int channel,
+                                                        const qint64 from,
+                                                        const qint64 to,
+                                                        const int buckets) const
+{
+    QVector<Bucket> result;
+    if (buckets <= 0 || to <= from || channel < 0 || channel >= m_channelCount)
+        return result;
+
+    result.resize(buckets);
+    const double bucketSpan = double(to - from) / buckets;
+    for (int i = 0; i < buckets; ++i)
+    {
+        Bucket &bucket = result[i];
+        bucket.timestamp = from + qint64(i * bucketSpan);
+        bucket.min = std::numeric_limits<float>::max();
+        bucket.max = -std::numeric_limits<float>::max();
+        bucket.mean = 0;
+        bucket.count = 0;
+    }
+
+    if (isEmpty())
+        return result;
+
+    std::vector<double> sums(size_t(buckets), 0.0);
+    const int levelIndex = selectLevel(from, to, buckets);
+    const Level &level = m_levels[size_t(levelIndex)];
+    const std::vector<float> &mins = level.min[size_t(channel)];
+    for (quint64 i = lowerBound(level, from); i < level.count; ++i)
+    {
+        const size_t slot = i & level.mask;
+        const qint64 timestamp = level.timestamps[slot];
+        if (timestamp >= to)
+            break;
+
+        const int index = qBound(0, int((timestamp - from) / bucketSpan), buckets - 1);
+        Bucket &bucket = result[index];
+        if (levelIndex == 0)
+        {
+            bucket.min = qMin(bucket.min, mins[slot]);
+            bucket.max = qMax(bucket.max, mins[slot]);
+            sums[size_t(index)] += mins[slot];
+            ++bucket.count;
+        }
+
+        else
+        {
+            bucket.min = qMin(bucket.min, mins[slot]);
+            bucket.max = qMax(bucket.max, level.max[size_t(channel)][slot]);
+            sums[size_t(index)] += level.sum[size_t(channel)][slot];
+            bucket.count += level.counts[slot];
+        }
+    }
+
+    for (int i = 0; i < buckets; ++i)
+    {
+        Bucket &bucket = result[i];
+        if (bucket.count > 0)
+            bucket.mean = float(sums[size_t(i)] / bucket.count);
+        else
+            bucket.min = bucket.max = 0;
+    }
+
+    return result;
+}
+
+/**
+ * Allocates the rings of all the levels
+ */
+void TimeSeriesStore::allocate()
+{
+    for (size_t i = 0; i < m_levels.size(); ++i)
+    {
+        Level &level = m_levels[i];
+        const size_t size = level.mask + 1;
+        level.timestamps.resize(size);
+
+        // Raw samples only need their value column
+        level.min.resize(size_t(m_channelCount));
+        for (auto &column : level.min)
+            column.resize(size);
+
+        if (i > 0)
+        {
+            level.counts.resize(size);
+            level.max.resize(size_t(m_channelCount));
+            level.sum.resize(size_t(m_channelCount));
+            for (auto &column : level.max)
+                column.resize(size);
+            for (auto &column : level.sum)
+                column.resize(size);
+        }
+    }
+}
+
+/**
+ * Returns the absolute index of the oldest bucket that is still kept in
+ * @a level
+ */
+quint64 TimeSeriesStore::firstIndex(const Level &level) const
+{
+    const quint64 capacity = level.mask + 1;
+    return level.count > capacity ? level.count - capacity : 0;
+}
+
+/**
+ * Returns the absolute index of the first bucket of @a level whose timestamp
+ * is not older than @a timestamp. For rollup levels the bucket that contains
+ * @a timestamp is included so that the window starts with its partial bucket.
+ */
+quint64 TimeSeriesStore::lowerBound(const Level &level, const qint64 timestamp) const
+{
+    quint64 first = firstIndex(level);
+    quint64 count = level.count - first;
+    while (count > 0)
+    {
+        const quint64 step = count / 2;
+        const quint64 middle = first + step;
+        if (level.timestamps[middle & level.mask] < timestamp)
+        {
+            first = middle + 1;
+            count -= step + 1;
+        }
+
+        else
+            count = step;
+    }
+
+    if (level.samplesPerBucket > 1 && first > firstIndex(level)
+        && (first == level.count || level.timestamps[first & level.mask] > timestamp))
+        --first;
+
+    return first;
+}
+
+/**
+ * Returns the level used to answer a query for [@a from, @a to) with
+ * @a buckets output buckets.
+ *
+ * The number of samples per output bucket is estimated from the average
+ * sample rate of the raw samples. If the selected level no longer covers
+ * @a from, coarser levels with a longer history are used instead.
+ */
+int TimeSeriesStore::selectLevel(const qint64 from, const qint64 to,
+                                 const int buckets) const
+{
+    const Level &raw = m_levels.front();
+    const quint64 first = firstIndex(raw);
+    const qint64 rawSpan = lastTimestamp() - raw.timestamps[first & raw.mask];
+
+    double samplesPerBucket = 1;
+    if (raw.count - first > 1 && rawSpan > 0)
+    {
+        const double rate = double(raw.count - first - 1) / rawSpan;
+        samplesPerBucket = rate * double(to - from) / buckets;
+    }
+
+    int index = 0;
+    while (index + 1 < int(m_levels.size())
+           && double(m_levels[size_t(index + 1)].samplesPerBucket) <= samplesPerBucket)
+        ++index;
+
+    while (index + 1 < int(m_levels.size()))
+    {
+        const Level &level = m_levels[size_t(index)];
+        if (level.timestamps[firstIndex(level) & level.mask] <= from)
+            break;
+
+        ++index;
+    }
+
+    return index;
+}
@@ -0,0 +1,92 @@
+#ifndef TIMESERIESSTORE_H
+#define TIMESERIESSTORE_H
+
+#include <QVector>
+#include <QString>
+#include <vector>
+
+/**
+ * In-memory history of a fixed set of telemetry channels that are sampled
+ * together (e.g. output current, voltage, brightness step & loop resistance
+ * of a CCR).
+ *
+ * The samples are stored column by column in fixed-capacity rings: one
+ * timestamp column & one value column per channel. Every appended row also
+ * updates a hierarchy of min/max/sum rollups (16, 256, 4096... samples per
+ * bucket), whose rings retain a much longer history than the raw samples.
+ * A query for any time window picks the finest level whose buckets are not
+ * smaller than one output bucket, so that its cost depends on the number of
+ * requested buckets (pixels) and not on the number of samples in the window.
+ *
+ * @note Not thread-safe, the store must be appended to & queried from the
+ *       same thread.
+ */
+class TimeSeriesStore
+{
+public:
+    /**
+     * Aggregate of the samples that fall into one output bucket, @c count is
+     * 0 if the bucket has no samples
+     */
+    struct Bucket
+    {
+        qint64 timestamp;
+        float min;
+        float max;
+        float mean;
+        quint32 count;
+    };
+
+    explicit TimeSeriesStore(const int channelCount, const int capacity,
+                             const int levelCount = 4);
+
+    int channelCount() const;
+    int capacity() const;
+    int size() const;
+    quint64 sampleCount() const;
+    bool isEmpty() const;
+
+    QString channelName(const int channel) const;
+    void setChannelName(const int channel, const QString &name);
+
+    qint64 firstTimestamp() const;
+    qint64 lastTimestamp() const;
+    float lastValue(const int channel) const;
+
+    qint64 timestamp(const int index) const;
+    float value(const int channel, const int index) const;
+
+    void append(const qint64 timestamp, const float *values);
+    void append(const qint64 timestamp, const QVector<float> &values);
+    void clear();
+
+    QVector<Bucket> query(const int channel, const qint64 from, const qint64 to,
+                          const int buckets) const;
+
+private:
+    struct Level
+    {
+        quint64 samplesPerBucket;
+        quint64 count;
+        size_t mask;
+        std::vector<qint64> timestamps;
+        std::vector<quint32> counts;
+        std::vector<std::vector<float>> min;
+        std::vector<std::vector<float>> max;
+        std::vector<std::vector<double>> sum;
+    };
+
+    void allocate();
+    quint64 firstIndex(const Level &level) const;
+    quint64 lowerBound(const Level &level, const qint64 timestamp) const;
+    int selectLevel(const qint64 from, const qint64 to, const int buckets) const;
+
+private:
+    int m_channelCount;
+    QVector<QString> m_channelNames;
+
+    // Level 0 holds the raw samples, one value per bucket
+    std::vector<Level> m_levels;
+};
+
+#endif // TIMESERIESSTORE_H